@@ -0,0 +1,138 @@
+// Compares the hash functions of src/hash.c with FNV-1a: throughput on integer keys, short and long strings,
+// and how evenly sequential ids spread over `hash % size` buckets.
+#include "hash.h"
+#include "fnv_hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KEY_COUNT (1 << 20)
+#define ROUNDS 20
+#define SHORT_LENGTH 12
+#define LONG_LENGTH 120
+
+static volatile uint32_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_int(const char *name, uint32_t (*hash)(int), const int keys[])
+{
+    double start = now_ns();
+    uint32_t acc = 0;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int i = 0; i < KEY_COUNT; i++)
+        {
+            acc += hash(keys[i]);
+        }
+    }
+    sink = acc;
+    printf("  %-22s %8.2f ns/key\n", name, (now_ns() - start) / ((double)ROUNDS * KEY_COUNT));
+}
+
+static void bench_int_batch(const char *name, HashKind kind, const int keys[], uint32_t hashes[])
+{
+    double start = now_ns();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        hash_int_batch(kind, keys, hashes, KEY_COUNT);
+    }
+    sink = hashes[KEY_COUNT - 1];
+    printf("  %-22s %8.2f ns/key\n", name, (now_ns() - start) / ((double)ROUNDS * KEY_COUNT));
+}
+
+static void bench_bytes(const char *name, uint32_t (*hash)(const void *, size_t), const char *values, size_t length, int count)
+{
+    double start = now_ns();
+    uint32_t acc = 0;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            acc += hash(values + (size_t)i * length, length);
+        }
+    }
+    sink = acc;
+    double elapsed = now_ns() - start;
+    printf("  %-22s %8.2f ns/key %8.2f GB/s\n", name, elapsed / ((double)ROUNDS * count),
+           (double)ROUNDS * count * length / elapsed);
+}
+
+// Largest bucket and share of empty buckets when the keys go to hash % size
+static void bucket_spread(const char *name, uint32_t (*hash)(int), int key_count, int size)
+{
+    int *buckets = calloc(size, sizeof(int));
+    for (int i = 0; i < key_count; i++)
+    {
+        buckets[hash(i) % size]++;
+    }
+    int largest = 0, empty = 0;
+    for (int i = 0; i < size; i++)
+    {
+        largest = buckets[i] > largest ? buckets[i] : largest;
+        empty += buckets[i] == 0;
+    }
+    printf("  %-22s size %-6d largest bucket %-4d empty %.1f%% (ideal %.1f keys per bucket)\n", name, size, largest,
+           100.0 * empty / size, (double)key_count / size);
+    free(buckets);
+}
+
+int main(void)
+{
+    int *keys = malloc(KEY_COUNT * sizeof(int));
+    uint32_t *hashes = malloc(KEY_COUNT * sizeof(uint32_t));
+    char *short_values = malloc((size_t)KEY_COUNT * SHORT_LENGTH);
+    char *long_values = malloc((size_t)KEY_COUNT / 8 * LONG_LENGTH);
+    if (!keys || !hashes || !short_values || !long_values)
+    {
+        perror("Failed to allocate benchmark data");
+        return 1;
+    }
+    srand(42);
+    for (int i = 0; i < KEY_COUNT; i++)
+    {
+        keys[i] = rand();
+    }
+    for (size_t i = 0; i < (size_t)KEY_COUNT * SHORT_LENGTH; i++)
+    {
+        short_values[i] = 'a' + rand() % 26;
+    }
+    for (size_t i = 0; i < (size_t)KEY_COUNT / 8 * LONG_LENGTH; i++)
+    {
+        long_values[i] = 'a' + rand() % 26;
+    }
+
+    printf("Integer keys\n");
+    bench_int("fnv1a_hash_int", fnv1a_hash_int, keys);
+    bench_int("word_hash_int", word_hash_int, keys);
+    bench_int_batch("hash_int_batch fnv1a", HASH_FNV1A, keys, hashes);
+    bench_int_batch("hash_int_batch word", HASH_WORD, keys, hashes);
+
+    printf("Strings of %d bytes\n", SHORT_LENGTH);
+    bench_bytes("fnv1a_hash_bytes", fnv1a_hash_bytes, short_values, SHORT_LENGTH, KEY_COUNT);
+    bench_bytes("word_hash_bytes", word_hash_bytes, short_values, SHORT_LENGTH, KEY_COUNT);
+    bench_bytes("crc32c_hash_bytes", crc32c_hash_bytes, short_values, SHORT_LENGTH, KEY_COUNT);
+
+    printf("Strings of %d bytes\n", LONG_LENGTH);
+    bench_bytes("fnv1a_hash_bytes", fnv1a_hash_bytes, long_values, LONG_LENGTH, KEY_COUNT / 8);
+    bench_bytes("word_hash_bytes", word_hash_bytes, long_values, LONG_LENGTH, KEY_COUNT / 8);
+    bench_bytes("crc32c_hash_bytes", crc32c_hash_bytes, long_values, LONG_LENGTH, KEY_COUNT / 8);
+
+    printf("Sequential ids 0..99999 over hash %% size buckets\n");
+    bucket_spread("fnv1a_hash_int", fnv1a_hash_int, 100000, 1000);
+    bucket_spread("word_hash_int", word_hash_int, 100000, 1000);
+    bucket_spread("fnv1a_hash_int", fnv1a_hash_int, 100000, 1024);
+    bucket_spread("word_hash_int", word_hash_int, 100000, 1024);
+
+    free(keys);
+    free(hashes);
+    free(short_values);
+    free(long_values);
+    return 0;
+}
@@ -0,0 +1,358 @@
+// Load generator for the SQL engine, built on libalildb. Every workload runs its statements prepared against
+// a fresh database under ./databases and prints one JSON object per line: throughput and latency percentiles
+// of its operations, so runs of two builds can be compared field by field.
+//
+//     ./bench/load_bench [rows=N] [ops=N] [join_rows=N] [seed=N]
+//
+// rows      rows bulk inserted into the main table
+// ops       operations of each lookup, scan, update, delete and join workload
+// join_rows rows of each of the four join tables
+// seed      seed of the keys the workloads pick, runs with the same seed do the same work
+#include "alildb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define BENCH_DB "load_bench"
+#define MAX_JOIN_WAYS 4
+
+typedef struct
+{
+    int rows;
+    int ops;
+    int join_rows;
+    unsigned seed;
+} BenchConfig;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double sorted[], int count, double fraction)
+{
+    int index = (int)(fraction * count);
+    return sorted[index < count ? index : count - 1];
+}
+
+// Print the line of a workload, extra holds further JSON members starting with a comma or is empty
+static void report(const BenchConfig *config, const char *workload, double latencies[], int count, const char *extra)
+{
+    double total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        total += latencies[i];
+    }
+    qsort(latencies, count, sizeof(double), compare_doubles);
+    printf("{\"workload\":\"%s\",\"rows\":%d,\"join_rows\":%d,\"seed\":%u,\"ops\":%d,\"seconds\":%.6f,"
+           "\"ops_per_sec\":%.1f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f%s}\n",
+           workload, config->rows, config->join_rows, config->seed, count, total / 1e9,
+           total > 0 ? count / (total / 1e9) : 0.0, percentile(latencies, count, 0.50) / 1e3,
+           percentile(latencies, count, 0.99) / 1e3, percentile(latencies, count, 0.999) / 1e3, extra);
+    fflush(stdout);
+}
+
+// Run a bound statement to completion and return how long it took, -1 on failure
+static double run_timed(AlilStmt *stmt)
+{
+    double start = now_ns();
+    int step;
+    while ((step = db_step(stmt)) == DB_ROW)
+    {
+    }
+    double elapsed = now_ns() - start;
+    db_reset(stmt);
+    return step == DB_DONE ? elapsed : -1;
+}
+
+static long file_bytes(const char *table)
+{
+    char filename[256];
+    struct stat st;
+    snprintf(filename, sizeof(filename), "databases/%s/bins/%s.bin", BENCH_DB, table);
+    return stat(filename, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static int bulk_insert(AlilDB *db, const BenchConfig *config, double latencies[])
+{
+    AlilStmt *stmt;
+    if (db_prepare(db, "INSERT INTO items VALUES (?, ?, ?);", &stmt) != 0)
+    {
+        return -1;
+    }
+    char name[16];
+    for (int i = 0; i < config->rows; i++)
+    {
+        snprintf(name, sizeof(name), "item%d", i);
+        db_bind_int(stmt, 0, i);
+        db_bind_int(stmt, 1, rand() % config->rows);
+        db_bind_text(stmt, 2, name);
+        if ((latencies[i] = run_timed(stmt)) < 0)
+        {
+            db_finalize(stmt);
+            return -1;
+        }
+    }
+    db_finalize(stmt);
+    report(config, "bulk_insert", latencies, config->rows, "");
+    return 0;
+}
+
+// Run ops executions of a statement whose int parameters are drawn by pick
+static int run_workload(AlilDB *db, const BenchConfig *config, const char *workload, const char *sql,
+                        void (*pick)(const BenchConfig *, int[]), int parameter_count, double latencies[])
+{
+    AlilStmt *stmt;
+    if (db_prepare(db, sql, &stmt) != 0)
+    {
+        return -1;
+    }
+    int parameters[8];
+    for (int i = 0; i < config->ops; i++)
+    {
+        pick(config, parameters);
+        for (int p = 0; p < parameter_count; p++)
+        {
+            db_bind_int(stmt, p, parameters[p]);
+        }
+        if ((latencies[i] = run_timed(stmt)) < 0)
+        {
+            printf("Error: Workload %s failed\n", workload);
+            db_finalize(stmt);
+            return -1;
+        }
+    }
+    db_finalize(stmt);
+    report(config, workload, latencies, config->ops, "");
+    return 0;
+}
+
+static void pick_id(const BenchConfig *config, int parameters[])
+{
+    parameters[0] = rand() % config->rows;
+}
+
+// A range of about 1% of the keys
+static void pick_range(const BenchConfig *config, int parameters[])
+{
+    int width = config->rows / 100 > 0 ? config->rows / 100 : 1;
+    parameters[0] = rand() % config->rows;
+    parameters[1] = parameters[0] + width;
+}
+
+static void pick_update(const BenchConfig *config, int parameters[])
+{
+    parameters[0] = rand() % config->rows;
+    parameters[1] = rand() % config->rows;
+}
+
+static void pick_join_id(const BenchConfig *config, int parameters[])
+{
+    parameters[0] = rand() % config->join_rows;
+}
+
+// Delete random rows and insert new ones in their place, the freed slots should keep the file from growing
+static int delete_and_reuse(AlilDB *db, const BenchConfig *config, double deletes[], double inserts[])
+{
+    AlilStmt *delete_stmt;
+    AlilStmt *insert_stmt;
+    if (db_prepare(db, "DELETE FROM items WHERE ID = ?;", &delete_stmt) != 0)
+    {
+        return -1;
+    }
+    if (db_prepare(db, "INSERT INTO items VALUES (?, ?, 'reused');", &insert_stmt) != 0)
+    {
+        db_finalize(delete_stmt);
+        return -1;
+    }
+    int *ids = malloc(sizeof(int) * config->rows);
+    if (!ids)
+    {
+        perror("Failed to allocate id list");
+        db_finalize(delete_stmt);
+        db_finalize(insert_stmt);
+        return -1;
+    }
+    for (int i = 0; i < config->rows; i++)
+    {
+        ids[i] = i;
+    }
+    int next_id = config->rows;
+    long bytes_before = file_bytes("items");
+    int result = 0;
+    for (int i = 0; i < config->ops && result == 0; i++)
+    {
+        int victim = rand() % config->rows;
+        db_bind_int(delete_stmt, 0, ids[victim]);
+        ids[victim] = next_id++;
+        db_bind_int(insert_stmt, 0, ids[victim]);
+        db_bind_int(insert_stmt, 1, rand() % config->rows);
+        if ((deletes[i] = run_timed(delete_stmt)) < 0 || (inserts[i] = run_timed(insert_stmt)) < 0)
+        {
+            printf("Error: Workload delete_reuse failed\n");
+            result = -1;
+        }
+    }
+    if (result == 0)
+    {
+        char extra[96];
+        snprintf(extra, sizeof(extra), ",\"bytes_before\":%ld,\"bytes_after\":%ld", bytes_before,
+                 file_bytes("items"));
+        report(config, "delete", deletes, config->ops, "");
+        report(config, "reinsert", inserts, config->ops, extra);
+    }
+    free(ids);
+    db_finalize(delete_stmt);
+    db_finalize(insert_stmt);
+    return result;
+}
+
+// Chain tables j1..jN through their next column, starting from one row of j1 picked by its ID
+static int join(AlilDB *db, const BenchConfig *config, int ways, double latencies[])
+{
+    char sql[512];
+    char workload[16];
+    int length = snprintf(sql, sizeof(sql), "SELECT * FROM j1 t1");
+    for (int t = 2; t <= ways; t++)
+    {
+        length += snprintf(sql + length, sizeof(sql) - length, ", j%d t%d", t, t);
+    }
+    length += snprintf(sql + length, sizeof(sql) - length, " WHERE t1.ID = ?");
+    for (int t = 2; t <= ways; t++)
+    {
+        length += snprintf(sql + length, sizeof(sql) - length, " AND t%d.ID = t%d.next", t, t - 1);
+    }
+    snprintf(sql + length, sizeof(sql) - length, ";");
+    snprintf(workload, sizeof(workload), "join_%d", ways);
+    return run_workload(db, config, workload, sql, pick_join_id, 1, latencies);
+}
+
+static int create_join_tables(AlilDB *db, const BenchConfig *config)
+{
+    char sql[128];
+    for (int t = 1; t <= MAX_JOIN_WAYS; t++)
+    {
+        snprintf(sql, sizeof(sql), "CREATE TABLE j%d (ID int, next int, PRIMARY KEY(ID));", t);
+        if (db_exec(db, sql) != 0)
+        {
+            return -1;
+        }
+        AlilStmt *stmt;
+        snprintf(sql, sizeof(sql), "INSERT INTO j%d VALUES (?, ?);", t);
+        if (db_prepare(db, sql, &stmt) != 0)
+        {
+            return -1;
+        }
+        for (int i = 0; i < config->join_rows; i++)
+        {
+            db_bind_int(stmt, 0, i);
+            db_bind_int(stmt, 1, rand() % config->join_rows);
+            if (run_timed(stmt) < 0)
+            {
+                db_finalize(stmt);
+                return -1;
+            }
+        }
+        db_finalize(stmt);
+    }
+    return 0;
+}
+
+static int parse_config(int argc, char *argv[], BenchConfig *config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        char *value = strchr(argv[i], '=');
+        int number = value ? atoi(value + 1) : 0;
+        if (number <= 0)
+        {
+            printf("Error: Expected name=value with a positive value, got %s\n", argv[i]);
+            return -1;
+        }
+        *value = '\0';
+        if (strcmp(argv[i], "rows") == 0)
+            config->rows = number;
+        else if (strcmp(argv[i], "ops") == 0)
+            config->ops = number;
+        else if (strcmp(argv[i], "join_rows") == 0)
+            config->join_rows = number;
+        else if (strcmp(argv[i], "seed") == 0)
+            config->seed = (unsigned)number;
+        else
+        {
+            printf("Error: Unknown option %s\n", argv[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config = {10000, 2000, 1000, 42};
+    if (parse_config(argc, argv, &config) != 0)
+    {
+        return 1;
+    }
+    srand(config.seed);
+
+    int most = config.rows > config.ops ? config.rows : config.ops;
+    double *latencies = malloc(sizeof(double) * most);
+    double *second = malloc(sizeof(double) * config.ops);
+    if (!latencies || !second)
+    {
+        perror("Failed to allocate latency buffers");
+        return 1;
+    }
+
+    // Statements that work on no database, e.g. CREATE DATABASE, run without a handle
+    struct stat st;
+    mkdir("databases", 0755);
+    if (stat("databases/" BENCH_DB, &st) == 0)
+    {
+        db_exec(NULL, "DROP DATABASE " BENCH_DB ";");
+    }
+    AlilDB *db;
+    if (db_exec(NULL, "CREATE DATABASE " BENCH_DB ";") != 0 || db_open(BENCH_DB, &db) != 0)
+    {
+        return 1;
+    }
+
+    int result = db_exec(db, "CREATE TABLE items (ID int, k int, name char(16), PRIMARY KEY(ID));");
+    if (result == 0)
+        result = bulk_insert(db, &config, latencies);
+    if (result == 0)
+        result = run_workload(db, &config, "point_lookup", "SELECT * FROM items WHERE ID = ?;", pick_id, 1,
+                              latencies);
+    if (result == 0)
+        result = run_workload(db, &config, "range_scan", "SELECT * FROM items WHERE k >= ? AND k < ?;",
+                              pick_range, 2, latencies);
+    if (result == 0)
+        result = run_workload(db, &config, "update", "UPDATE items SET k = ? WHERE ID = ?;", pick_update, 2,
+                              latencies);
+    if (result == 0)
+        result = delete_and_reuse(db, &config, latencies, second);
+    if (result == 0)
+        result = create_join_tables(db, &config);
+    for (int ways = 2; ways <= MAX_JOIN_WAYS && result == 0; ways++)
+    {
+        result = join(db, &config, ways, latencies);
+    }
+
+    db_close(db);
+    db_exec(NULL, "DROP DATABASE " BENCH_DB ";");
+    free(latencies);
+    free(second);
+    return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,381 @@
+// Microbenchmarks of the hot paths of a query: the primary key index (create_hash_entry and
+// find_right_entry_in_bucket), tokenize, parse_expression and evaluate_expression. Keys, statements and rows
+// come from fixed data and a fixed seed, so two builds run the same work.
+//
+// Every line reports nanoseconds, CPU cycles, heap allocations and last level cache misses per operation.
+// Cycles and cache misses come from perf_event_open and show n/a where it is not allowed, e.g. in containers
+// or with kernel.perf_event_paranoid above 2. Allocations are counted by wrapping malloc, calloc, realloc,
+// strdup and strndup at link time, see the micro_bench target of the Makefile.
+#include "hashmap.h"
+#include "hash.h"
+#include "table.h"
+#include "expression.h"
+#include "sql_tokenizer.h"
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SEED 12345u
+#define SMALL_KEY_COUNT (1 << 12)
+#define LARGE_KEY_COUNT (1 << 16)
+#define HASH_ROUNDS 20
+#define PARSE_ROUNDS 20000
+#define ROW_COUNT 4096
+#define EVALUATE_ROUNDS 50
+
+static volatile long sink;
+static long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+char *__real_strdup(const char *s);
+char *__real_strndup(const char *s, size_t n);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    allocations++;
+    return __real_strdup(s);
+}
+
+char *__wrap_strndup(const char *s, size_t n)
+{
+    allocations++;
+    return __real_strndup(s, n);
+}
+
+static const char *statements[] = {
+    "SELECT * FROM users WHERE ID = 42;",
+    "INSERT INTO users VALUES (1042, 'Alice Smith', 'alice@example.com', 31);",
+    "UPDATE products SET price = 250, name = 'Widget' WHERE ID = 7;",
+    "SELECT u.name, o.total FROM users u, orders o WHERE u.ID = o.user_id AND o.total > 100 AND u.age < 40;",
+    "SELECT dept, COUNT(*), AVG(salary) FROM employees WHERE age >= 30 OR salary < 5000 GROUP BY dept "
+    "ORDER BY dept LIMIT 10;",
+};
+
+// WHERE clauses over the columns of the benchmark table
+static const char *expressions[] = {
+    "age > 30;",
+    "age >= 25 AND age < 40 AND ID <> 7;",
+    "name = 'item42' OR (age * 2 + ID) / 3 > 50;",
+    "NOT (ID = 5) AND name <> 'x' AND age <= 60;",
+};
+
+#define STATEMENT_COUNT (int)(sizeof(statements) / sizeof(statements[0]))
+#define EXPRESSION_COUNT (int)(sizeof(expressions) / sizeof(expressions[0]))
+
+typedef struct
+{
+    double start_ns;
+    long start_allocations;
+} Measure;
+
+static int counter_fds[2] = {-1, -1}; // cycles and cache misses, -1 when the counter could not be opened
+
+static uint32_t next_random(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int open_counter(uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void begin_measure(Measure *measure)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (counter_fds[i] >= 0)
+        {
+            ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    measure->start_allocations = allocations;
+    measure->start_ns = now_ns();
+}
+
+static void format_counter(int fd, long ops, char *out, size_t size)
+{
+    long long value;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+    {
+        snprintf(out, size, "n/a");
+        return;
+    }
+    snprintf(out, size, "%.1f", (double)value / ops);
+}
+
+static void end_measure(const Measure *measure, const char *name, long ops)
+{
+    double elapsed = now_ns() - measure->start_ns;
+    long allocated = allocations - measure->start_allocations;
+    char cycles[32];
+    char misses[32];
+    for (int i = 0; i < 2; i++)
+    {
+        if (counter_fds[i] >= 0)
+        {
+            ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    format_counter(counter_fds[0], ops, cycles, sizeof(cycles));
+    format_counter(counter_fds[1], ops, misses, sizeof(misses));
+    printf("  %-34s %9.1f ns/op %10s cycles/op %7.2f allocs/op %8s misses/op\n", name, elapsed / ops, cycles,
+           (double)allocated / ops, misses);
+}
+
+// Distinct keys in a random order
+static void make_keys(int keys[], int count, uint32_t *state)
+{
+    for (int i = 0; i < count; i++)
+    {
+        keys[i] = i * 7 + 1;
+    }
+    for (int i = count - 1; i > 0; i--)
+    {
+        int j = next_random(state) % (i + 1);
+        int swap = keys[i];
+        keys[i] = keys[j];
+        keys[j] = swap;
+    }
+}
+
+static void bench_hash_index(int key_count, uint32_t *state)
+{
+    int *keys = malloc(sizeof(int) * key_count);
+    uint32_t *hashes = malloc(sizeof(uint32_t) * key_count);
+    if (!keys || !hashes)
+    {
+        perror("Failed to allocate keys");
+        exit(1);
+    }
+    make_keys(keys, key_count, state);
+    for (int i = 0; i < key_count; i++)
+    {
+        hashes[i] = word_hash_int(keys[i]);
+    }
+    printf("hash index, %d keys in %d buckets\n", key_count, DEFAULT_TABLE_SIZE);
+
+    // Tables start with DEFAULT_TABLE_SIZE buckets, so the chains are as long as in a table of this many rows
+    Measure measure;
+    HashTable *tables[HASH_ROUNDS];
+    begin_measure(&measure);
+    for (int round = 0; round < HASH_ROUNDS; round++)
+    {
+        tables[round] = create_hashtable(DEFAULT_TABLE_SIZE);
+        for (int i = 0; i < key_count; i++)
+        {
+            Key key = {.int_key = keys[i]};
+            create_hash_entry(tables[round], key, hashes[i], i);
+        }
+    }
+    end_measure(&measure, "create_hash_entry", (long)HASH_ROUNDS * key_count);
+    for (int round = 1; round < HASH_ROUNDS; round++)
+    {
+        free_hashtable(tables[round]);
+    }
+
+    make_keys(keys, key_count, state);
+    long found = 0;
+    begin_measure(&measure);
+    for (int round = 0; round < HASH_ROUNDS; round++)
+    {
+        for (int i = 0; i < key_count; i++)
+        {
+            Key key = {.int_key = keys[i]};
+            found += find_right_entry_in_bucket(tables[0], key, word_hash_int(keys[i])) != NULL;
+        }
+    }
+    end_measure(&measure, "find_right_entry_in_bucket hit", (long)HASH_ROUNDS * key_count);
+
+    // Keys that are not multiples of 7 plus 1 are absent
+    begin_measure(&measure);
+    for (int round = 0; round < HASH_ROUNDS; round++)
+    {
+        for (int i = 0; i < key_count; i++)
+        {
+            Key key = {.int_key = keys[i] + 3};
+            found += find_right_entry_in_bucket(tables[0], key, word_hash_int(keys[i] + 3)) != NULL;
+        }
+    }
+    end_measure(&measure, "find_right_entry_in_bucket miss", (long)HASH_ROUNDS * key_count);
+    sink = found;
+    free_hashtable(tables[0]);
+    free(keys);
+    free(hashes);
+}
+
+static void bench_tokenize(void)
+{
+    printf("tokenize\n");
+    for (int s = 0; s < STATEMENT_COUNT; s++)
+    {
+        char name[40];
+        int token_count = 0;
+        Measure measure;
+        begin_measure(&measure);
+        for (int round = 0; round < PARSE_ROUNDS; round++)
+        {
+            Token *tokens = tokenize(statements[s], &token_count);
+            free(tokens);
+        }
+        snprintf(name, sizeof(name), "statement %d (%d tokens)", s + 1, token_count);
+        end_measure(&measure, name, PARSE_ROUNDS);
+    }
+}
+
+static void bench_parse_expression(Token *tokens[], const int token_counts[])
+{
+    printf("parse_expression\n");
+    for (int e = 0; e < EXPRESSION_COUNT; e++)
+    {
+        char name[40];
+        Measure measure;
+        begin_measure(&measure);
+        for (int round = 0; round < PARSE_ROUNDS; round++)
+        {
+            int iterator = 0;
+            Expression *expr = parse_expression(tokens[e], &iterator, token_counts[e]);
+            free_expression(expr);
+        }
+        snprintf(name, sizeof(name), "expression %d", e + 1);
+        end_measure(&measure, name, PARSE_ROUNDS);
+    }
+}
+
+static void bench_evaluate_expression(Token *tokens[], const int token_counts[], uint32_t *state)
+{
+    // The table lives only in memory, evaluate_expression reads nothing but its columns
+    Column columns[] = {{"ID", INT, 0}, {"age", INT, 0}, {"name", STRING, 16}};
+    Table *table = calloc(1, sizeof(Table));
+    int row_size = calculate_row_size_in_bytes(columns, 3);
+    char *rows = malloc((size_t)row_size * ROW_COUNT);
+    if (!table || !rows)
+    {
+        perror("Failed to allocate rows");
+        exit(1);
+    }
+    strcpy(table->table_name, "t");
+    memcpy(table->columns, columns, sizeof(columns));
+    table->columns_count = 3;
+    table->row_size_in_bytes = row_size;
+    int age_offset = calculate_offset(table, columns[1]);
+    int name_offset = calculate_offset(table, columns[2]);
+    for (int i = 0; i < ROW_COUNT; i++)
+    {
+        char *row = rows + (size_t)i * row_size;
+        int age = next_random(state) % 80;
+        memcpy(row, &i, sizeof(int));
+        memcpy(row + age_offset, &age, sizeof(int));
+        snprintf(row + name_offset, 17, "item%u", next_random(state) % 100);
+    }
+
+    printf("evaluate_expression, %d rows\n", ROW_COUNT);
+    Table *tables[1] = {table};
+    char *alias[1] = {"t"};
+    for (int e = 0; e < EXPRESSION_COUNT; e++)
+    {
+        char name[40];
+        int iterator = 0;
+        Expression *expr = parse_expression(tokens[e], &iterator, token_counts[e]);
+        long matches = 0;
+        Measure measure;
+        begin_measure(&measure);
+        for (int round = 0; round < EVALUATE_ROUNDS; round++)
+        {
+            for (int i = 0; i < ROW_COUNT; i++)
+            {
+                char *row_datas[1] = {rows + (size_t)i * row_size};
+                matches += evaluate_expression(expr, tables, alias, row_datas, 1);
+            }
+        }
+        snprintf(name, sizeof(name), "expression %d (%ld%% match)", e + 1,
+                 matches * 100 / ((long)EVALUATE_ROUNDS * ROW_COUNT));
+        end_measure(&measure, name, (long)EVALUATE_ROUNDS * ROW_COUNT);
+        free_expression(expr);
+        sink = matches;
+    }
+    free(rows);
+    free(table);
+}
+
+int main(void)
+{
+    counter_fds[0] = open_counter(PERF_COUNT_HW_CPU_CYCLES);
+    counter_fds[1] = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+    if (counter_fds[0] < 0 || counter_fds[1] < 0)
+    {
+        printf("perf counters unavailable, cycles and cache misses are not reported\n");
+    }
+    uint32_t state = SEED;
+
+    bench_hash_index(SMALL_KEY_COUNT, &state);
+    bench_hash_index(LARGE_KEY_COUNT, &state);
+    bench_tokenize();
+
+    Token *tokens[EXPRESSION_COUNT];
+    int token_counts[EXPRESSION_COUNT];
+    for (int e = 0; e < EXPRESSION_COUNT; e++)
+    {
+        tokens[e] = tokenize(expressions[e], &token_counts[e]);
+    }
+    bench_parse_expression(tokens, token_counts);
+    bench_evaluate_expression(tokens, token_counts, &state);
+    for (int e = 0; e < EXPRESSION_COUNT; e++)
+    {
+        free(tokens[e]);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        if (counter_fds[i] >= 0)
+        {
+            close(counter_fds[i]);
+        }
+    }
+    return 0;
+}
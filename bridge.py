@@ -3,6 +3,7 @@ from flask_cors import CORS
 import subprocess
 import threading
 import queue
+import struct
 import os
 
 app = Flask(__name__)
@@ -14,42 +15,151 @@ dbms_proc = subprocess.Popen(
     ["./dbms"],
     stdin=subprocess.PIPE,
     stdout=subprocess.PIPE,
-    text=True,
-    bufsize=1,
+    bufsize=0,
     cwd=working_dir,  # This ensures DBMS can find ./databases
 )
 
-output_queue = queue.Queue()
+# Requests go out as batches tagged with an id, see src/main.c. Answers are matched to their requests by id,
+# so any number of requests can be in flight on the pipe at once.
+pending = {}
+pending_lock = threading.Lock()
+next_id = 1
+
+# Value types of the binary protocol, see src/include/wire.h
+WIRE_INT32, WIRE_INT64, WIRE_DOUBLE, WIRE_TEXT = 1, 2, 3, 4
+
+
+def read_exactly(stream, size):
+    data = b""
+    while len(data) < size:
+        chunk = stream.read(size - len(data))
+        if not chunk:
+            raise EOFError("DBMS closed its output")
+        data += chunk
+    return data
+
+
+def read_frame(stream):
+    header = read_exactly(stream, 5)
+    (length,) = struct.unpack_from("<I", header, 1)
+    return chr(header[0]), read_exactly(stream, length)
+
+
+def parse_schema(payload):
+    (count,) = struct.unpack_from("<H", payload)
+    offset, columns = 2, []
+    for _ in range(count):
+        kind, name_length = payload[offset], payload[offset + 1]
+        name = payload[offset + 2 : offset + 2 + name_length].decode()
+        columns.append((name, kind))
+        offset += 2 + name_length
+    return columns
+
+
+def parse_batch(payload, columns):
+    (count,) = struct.unpack_from("<I", payload)
+    offset, rows = 4, []
+    bitmap_size = (len(columns) + 7) // 8
+    for _ in range(count):
+        bitmap = payload[offset : offset + bitmap_size]
+        offset += bitmap_size
+        row = []
+        for i, (_, kind) in enumerate(columns):
+            if bitmap[i // 8] >> (i % 8) & 1:
+                row.append(None)
+            elif kind == WIRE_INT32:
+                row.append(struct.unpack_from("<i", payload, offset)[0])
+                offset += 4
+            elif kind == WIRE_INT64:
+                row.append(struct.unpack_from("<q", payload, offset)[0])
+                offset += 8
+            elif kind == WIRE_DOUBLE:
+                row.append(struct.unpack_from("<d", payload, offset)[0])
+                offset += 8
+            else:
+                (length,) = struct.unpack_from("<H", payload, offset)
+                row.append(payload[offset + 2 : offset + 2 + length].decode())
+                offset += 2 + length
+        rows.append(row)
+    return rows
 
 
 def dbms_reader():
-    buffer = []
-    for line in dbms_proc.stdout:
-        line = line.strip()
-        if line == "!END!":
-            output_queue.put(buffer)
-            buffer = []
-        else:
-            buffer.append(line)
+    response = {"results": [], "messages": []}
+    columns = []
+    while True:
+        kind, payload = read_frame(dbms_proc.stdout)
+        if kind == "S":
+            columns = parse_schema(payload)
+            response["results"].append({"columns": [name for name, _ in columns], "rows": []})
+        elif kind == "B":
+            response["results"][-1]["rows"].extend(parse_batch(payload, columns))
+        elif kind == "M":
+            response["messages"].extend(payload.decode().splitlines())
+        elif kind == "E":
+            response["status"], request_id = struct.unpack("<iI", payload)
+            with pending_lock:
+                answer = pending.pop(request_id, None)
+            if answer is not None:
+                answer.put(response)
+            response = {"results": [], "messages": []}
+
+
+def render(response):
+    # The page shows lines of text, rows keep the look of the text protocol
+    lines = []
+    for result in response["results"]:
+        if not result["rows"]:
+            lines.append("No matching records found")
+        for row in result["rows"]:
+            lines.append("".join("%s, " % ("NULL" if v is None else "%.2f" % v if isinstance(v, float) else v) for v in row))
+    return lines + response["messages"]
+
+
+def send(batches):
+    # Write all batches in one go and return the queues their answers arrive on
+    global next_id
+    answers, data = [], b""
+    with pending_lock:
+        for sql in batches:
+            answer = queue.Queue(maxsize=1)
+            pending[next_id] = answer
+            answers.append(answer)
+            lines = [line for line in sql.splitlines() if line.strip() != "!GO"]
+            data += b"!BATCH %d\n" % next_id + "\n".join(lines).encode() + b"\n!GO\n"
+            next_id = next_id % 0xFFFFFFFF + 1
+        dbms_proc.stdin.write(data)
+        dbms_proc.stdin.flush()
+    return answers
 
 
 threading.Thread(target=dbms_reader, daemon=True).start()
+# The switch goes out as a plain line, its answer has id 0 and is already in frames
+switched = queue.Queue(maxsize=1)
+with pending_lock:
+    pending[0] = switched
+    dbms_proc.stdin.write(b"SET PROTOCOL BINARY;\n")
+    dbms_proc.stdin.flush()
+switched.get(timeout=5)
 
 
 @app.route("/query", methods=["POST"])
 def query():
-    sql = request.get_json().get("query", "").strip()
-    if not sql:
+    # "query" holds one request of any number of statements, "queries" a list of requests sent pipelined
+    body = request.get_json()
+    batches = body.get("queries") or [body.get("query", "")]
+    batches = [sql.strip() for sql in batches if sql and sql.strip()]
+    if not batches:
         return jsonify({"error": "No query provided"}), 400
 
-    dbms_proc.stdin.write(sql + "\n")
-    dbms_proc.stdin.flush()
-
+    answers = send(batches)
     try:
-        result = output_queue.get(timeout=5)
-        return jsonify(result)
+        results = [answer.get(timeout=5) for answer in answers]
     except queue.Empty:
         return jsonify({"error": "DBMS did not respond in time"}), 504
+    if request.args.get("format") != "rows":
+        results = [render(result) for result in results]
+    return jsonify(results if "queries" in body else results[0])
 
 
 if __name__ == "__main__":
@@ -0,0 +1,396 @@
+#include "aggregate.h"
+#include "sql_tokenizer.h"
+#include "planner.h"
+#include "storage.h"
+#include "hash.h"
+#include "arena.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_GROUP_SLOTS 64
+
+static const char *function_names[] = {"COUNT", "SUM", "MIN", "MAX", "AVG"};
+
+int parse_aggregate_function(const char *name, int length)
+{
+    for (int i = 0; i < (int)(sizeof(function_names) / sizeof(function_names[0])); i++)
+    {
+        if ((int)strlen(function_names[i]) == length && strncmp(function_names[i], name, length) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *aggregate_function_name(AggregateFunction function)
+{
+    return function_names[function];
+}
+
+static int column_width(const Column *column)
+{
+    return column->type == INT ? (int)sizeof(int) : column->lenght + 1;
+}
+
+int init_group_table(GroupTable *groups, const SelectQuery *query)
+{
+    memset(groups, 0, sizeof(GroupTable));
+    groups->query = query;
+    for (int i = 0; i < query->group_count; i++)
+    {
+        int t = resolve_named_column((Table **)query->tables, (char **)query->alias, query->table_count, query->group_alias[i],
+                                     query->group_names[i], &groups->column_indexes[i]);
+        if (t < 0)
+        {
+            printf(t == -2 ? "Error: Column %s exists in more than one table, give specifications\n"
+                           : "Error: GROUP BY column %s does not exist\n",
+                   query->group_names[i]);
+            return -1;
+        }
+        groups->column_tables[i] = t;
+        groups->key_offsets[i] = groups->key_size;
+        groups->key_size += column_width(&query->tables[t]->columns[groups->column_indexes[i]]);
+    }
+
+    for (int i = 0; i < query->column_count; i++)
+    {
+        if (query->item_aggregate[i] >= 0)
+        {
+            continue;
+        }
+        int column_index;
+        int t = resolve_named_column((Table **)query->tables, (char **)query->alias, query->table_count, query->column_alias[i],
+                                     query->column_names[i], &column_index);
+        groups->item_columns[i] = -1;
+        for (int g = 0; g < query->group_count; g++)
+        {
+            if (groups->column_tables[g] == t && groups->column_indexes[g] == column_index)
+            {
+                groups->item_columns[i] = g;
+            }
+        }
+        if (groups->item_columns[i] < 0)
+        {
+            printf("Error: Column %s must appear in GROUP BY or be used in an aggregate function\n", query->column_names[i]);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < query->aggregate_count; i++)
+    {
+        const Aggregate *aggregate = &query->aggregates[i];
+        if (aggregate->function == AGGREGATE_COUNT || !aggregate->argument ||
+            (aggregate->argument->type != EXPR_COLUMN && aggregate->argument->type != EXPR_ALIAS_COLUMN))
+        {
+            continue;
+        }
+        int column_index;
+        int t = resolve_column(aggregate->argument, (Table **)query->tables, (char **)query->alias, query->table_count,
+                               &column_index);
+        if (t >= 0 && query->tables[t]->columns[column_index].type != INT)
+        {
+            printf("Error: %s needs an INT argument\n", aggregate_function_name(aggregate->function));
+            return -1;
+        }
+    }
+
+    groups->slot_count = INITIAL_GROUP_SLOTS;
+    groups->slots = calloc(groups->slot_count, sizeof(AggregateGroup *));
+    if (!groups->slots)
+    {
+        perror("Failed to allocate memory for group table");
+        return -1;
+    }
+    return 0;
+}
+
+void mark_group_columns(const GroupTable *groups, QueryPlan *plan)
+{
+    const SelectQuery *query = groups->query;
+    for (int i = 0; i < query->group_count; i++)
+    {
+        plan->used_columns[groups->column_tables[i]][groups->column_indexes[i]] = COLUMN_VALUES;
+    }
+    for (int i = 0; i < query->aggregate_count; i++)
+    {
+        mark_used_columns(plan, query->aggregates[i].argument, (Table **)query->tables, (char **)query->alias,
+                          query->table_count);
+    }
+}
+
+// Double the index once it is half full, the groups themselves stay where they are
+static int grow_slots(GroupTable *groups)
+{
+    int slot_count = groups->slot_count * 2;
+    AggregateGroup **slots = calloc(slot_count, sizeof(AggregateGroup *));
+    if (!slots)
+    {
+        perror("Failed to allocate memory for group table");
+        return -1;
+    }
+    for (int i = 0; i < groups->group_count; i++)
+    {
+        uint32_t slot = groups->groups[i]->hash & (slot_count - 1);
+        while (slots[slot])
+        {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = groups->groups[i];
+    }
+    free(groups->slots);
+    groups->slots = slots;
+    groups->slot_count = slot_count;
+    return 0;
+}
+
+static AggregateGroup *add_group(GroupTable *groups, const char *key, uint32_t hash)
+{
+    if ((groups->group_count + 1) * 2 > groups->slot_count && grow_slots(groups) != 0)
+    {
+        return NULL;
+    }
+    if (groups->group_count == groups->group_capacity)
+    {
+        int capacity = groups->group_capacity ? groups->group_capacity * 2 : INITIAL_GROUP_SLOTS;
+        AggregateGroup **grown = realloc(groups->groups, capacity * sizeof(AggregateGroup *));
+        if (!grown)
+        {
+            perror("Failed to allocate memory for groups");
+            return NULL;
+        }
+        groups->groups = grown;
+        groups->group_capacity = capacity;
+    }
+
+    int aggregate_count = groups->query->aggregate_count;
+    Arena *arena = get_query_arena();
+    AggregateGroup *group = arena_alloc(arena, sizeof(AggregateGroup) + aggregate_count * sizeof(AggregateState));
+    char *group_key = arena_alloc(arena, groups->key_size > 0 ? groups->key_size : 1);
+    if (!group || !group_key)
+    {
+        return NULL;
+    }
+    group->hash = hash;
+    group->key = group_key;
+    memcpy(group->key, key, groups->key_size);
+    for (int i = 0; i < aggregate_count; i++)
+    {
+        group->states[i].count = 0;
+        group->states[i].sum = 0;
+        group->states[i].min = INT_MAX;
+        group->states[i].max = INT_MIN;
+    }
+
+    uint32_t slot = hash & (groups->slot_count - 1);
+    while (groups->slots[slot])
+    {
+        slot = (slot + 1) & (groups->slot_count - 1);
+    }
+    groups->slots[slot] = group;
+    groups->groups[groups->group_count++] = group;
+    return group;
+}
+
+void aggregate_row(GroupTable *groups, Table *tables[], char *alias[], char *rows[], int table_count)
+{
+    const SelectQuery *query = groups->query;
+    char key[groups->key_size > 0 ? groups->key_size : 1];
+    for (int i = 0; i < query->group_count; i++)
+    {
+        const Table *table = tables[groups->column_tables[i]];
+        const Column *column = &table->columns[groups->column_indexes[i]];
+        const char *value = rows[groups->column_tables[i]] + calculate_offset(table, *column);
+        if (column->type == INT)
+        {
+            memcpy(key + groups->key_offsets[i], value, sizeof(int));
+        }
+        else
+        {
+            // Zero the bytes after the string so equal strings give equal keys
+            strncpy(key + groups->key_offsets[i], value, column->lenght);
+            key[groups->key_offsets[i] + column->lenght] = '\0';
+        }
+    }
+
+    uint32_t hash = word_hash_bytes(key, groups->key_size);
+    uint32_t slot = hash & (groups->slot_count - 1);
+    AggregateGroup *group = groups->slots[slot];
+    while (group && (group->hash != hash || memcmp(group->key, key, groups->key_size) != 0))
+    {
+        slot = (slot + 1) & (groups->slot_count - 1);
+        group = groups->slots[slot];
+    }
+    if (!group)
+    {
+        group = add_group(groups, key, hash);
+        if (!group)
+        {
+            groups->failed = 1;
+            return;
+        }
+    }
+
+    for (int i = 0; i < query->aggregate_count; i++)
+    {
+        const Aggregate *aggregate = &query->aggregates[i];
+        AggregateState *state = &group->states[i];
+        state->count++;
+        if (aggregate->function == AGGREGATE_COUNT)
+        {
+            continue;
+        }
+        int value = evaluate_expression(aggregate->argument, tables, alias, rows, table_count);
+        state->sum += value;
+        state->min = value < state->min ? value : state->min;
+        state->max = value > state->max ? value : state->max;
+    }
+}
+
+int is_count_only(const GroupTable *groups)
+{
+    const SelectQuery *query = groups->query;
+    if (query->group_count > 0)
+    {
+        return 0;
+    }
+    for (int i = 0; i < query->column_count; i++)
+    {
+        if (query->item_aggregate[i] < 0)
+        {
+            return 0;
+        }
+    }
+    for (int i = 0; i < query->aggregate_count; i++)
+    {
+        if (query->aggregates[i].function != AGGREGATE_COUNT)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int add_counted_rows(GroupTable *groups, long count)
+{
+    if (count == 0)
+    {
+        return 0; // print_groups already reports a zero count without a group
+    }
+    char key[1] = {0};
+    AggregateGroup *group = groups->group_count > 0 ? groups->groups[0] : add_group(groups, key, word_hash_bytes(key, 0));
+    if (!group)
+    {
+        groups->failed = 1;
+        return -1;
+    }
+    for (int i = 0; i < groups->query->aggregate_count; i++)
+    {
+        group->states[i].count += count;
+    }
+    return 0;
+}
+
+void describe_groups(const GroupTable *groups, const char *names[], WireType types[])
+{
+    const SelectQuery *query = groups->query;
+    for (int i = 0; i < query->column_count; i++)
+    {
+        int a = query->item_aggregate[i];
+        if (a >= 0)
+        {
+            AggregateFunction function = query->aggregates[a].function;
+            names[i] = aggregate_function_name(function);
+            types[i] = function == AGGREGATE_AVG                                   ? WIRE_DOUBLE
+                       : function == AGGREGATE_COUNT || function == AGGREGATE_SUM ? WIRE_INT64
+                                                                                   : WIRE_INT32;
+            continue;
+        }
+        int c = groups->item_columns[i];
+        const Column *column = &query->tables[groups->column_tables[c]]->columns[groups->column_indexes[c]];
+        names[i] = column->name;
+        types[i] = column->type == INT ? WIRE_INT32 : WIRE_TEXT;
+    }
+}
+
+static void print_aggregate(const Aggregate *aggregate, const AggregateState *state, ResultWriter *out)
+{
+    if (aggregate->function == AGGREGATE_COUNT)
+    {
+        write_int64(out, state->count);
+        return;
+    }
+    if (state->count == 0)
+    {
+        write_null(out); // only without GROUP BY, over no rows
+        return;
+    }
+    switch (aggregate->function)
+    {
+    case AGGREGATE_SUM:
+        write_int64(out, state->sum);
+        break;
+    case AGGREGATE_MIN:
+        write_int32(out, state->min);
+        break;
+    case AGGREGATE_MAX:
+        write_int32(out, state->max);
+        break;
+    case AGGREGATE_AVG:
+        write_double(out, (double)state->sum / state->count);
+        break;
+    default:
+        break;
+    }
+}
+
+void print_groups(const GroupTable *groups, ResultWriter *out)
+{
+    const SelectQuery *query = groups->query;
+    // Without GROUP BY the aggregates make one row even when no row matched
+    AggregateState empty[query->aggregate_count > 0 ? query->aggregate_count : 1];
+    for (int i = 0; i < query->aggregate_count; i++)
+    {
+        empty[i].count = 0;
+    }
+    long row_count = query->group_count == 0 && groups->group_count == 0 ? 1 : groups->group_count;
+    long first = query->offset;
+    long last = query->limit >= 0 && first + query->limit < row_count ? first + query->limit : row_count;
+    for (long g = first; g < last; g++)
+    {
+        const AggregateGroup *group = groups->group_count > 0 ? groups->groups[g] : NULL;
+        for (int i = 0; i < query->column_count; i++)
+        {
+            int a = query->item_aggregate[i];
+            if (a >= 0)
+            {
+                print_aggregate(&query->aggregates[a], group ? &group->states[a] : &empty[a], out);
+                continue;
+            }
+            int c = groups->item_columns[i];
+            const Column *column = &query->tables[groups->column_tables[c]]->columns[groups->column_indexes[c]];
+            const char *value = group->key + groups->key_offsets[c];
+            if (column->type == INT)
+            {
+                int number;
+                memcpy(&number, value, sizeof(int));
+                write_int32(out, number);
+            }
+            else
+            {
+                write_text(out, value);
+            }
+        }
+        end_row(out);
+    }
+}
+
+void free_group_table(GroupTable *groups)
+{
+    free(groups->slots);
+    free(groups->groups);
+    groups->slots = NULL;
+    groups->groups = NULL;
+    groups->group_count = 0;
+}
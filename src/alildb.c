@@ -0,0 +1,363 @@
+#include "alildb.h"
+#include "sql_tokenizer.h"
+#include "prepared.h"
+#include "planner.h"
+#include "storage.h"
+#include "file_io.h"
+#include "arena.h"
+#include "result_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DB_MAX_COLUMNS (MAX_JOIN_COUNT * MAX_COLUMN_COUNT) // SELECT * over the widest join
+
+struct AlilDB
+{
+    char name[MAX_NAME_LEN + 1];
+};
+
+struct AlilStmt
+{
+    PreparedStatement *prepared;
+    int executed;
+    char *result; // the result in frames of the binary protocol
+    size_t result_length;
+    ResultReader reader;
+    int has_row;
+    // A plain SELECT returns row positions, its columns are read from the rows themselves
+    int row_mode;
+    int column_count;
+    int column_tables[DB_MAX_COLUMNS];
+    const Column *columns[DB_MAX_COLUMNS];
+    int column_offsets[DB_MAX_COLUMNS];
+    TableStorage storages[MAX_JOIN_COUNT];
+    char *rows[MAX_JOIN_COUNT];
+    int storage_count; // storages opened so far
+};
+
+static AlilDB *open_db = NULL;
+
+int db_open(const char *name, AlilDB **db)
+{
+    if (open_db || is_db_loaded())
+    {
+        printf("Error: A database is already open\n");
+        return -1;
+    }
+    if (strlen(name) > MAX_NAME_LEN)
+    {
+        printf("Error: Database name is too long\n");
+        return -1;
+    }
+    AlilDB *handle = calloc(1, sizeof(AlilDB));
+    if (!handle)
+    {
+        perror("Failed to allocate memory for database handle");
+        return -1;
+    }
+    if (load_db(name) != 0)
+    {
+        free(handle);
+        return -1;
+    }
+    strcpy(handle->name, name);
+    open_db = handle;
+    *db = handle;
+    return 0;
+}
+
+void db_close(AlilDB *db)
+{
+    if (!db)
+    {
+        return;
+    }
+    clear_result_cache();
+    free_globals();
+    arena_free(get_query_arena());
+    open_db = NULL;
+    free(db);
+}
+
+int db_exec(AlilDB *db, const char *sql)
+{
+    (void)db;
+    int token_count = 0;
+    Token *tokens = tokenize(sql, &token_count);
+    if (!tokens)
+    {
+        return -1;
+    }
+    int result = parser(tokens, token_count);
+    free(tokens);
+    return result;
+}
+
+int db_prepare(AlilDB *db, const char *sql, AlilStmt **stmt)
+{
+    (void)db;
+    AlilStmt *handle = calloc(1, sizeof(AlilStmt));
+    if (!handle)
+    {
+        perror("Failed to allocate memory for statement");
+        return -1;
+    }
+    handle->prepared = prepare_statement(sql);
+    if (!handle->prepared)
+    {
+        free(handle);
+        return -1;
+    }
+    *stmt = handle;
+    return 0;
+}
+
+int db_bind_int(AlilStmt *stmt, int index, int value)
+{
+    db_reset(stmt);
+    return bind_parameter_int(stmt->prepared, index, value);
+}
+
+int db_bind_text(AlilStmt *stmt, int index, const char *value)
+{
+    db_reset(stmt);
+    return bind_parameter_text(stmt->prepared, index, value);
+}
+
+// Pick the columns a plain SELECT returns and where they sit in the row images of its tables
+static int resolve_row_columns(AlilStmt *stmt)
+{
+    const SelectQuery *query = &stmt->prepared->select;
+    stmt->column_count = 0;
+    for (int t = 0; t < query->table_count && query->all; t++)
+    {
+        for (int c = 0; c < query->tables[t]->columns_count; c++)
+        {
+            stmt->column_tables[stmt->column_count] = t;
+            stmt->columns[stmt->column_count] = &query->tables[t]->columns[c];
+            stmt->column_count++;
+        }
+    }
+    for (int i = 0; i < query->column_count && !query->all; i++)
+    {
+        int column_index;
+        int t = resolve_named_column((Table **)query->tables, (char **)query->alias, query->table_count,
+                                     query->column_alias[i], query->column_names[i], &column_index);
+        if (t < 0)
+        {
+            printf("Error: Column %s does not exist\n", query->column_names[i]);
+            return -1;
+        }
+        stmt->column_tables[stmt->column_count] = t;
+        stmt->columns[stmt->column_count] = &query->tables[t]->columns[column_index];
+        stmt->column_count++;
+    }
+    for (int i = 0; i < stmt->column_count; i++)
+    {
+        stmt->column_offsets[i] = calculate_offset(query->tables[stmt->column_tables[i]], *stmt->columns[i]);
+    }
+    return 0;
+}
+
+// Run the statement with its result set written as frames into memory
+static int execute(AlilStmt *stmt)
+{
+    FILE *out = open_memstream(&stmt->result, &stmt->result_length);
+    if (!out)
+    {
+        perror("Failed to open result buffer");
+        return -1;
+    }
+    Protocol protocol = get_protocol();
+    Arena *arena = get_query_arena();
+    ArenaMark mark = arena_mark(arena);
+    set_protocol(PROTOCOL_BINARY);
+    set_result_stream(out);
+    int result = execute_prepared_statement(stmt->prepared);
+    set_result_stream(NULL);
+    set_protocol(protocol);
+    arena_release(arena, mark);
+    fclose(out);
+    stmt->executed = 1;
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    int found = open_result(&stmt->reader, stmt->result, stmt->result_length);
+    if (found <= 0)
+    {
+        stmt->column_count = 0;
+        return found;
+    }
+    const SelectQuery *query = &stmt->prepared->select;
+    stmt->row_mode = stmt->prepared->kind == PREPARED_SELECT && query->aggregate_count == 0 && query->group_count == 0;
+    if (!stmt->row_mode)
+    {
+        stmt->column_count = stmt->reader.column_count;
+        return 0;
+    }
+    if (resolve_row_columns(stmt) != 0)
+    {
+        return -1;
+    }
+    for (; stmt->storage_count < query->table_count; stmt->storage_count++)
+    {
+        int t = stmt->storage_count;
+        stmt->rows[t] = calloc(query->tables[t]->row_size_in_bytes, sizeof(char));
+        if (!stmt->rows[t] || open_table_storage(&stmt->storages[t], query->tables[t], "rb", NULL) != 0)
+        {
+            printf("Error: Could not prepare table %s for reading\n", query->tables[t]->table_name);
+            free(stmt->rows[t]);
+            stmt->rows[t] = NULL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int db_step(AlilStmt *stmt)
+{
+    if (!stmt->executed && execute(stmt) != 0)
+    {
+        return -1;
+    }
+    stmt->has_row = 0;
+    if (!stmt->result || stmt->reader.column_count == 0)
+    {
+        return DB_DONE;
+    }
+    int found = next_result_row(&stmt->reader);
+    if (found <= 0)
+    {
+        return found;
+    }
+    if (stmt->row_mode)
+    {
+        // The row positions arrive in table order, read the rows they point at
+        for (int t = 0; t < stmt->storage_count; t++)
+        {
+            if (read_table_rows(&stmt->storages[t], (long)stmt->reader.ints[t], stmt->rows[t], 1) != 1)
+            {
+                printf("Error: Could not read row %lld of table %s\n", stmt->reader.ints[t],
+                       stmt->prepared->select.tables[t]->table_name);
+                return -1;
+            }
+        }
+    }
+    stmt->has_row = 1;
+    return DB_ROW;
+}
+
+void db_reset(AlilStmt *stmt)
+{
+    for (int t = 0; t < stmt->storage_count; t++)
+    {
+        close_table_storage(&stmt->storages[t]);
+        free(stmt->rows[t]);
+        stmt->rows[t] = NULL;
+    }
+    stmt->storage_count = 0;
+    close_result(&stmt->reader);
+    memset(&stmt->reader, 0, sizeof(ResultReader));
+    free(stmt->result);
+    stmt->result = NULL;
+    stmt->result_length = 0;
+    stmt->executed = 0;
+    stmt->has_row = 0;
+    stmt->row_mode = 0;
+    stmt->column_count = 0;
+}
+
+int db_column_count(const AlilStmt *stmt)
+{
+    return stmt->column_count;
+}
+
+static int valid_column(const AlilStmt *stmt, int column)
+{
+    return column >= 0 && column < stmt->column_count;
+}
+
+const char *db_column_name(const AlilStmt *stmt, int column)
+{
+    if (!valid_column(stmt, column))
+    {
+        return NULL;
+    }
+    return stmt->row_mode ? stmt->columns[column]->name : stmt->reader.names[column];
+}
+
+WireType db_column_type(const AlilStmt *stmt, int column)
+{
+    if (!valid_column(stmt, column))
+    {
+        return WIRE_INT32;
+    }
+    if (stmt->row_mode)
+    {
+        return stmt->columns[column]->type == INT ? WIRE_INT32 : WIRE_TEXT;
+    }
+    return stmt->reader.types[column];
+}
+
+int db_column_is_null(const AlilStmt *stmt, int column)
+{
+    return stmt->has_row && valid_column(stmt, column) && !stmt->row_mode && stmt->reader.nulls[column];
+}
+
+// Where the value of a row mode column starts in its row image
+static const char *row_value(const AlilStmt *stmt, int column)
+{
+    return stmt->rows[stmt->column_tables[column]] + stmt->column_offsets[column];
+}
+
+long long db_column_int64(const AlilStmt *stmt, int column)
+{
+    if (!stmt->has_row || !valid_column(stmt, column) || db_column_type(stmt, column) == WIRE_TEXT)
+    {
+        return 0;
+    }
+    if (stmt->row_mode)
+    {
+        int value;
+        memcpy(&value, row_value(stmt, column), sizeof(int));
+        return value;
+    }
+    return stmt->reader.ints[column];
+}
+
+int db_column_int(const AlilStmt *stmt, int column)
+{
+    return (int)db_column_int64(stmt, column);
+}
+
+double db_column_double(const AlilStmt *stmt, int column)
+{
+    if (stmt->has_row && valid_column(stmt, column) && !stmt->row_mode)
+    {
+        return stmt->reader.doubles[column];
+    }
+    return (double)db_column_int64(stmt, column);
+}
+
+const char *db_column_text(const AlilStmt *stmt, int column)
+{
+    if (!stmt->has_row || !valid_column(stmt, column) || db_column_type(stmt, column) != WIRE_TEXT ||
+        db_column_is_null(stmt, column))
+    {
+        return NULL;
+    }
+    return stmt->row_mode ? row_value(stmt, column) : result_text(&stmt->reader, column);
+}
+
+void db_finalize(AlilStmt *stmt)
+{
+    if (!stmt)
+    {
+        return;
+    }
+    db_reset(stmt);
+    free_prepared_statement(stmt->prepared);
+    free(stmt);
+}
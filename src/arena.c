@@ -0,0 +1,85 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+
+static Arena query_arena;
+
+Arena *get_query_arena()
+{
+    return &query_arena;
+}
+
+static ArenaChunk *new_chunk(Arena *arena, size_t size)
+{
+    if (arena->spare && arena->spare->size >= size)
+    {
+        ArenaChunk *chunk = arena->spare;
+        arena->spare = NULL;
+        return chunk;
+    }
+    ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + size);
+    if (!chunk)
+    {
+        perror("Failed to allocate memory for arena");
+        return NULL;
+    }
+    chunk->size = size;
+    return chunk;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size_t align = alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+    ArenaChunk *chunk = arena->head;
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        chunk = new_chunk(arena, size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE);
+        if (!chunk)
+        {
+            return NULL;
+        }
+        chunk->used = 0;
+        chunk->next = arena->head;
+        arena->head = chunk;
+    }
+    void *memory = chunk->data + chunk->used;
+    chunk->used += size;
+    return memory;
+}
+
+ArenaMark arena_mark(const Arena *arena)
+{
+    ArenaMark mark = {arena->head, arena->head ? arena->head->used : 0};
+    return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark)
+{
+    while (arena->head != mark.chunk)
+    {
+        ArenaChunk *chunk = arena->head;
+        arena->head = chunk->next;
+        if (!arena->spare && chunk->size == ARENA_CHUNK_SIZE)
+        {
+            arena->spare = chunk;
+        }
+        else
+        {
+            free(chunk);
+        }
+    }
+    if (arena->head)
+    {
+        arena->head->used = mark.used;
+    }
+}
+
+void arena_free(Arena *arena)
+{
+    ArenaMark start = {NULL, 0};
+    arena_release(arena, start);
+    free(arena->spare);
+    arena->spare = NULL;
+}
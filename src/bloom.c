@@ -0,0 +1,199 @@
+#include "bloom.h"
+#include "table.h"
+#include "file_io.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define BLOOM_BLOCK_SIZE (BLOOM_BLOCK_WORDS * sizeof(uint32_t))
+
+// Odd multipliers picking the bit of every word, from the split block Bloom filter of Parquet
+static const uint32_t bloom_salts[BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+static void bloom_path(const Table *table, char *filename, size_t size)
+{
+    snprintf(filename, size, "%s/hashmaps/%s.bloom", get_root(), table->table_name);
+}
+
+// FNV-1a of sequential keys differs mostly in the low bits, spread it over 64 bits before splitting it
+static uint64_t mix_hash(uint32_t hash)
+{
+    uint64_t x = hash;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint32_t *key_block(const BloomFilter *bloom, uint64_t mixed, int *block)
+{
+    *block = (int)(((mixed >> 32) * (uint64_t)bloom->block_count) >> 32);
+    return bloom->blocks + (size_t)*block * BLOOM_BLOCK_WORDS;
+}
+
+int init_bloom_filter(BloomFilter *bloom, int capacity)
+{
+    memset(bloom, 0, sizeof(BloomFilter));
+    bloom->capacity = capacity < BLOOM_INITIAL_KEYS ? BLOOM_INITIAL_KEYS : capacity;
+    bloom->block_count = (int)(((long)bloom->capacity * BLOOM_BITS_PER_KEY + BLOOM_BLOCK_WORDS * 32 - 1) / (BLOOM_BLOCK_WORDS * 32));
+    bloom->blocks = calloc(bloom->block_count, BLOOM_BLOCK_SIZE);
+    if (!bloom->blocks)
+    {
+        perror("Failed to allocate memory for bloom filter");
+        return -1;
+    }
+    bloom->dirty_from = -1;
+    bloom->resized = 1;
+    bloom->fd = -1;
+    return 0;
+}
+
+void free_bloom_filter(BloomFilter *bloom)
+{
+    if (bloom->fd >= 0)
+    {
+        close(bloom->fd);
+        bloom->fd = -1;
+    }
+    free(bloom->blocks);
+    bloom->blocks = NULL;
+    bloom->block_count = 0;
+}
+
+void bloom_add(BloomFilter *bloom, uint32_t hash)
+{
+    uint64_t mixed = mix_hash(hash);
+    int block;
+    uint32_t *words = key_block(bloom, mixed, &block);
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++)
+    {
+        words[i] |= 1U << (((uint32_t)mixed * bloom_salts[i]) >> 27);
+    }
+    bloom->keys++;
+    if (bloom->dirty_from < 0 || block < bloom->dirty_from)
+    {
+        bloom->dirty_from = block;
+    }
+    if (block + 1 > bloom->dirty_to)
+    {
+        bloom->dirty_to = block + 1;
+    }
+}
+
+int bloom_may_contain(const BloomFilter *bloom, uint32_t hash)
+{
+    uint64_t mixed = mix_hash(hash);
+    int block;
+    const uint32_t *words = key_block(bloom, mixed, &block);
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++)
+    {
+        if (!(words[i] & (1U << (((uint32_t)mixed * bloom_salts[i]) >> 27))))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int flush_bloom_filter(Table *table)
+{
+    BloomFilter *bloom = &table->hash->bloom;
+    if (bloom->fd < 0 || bloom->resized)
+    {
+        char filename[MAX_NAME_LEN * 2 + 24];
+        bloom_path(table, filename, sizeof(filename));
+        if (bloom->fd >= 0)
+        {
+            close(bloom->fd);
+        }
+        bloom->fd = bloom->resized ? -1 : open(filename, O_RDWR);
+        if (bloom->fd < 0)
+        {
+            bloom->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            bloom->dirty_from = 0;
+            bloom->dirty_to = bloom->block_count;
+        }
+        if (bloom->fd < 0)
+        {
+            perror("Failed to open bloom filter file");
+            return -1;
+        }
+    }
+
+    // Header: block count, capacity and keys, then the blocks
+    int header[3] = {bloom->block_count, bloom->capacity, bloom->keys};
+    int result = 0;
+    if (pwrite(bloom->fd, header, sizeof(header), 0) != (ssize_t)sizeof(header))
+    {
+        result = -1;
+    }
+    if (result == 0 && bloom->dirty_from >= 0 && bloom->dirty_from < bloom->dirty_to)
+    {
+        size_t size = (size_t)(bloom->dirty_to - bloom->dirty_from) * BLOOM_BLOCK_SIZE;
+        if (pwrite(bloom->fd, bloom->blocks + (size_t)bloom->dirty_from * BLOOM_BLOCK_WORDS, size,
+                   (off_t)(sizeof(header) + (size_t)bloom->dirty_from * BLOOM_BLOCK_SIZE)) != (ssize_t)size)
+        {
+            result = -1;
+        }
+    }
+    if (result != 0)
+    {
+        perror("Failed to write bloom filter file");
+        return -1;
+    }
+    bloom->dirty_from = -1;
+    bloom->dirty_to = 0;
+    bloom->resized = 0;
+    return 0;
+}
+
+int load_bloom_filter(Table *table)
+{
+    BloomFilter *bloom = &table->hash->bloom;
+    char filename[MAX_NAME_LEN * 2 + 24];
+    bloom_path(table, filename, sizeof(filename));
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        // Tables created before the filter existed get theirs from the loaded entries
+        return rebuild_bloom_filter(table->hash) == 0 ? flush_bloom_filter(table) : -1;
+    }
+
+    int block_count, capacity, keys;
+    if (fread(&block_count, sizeof(int), 1, file) != 1 || fread(&capacity, sizeof(int), 1, file) != 1 ||
+        fread(&keys, sizeof(int), 1, file) != 1)
+    {
+        printf("Failed to read bloom filter of table %s\n", table->table_name);
+        fclose(file);
+        return -1;
+    }
+    free_bloom_filter(bloom);
+    if (init_bloom_filter(bloom, capacity) != 0 ||
+        bloom->block_count != block_count ||
+        fread(bloom->blocks, BLOOM_BLOCK_SIZE, block_count, file) != (size_t)block_count)
+    {
+        printf("Failed to read bloom filter of table %s\n", table->table_name);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    bloom->keys = keys;
+    bloom->resized = 0;
+    return 0;
+}
+
+int remove_bloom_filter(const Table *table)
+{
+    char filename[MAX_NAME_LEN * 2 + 24];
+    bloom_path(table, filename, sizeof(filename));
+    if (remove(filename) != 0)
+    {
+        perror("Failed to delete bloom filter file");
+        return -1;
+    }
+    return 0;
+}
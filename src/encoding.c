@@ -0,0 +1,260 @@
+#include "encoding.h"
+#include "table.h"
+#include "file_io.h"
+#include <stdio.h>
+#include <string.h>
+
+#define INITIAL_DICTIONARY_CAPACITY 16
+
+static void dictionary_path(const Table *table, int column_index, char *filename, size_t size)
+{
+    snprintf(filename, size, "%s/bins/%s.%s.dict", get_root(), table->table_name, table->columns[column_index].name);
+}
+
+static uint32_t value_hash(const Dictionary *dictionary, const char *value)
+{
+    return word_hash_bytes(value, strnlen(value, dictionary->value_size));
+}
+
+static int init_dictionary(Dictionary *dictionary, int value_size)
+{
+    memset(dictionary, 0, sizeof(Dictionary));
+    dictionary->value_size = value_size;
+    dictionary->capacity = INITIAL_DICTIONARY_CAPACITY;
+    dictionary->slot_count = INITIAL_DICTIONARY_CAPACITY * 2;
+    dictionary->values = calloc(dictionary->capacity, value_size);
+    dictionary->slots = calloc(dictionary->slot_count, sizeof(int));
+    if (!dictionary->values || !dictionary->slots)
+    {
+        perror("Failed to allocate memory for dictionary");
+        free(dictionary->values);
+        free(dictionary->slots);
+        return -1;
+    }
+    return 0;
+}
+
+static void free_dictionary(Dictionary *dictionary)
+{
+    free(dictionary->values);
+    free(dictionary->slots);
+    memset(dictionary, 0, sizeof(Dictionary));
+}
+
+ColumnEncoding *create_column_encodings(const Table *table)
+{
+    ColumnEncoding *encodings = calloc(table->columns_count, sizeof(ColumnEncoding));
+    if (!encodings)
+    {
+        perror("Failed to allocate memory for column encodings");
+        return NULL;
+    }
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        encodings[i].width = 1;
+        if (table->columns[i].type == INT)
+        {
+            encodings[i].type = ENCODING_FRAME_OF_REFERENCE;
+            continue;
+        }
+        encodings[i].type = ENCODING_DICTIONARY;
+        if (init_dictionary(&encodings[i].dictionary, table->columns[i].lenght + 1) != 0)
+        {
+            free_column_encodings(encodings, i);
+            return NULL;
+        }
+    }
+    return encodings;
+}
+
+void free_column_encodings(ColumnEncoding *encodings, int columns_count)
+{
+    if (!encodings)
+    {
+        return;
+    }
+    for (int i = 0; i < columns_count; i++)
+    {
+        if (encodings[i].type == ENCODING_DICTIONARY)
+        {
+            free_dictionary(&encodings[i].dictionary);
+        }
+    }
+    free(encodings);
+}
+
+int dictionary_find(const Dictionary *dictionary, const char *value)
+{
+    int mask = dictionary->slot_count - 1;
+    for (int slot = value_hash(dictionary, value) & mask;; slot = (slot + 1) & mask)
+    {
+        int code = dictionary->slots[slot] - 1;
+        if (code < 0)
+        {
+            return -1;
+        }
+        if (strncmp(dictionary->values + (size_t)code * dictionary->value_size, value, dictionary->value_size) == 0)
+        {
+            return code;
+        }
+    }
+}
+
+static void insert_slot(Dictionary *dictionary, int code)
+{
+    int mask = dictionary->slot_count - 1;
+    int slot = value_hash(dictionary, dictionary->values + (size_t)code * dictionary->value_size) & mask;
+    while (dictionary->slots[slot] != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    dictionary->slots[slot] = code + 1;
+}
+
+static int grow_dictionary(Dictionary *dictionary)
+{
+    int capacity = dictionary->capacity * 2;
+    char *values = realloc(dictionary->values, (size_t)capacity * dictionary->value_size);
+    if (!values)
+    {
+        perror("Failed to allocate memory for dictionary");
+        return -1;
+    }
+    dictionary->values = values;
+    dictionary->capacity = capacity;
+
+    // Slots stay at most half full so probes end quickly
+    int *slots = calloc(capacity * 2, sizeof(int));
+    if (!slots)
+    {
+        perror("Failed to allocate memory for dictionary");
+        return -1;
+    }
+    free(dictionary->slots);
+    dictionary->slots = slots;
+    dictionary->slot_count = capacity * 2;
+    for (int code = 0; code < dictionary->count; code++)
+    {
+        insert_slot(dictionary, code);
+    }
+    return 0;
+}
+
+int dictionary_add(Dictionary *dictionary, const char *value, int *added)
+{
+    *added = 0;
+    int code = dictionary_find(dictionary, value);
+    if (code >= 0)
+    {
+        return code;
+    }
+    if (dictionary->count == dictionary->capacity && grow_dictionary(dictionary) != 0)
+    {
+        return -1;
+    }
+    code = dictionary->count++;
+    char *stored = dictionary->values + (size_t)code * dictionary->value_size;
+    memset(stored, 0, dictionary->value_size);
+    strncpy(stored, value, dictionary->value_size - 1);
+    insert_slot(dictionary, code);
+    *added = 1;
+    return code;
+}
+
+const char *dictionary_value(const Dictionary *dictionary, uint32_t code)
+{
+    return dictionary->values + (size_t)code * dictionary->value_size;
+}
+
+int append_dictionary_value(const Table *table, int column_index, int code)
+{
+    char filename[MAX_NAME_LEN * 3 + 16];
+    dictionary_path(table, column_index, filename, sizeof(filename));
+    FILE *file = fopen(filename, "ab");
+    if (!file)
+    {
+        perror("Failed to open dictionary file");
+        return -1;
+    }
+    const Dictionary *dictionary = &table->encodings[column_index].dictionary;
+    int result = fwrite(dictionary_value(dictionary, code), dictionary->value_size, 1, file) == 1 ? 0 : -1;
+    fclose(file);
+    return result;
+}
+
+int load_dictionaries(Table *table)
+{
+    char filename[MAX_NAME_LEN * 3 + 16];
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (table->encodings[i].type != ENCODING_DICTIONARY)
+        {
+            continue;
+        }
+        Dictionary *dictionary = &table->encodings[i].dictionary;
+        if (init_dictionary(dictionary, table->columns[i].lenght + 1) != 0)
+        {
+            return -1;
+        }
+        dictionary_path(table, i, filename, sizeof(filename));
+        FILE *file = fopen(filename, "rb");
+        if (!file)
+        {
+            perror("Failed to open dictionary file");
+            return -1;
+        }
+        // Values were appended in code order, adding them again gives back the same codes
+        char value[dictionary->value_size];
+        int added;
+        while (fread(value, dictionary->value_size, 1, file) == 1)
+        {
+            if (dictionary_add(dictionary, value, &added) < 0)
+            {
+                fclose(file);
+                return -1;
+            }
+        }
+        fclose(file);
+    }
+    return 0;
+}
+
+int create_dictionary_files(const Table *table)
+{
+    char filename[MAX_NAME_LEN * 3 + 16];
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (table->encodings[i].type != ENCODING_DICTIONARY)
+        {
+            continue;
+        }
+        dictionary_path(table, i, filename, sizeof(filename));
+        FILE *file = fopen(filename, "wb");
+        if (!file)
+        {
+            perror("Failed to create dictionary file");
+            return -1;
+        }
+        fclose(file);
+    }
+    return 0;
+}
+
+int remove_dictionary_files(const Table *table)
+{
+    char filename[MAX_NAME_LEN * 3 + 16];
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (table->encodings[i].type != ENCODING_DICTIONARY)
+        {
+            continue;
+        }
+        dictionary_path(table, i, filename, sizeof(filename));
+        if (remove(filename) != 0)
+        {
+            perror("Failed to delete dictionary file");
+            return -1;
+        }
+    }
+    return 0;
+}
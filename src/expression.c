@@ -1,4 +1,5 @@
 #include "expression.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -149,7 +150,7 @@ static Expression *parse_primary(Token *tokens, int *i)
         if (tokens[*i + 1].type == TOKEN_DOT)
         {
             expr->type = EXPR_ALIAS_COLUMN;
-            expr->alias_column.alias = strdup(tokens[*i].token);
+            expr->alias_column.alias = token_strdup(&tokens[*i]);
             (*i) += 2; // skip .
             if (tokens[*i].type != TOKEN_IDENTIFIER)
             {
@@ -157,19 +158,29 @@ static Expression *parse_primary(Token *tokens, int *i)
                 free(expr);
                 return NULL;
             }
-            expr->alias_column.column_name = strdup(tokens[*i].token);
+            expr->alias_column.column_name = token_strdup(&tokens[*i]);
         }
         else
         {
             expr->type = EXPR_COLUMN;
-            expr->column_name = strdup(tokens[*i].token);
+            expr->column_name = token_strdup(&tokens[*i]);
         }
     }
     else if (tokens[*i].type == TOKEN_STRING || tokens[*i].type == TOKEN_NUMBER)
     {
         expr->type = EXPR_LITERAL;
-        expr->literal.value = strdup(tokens[*i].token);
+        expr->literal.value = token_strdup(&tokens[*i]);
         expr->literal.is_string = (tokens[*i].type == TOKEN_STRING);
+        expr->literal.parameter = -1;
+    }
+    else if (tokens[*i].type == TOKEN_PARAMETER)
+    {
+        // Bound before every execution, the buffer holds the longest token
+        expr->type = EXPR_LITERAL;
+        expr->literal.value = calloc(MAX_TOKEN_LENGTH, sizeof(char));
+        strcpy(expr->literal.value, "0");
+        expr->literal.is_string = 0;
+        expr->literal.parameter = tokens[*i].parameter;
     }
     else
     {
@@ -189,7 +200,8 @@ Expression *parse_expression(Token *tokens, int *i, int count)
     return parse_binary_op_rhs(tokens, i, 1, lhs);
 }
 
-static void *evaluate_column(Expression *expr, Table *tables[], char *row_datas[], int table_count, DataType *type) // caller is responsible for freeing the return value
+// The value is allocated from the query arena, evaluate_expression releases it once the expression is evaluated
+static void *evaluate_column(Expression *expr, Table *tables[], char *row_datas[], int table_count, DataType *type)
 {
     int check = 0;
     int table_index;
@@ -206,18 +218,23 @@ static void *evaluate_column(Expression *expr, Table *tables[], char *row_datas[
             return NULL;
         }
     }
-    Column *col = get_column(tables[table_index], expr->column_name);
+    if (check == 0)
+    {
+        printf("Error: Column %s does not exist in given tables\n", expr->column_name);
+        return NULL;
+    }
+    const Column *col = &tables[table_index]->columns[get_column_index(tables[table_index], expr->column_name)];
     if (col->type == INT)
     {
         *type = INT;
-        int *val = malloc(sizeof(int));
+        int *val = arena_alloc(get_query_arena(), sizeof(int));
         *val = *(int *)(row_datas[table_index] + calculate_offset(tables[table_index], *col));
         return val;
     }
     else
     {
         *type = STRING;
-        char *val = malloc(col->lenght + 1);
+        char *val = arena_alloc(get_query_arena(), col->lenght + 1);
         strncpy(val, row_datas[table_index] + calculate_offset(tables[table_index], *col), col->lenght);
         val[col->lenght] = '\0';
         return val;
@@ -243,25 +260,31 @@ void *evaluate_alias_column(Expression *expr, Table *tables[], char *alias[], ch
         return NULL;
     }
 
-    Column *col = get_column(tables[table_index], expr->alias_column.column_name);
+    int column_index = get_column_index(tables[table_index], expr->alias_column.column_name);
+    if (column_index < 0)
+    {
+        printf("Error: Column %s does not exist in %s\n", expr->alias_column.column_name, expr->alias_column.alias);
+        return NULL;
+    }
+    const Column *col = &tables[table_index]->columns[column_index];
     if (col->type == INT)
     {
         *type = INT;
-        int *val = malloc(sizeof(int));
+        int *val = arena_alloc(get_query_arena(), sizeof(int));
         *val = *(int *)(row_datas[table_index] + calculate_offset(tables[table_index], *col));
         return val;
     }
     else
     {
         *type = STRING;
-        char *val = malloc(col->lenght + 1);
+        char *val = arena_alloc(get_query_arena(), col->lenght + 1);
         strncpy(val, row_datas[table_index] + calculate_offset(tables[table_index], *col), col->lenght);
         val[col->lenght] = '\0';
         return val;
     }
 }
 
-int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *row_datas[], int table_count)
+static int evaluate_node(Expression *expr, Table *tables[], char *alias[], char *row_datas[], int table_count)
 {
     switch (expr->type)
     {
@@ -281,13 +304,11 @@ int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *
         switch (type)
         {
         case INT:
-            int r = *(int *)val;
-            free(val);
-            return r;
-            break;
+            return *(int *)val;
 
         case STRING:
-            free(val);
+
+        case VARCHAR:
             return -1;
             break;
         }
@@ -303,13 +324,11 @@ int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *
         switch (type)
         {
         case INT:
-            int r = *(int *)val;
-            free(val);
-            return r;
-            break;
+            return *(int *)val;
 
         case STRING:
-            free(val);
+
+        case VARCHAR:
             return -1;
             break;
         }
@@ -318,37 +337,41 @@ int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *
 
     case EXPR_UNARY:
         if (expr->unary.op == OP_NOT)
-            return !evaluate_expression(expr->unary.child, tables, alias, row_datas, table_count);
+            return !evaluate_node(expr->unary.child, tables, alias, row_datas, table_count);
         break;
 
     case EXPR_BINARY:
     {
         // These hold flags and data for string vs int mode
+        // Strings are compared through pointers to the literal or to the column value in the query arena, so
+        // values of any length work
         int is_left_str = 0, is_right_str = 0;
-        char left_str[256] = {0}, right_str[256] = {0};
+        const char *left_str = NULL, *right_str = NULL;
         int left = 0, right = 0;
 
         // LEFT SIDE
         if (expr->binary.left->type == EXPR_LITERAL && expr->binary.left->literal.is_string)
         {
             is_left_str = 1;
-            strncpy(left_str, expr->binary.left->literal.value, 255);
+            left_str = expr->binary.left->literal.value;
         }
         else if (expr->binary.left->type == EXPR_COLUMN)
         {
             DataType type;
             void *val = evaluate_column(expr->binary.left, tables, row_datas, table_count, &type);
+            if (val == NULL)
+                return 0;
             switch (type)
             {
             case INT:
                 left = *(int *)val;
-                free(val);
                 break;
 
             case STRING:
+
+            case VARCHAR:
                 is_left_str = 1;
-                strcpy(left_str, val);
-                free(val);
+                left_str = val;
                 break;
             }
         }
@@ -356,23 +379,25 @@ int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *
         {
             DataType type;
             void *val = evaluate_alias_column(expr->binary.left, tables, alias, row_datas, table_count, &type);
+            if (val == NULL)
+                return 0;
             switch (type)
             {
             case INT:
                 left = *(int *)val;
-                free(val);
                 break;
 
             case STRING:
+
+            case VARCHAR:
                 is_left_str = 1;
-                strcpy(left_str, val);
-                free(val);
+                left_str = val;
                 break;
             }
         }
         else
         {
-            left = evaluate_expression(expr->binary.left, tables, alias, row_datas, table_count);
+            left = evaluate_node(expr->binary.left, tables, alias, row_datas, table_count);
         }
 
         // RIGHT SIDE
@@ -381,7 +406,7 @@ int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *
             if (expr->binary.right->literal.is_string)
             {
                 is_right_str = 1;
-                strncpy(right_str, expr->binary.right->literal.value, 255);
+                right_str = expr->binary.right->literal.value;
             }
             else
             {
@@ -392,41 +417,45 @@ int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *
         {
             DataType type;
             void *val = evaluate_column(expr->binary.right, tables, row_datas, table_count, &type);
+            if (val == NULL)
+                return 0;
             switch (type)
             {
             case INT:
                 right = *(int *)val;
-                free(val);
                 break;
 
             case STRING:
+
+            case VARCHAR:
                 is_right_str = 1;
-                strcpy(right_str, val);
-                free(val);
+                right_str = val;
                 break;
             }
         }
         else if (expr->binary.right->type == EXPR_ALIAS_COLUMN)
         {
             DataType type;
-            void *val = evaluate_column(expr->binary.right, tables, row_datas, table_count, &type);
+            void *val = evaluate_alias_column(expr->binary.right, tables, alias, row_datas, table_count, &type);
+            if (val == NULL)
+                return 0;
             switch (type)
             {
             case INT:
                 right = *(int *)val;
-                free(val);
                 break;
 
             case STRING:
+
+            case VARCHAR:
                 is_right_str = 1;
-                strcpy(right_str, val);
-                free(val);
+                right_str = val;
                 break;
             }
         }
         else
         {
-            right = evaluate_expression(expr->binary.right, tables, alias, row_datas, table_count);
+            right = evaluate_node(expr->binary.right, tables, alias, row_datas, table_count);
         }
 
         // Handle string comparisons
@@ -483,6 +512,97 @@ int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *
     return 0;
 }
 
+int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *row_datas[], int table_count)
+{
+    // Column values are copied into the query arena, give them back after every row
+    Arena *arena = get_query_arena();
+    ArenaMark mark = arena_mark(arena);
+    int result = evaluate_node(expr, tables, alias, row_datas, table_count);
+    arena_release(arena, mark);
+    return result;
+}
+
+static const char *operator_symbol(Operator op)
+{
+    switch (op)
+    {
+    case OP_EQ:
+        return "=";
+    case OP_NE:
+        return "<>";
+    case OP_LT:
+        return "<";
+    case OP_LE:
+        return "<=";
+    case OP_GT:
+        return ">";
+    case OP_GE:
+        return ">=";
+    case OP_ADD:
+        return "+";
+    case OP_SUB:
+        return "-";
+    case OP_MUL:
+        return "*";
+    case OP_DIV:
+        return "/";
+    case OP_AND:
+        return "AND";
+    case OP_OR:
+        return "OR";
+    case OP_NOT:
+        return "NOT";
+    }
+    return "?";
+}
+
+static void print_operand(const Expression *expr, int parent_prec)
+{
+    if (expr && expr->type == EXPR_BINARY && get_precedence(expr->binary.op) < parent_prec)
+    {
+        printf("(");
+        print_expression(expr);
+        printf(")");
+        return;
+    }
+    print_expression(expr);
+}
+
+void print_expression(const Expression *expr)
+{
+    if (!expr)
+    {
+        printf("true");
+        return;
+    }
+    switch (expr->type)
+    {
+    case EXPR_LITERAL:
+        if (expr->literal.parameter >= 0)
+            printf("?");
+        else if (expr->literal.is_string)
+            printf("'%s'", expr->literal.value);
+        else
+            printf("%s", expr->literal.value);
+        break;
+    case EXPR_COLUMN:
+        printf("%s", expr->column_name);
+        break;
+    case EXPR_ALIAS_COLUMN:
+        printf("%s.%s", expr->alias_column.alias, expr->alias_column.column_name);
+        break;
+    case EXPR_BINARY:
+        print_operand(expr->binary.left, get_precedence(expr->binary.op));
+        printf(" %s ", operator_symbol(expr->binary.op));
+        print_operand(expr->binary.right, get_precedence(expr->binary.op) + 1);
+        break;
+    case EXPR_UNARY:
+        printf("NOT ");
+        print_operand(expr->unary.child, get_precedence(OP_NOT) + 1);
+        break;
+    }
+}
+
 void free_expression(Expression *expr)
 {
     if (!expr)
@@ -1,4 +1,5 @@
 #include "file_io.h"
+#include "storage.h"
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -55,6 +56,33 @@ int list_tables()
     return 0;
 }
 
+int list_table_status()
+{
+    Table **tables = get_global_tables();
+    int table_count = get_table_count();
+    if (table_count <= 0)
+    {
+        printf("No tables found\n");
+        return 0;
+    }
+    for (int i = 0; i < table_count; i++)
+    {
+        const Table *table = tables[i];
+        long bytes = table_storage_bytes(table);
+        if (bytes < 0)
+        {
+            return -1;
+        }
+        // Chains are only counted over the buckets that have one
+        int used_buckets = count_used_buckets(table->hash);
+        printf("%s: rows=%d bytes=%ld free slots=%d index load factor=%.3f average chain length=%.2f\n",
+               table->table_name, table->record_size, bytes, table->free_spaces_count,
+               (double)table->hash->entries / table->hash->size,
+               used_buckets > 0 ? (double)table->hash->entries / used_buckets : 0.0);
+    }
+    return 0;
+}
+
 int create_directory(const char *dir)
 {
     struct stat st = {0};
@@ -413,93 +441,19 @@ int does_table_exists(const char *table_name)
 
 void print_all_columns(const Table *table)
 {
-    FILE *file = open_file(table->table_name, "bin", "rb");
-    if (!file)
-    {
-        printf("Could not open file for table %s\n", table->table_name);
-        return;
-    }
-
-    int columns_count = table->columns_count;
-    int col_widths[columns_count];
-
-    // Set fixed widths: 12 for INT, 20 for STRING (or column length if longer)
-    for (int i = 0; i < columns_count; i++)
-    {
-        if (table->columns[i].type == INT)
-            col_widths[i] = 12;
-        else if (table->columns[i].type == STRING)
-            col_widths[i] = table->columns[i].lenght > 20 ? table->columns[i].lenght : 20;
-        int name_len = strlen(table->columns[i].name);
-        if (name_len > col_widths[i])
-            col_widths[i] = name_len;
-    }
-
-    // Print header
-    for (int i = 0; i < columns_count; i++)
-        printf("%-*s ", col_widths[i], table->columns[i].name);
-    printf("\n");
-
-    // Print separator
-    for (int i = 0; i < columns_count; i++)
+    Column *columns[MAX_COLUMN_COUNT];
+    for (int i = 0; i < table->columns_count; i++)
     {
-        for (int j = 0; j < col_widths[i]; j++)
-            printf("-");
-        printf(" ");
+        columns[i] = (Column *)&table->columns[i];
     }
-    printf("\n");
-
-    // Print rows
-    for (int rec = 0; rec < table->record_size; rec++)
-    {
-        long row_start = rec * table->row_size_in_bytes;
-        long offset = 0;
-        for (int col = 0; col < columns_count; col++)
-        {
-            fseek(file, row_start + offset, SEEK_SET);
-            switch (table->columns[col].type)
-            {
-            case INT:
-            {
-                int val;
-                fread(&val, sizeof(int), 1, file);
-                printf("%-*d ", col_widths[col], val);
-                offset += sizeof(int);
-                break;
-            }
-            case STRING:
-            {
-                char *str = (char *)malloc(table->columns[col].lenght + 1);
-                if (!str)
-                {
-                    fclose(file);
-                    printf("Memory allocation failed\n");
-                    return;
-                }
-                fread(str, sizeof(char), table->columns[col].lenght, file);
-                str[table->columns[col].lenght] = '\0';
-                printf("%-*s ", col_widths[col], str);
-                free(str);
-                offset += table->columns[col].lenght + 1;
-                break;
-            }
-            }
-        }
-        printf("\n");
-    }
-    printf("\n");
-    fclose(file);
+    print_values_of(table, columns, table->columns_count);
 }
 
 void print_values_of(const Table *table, Column **columns, int columns_count)
 {
-    FILE *file = open_file(table->table_name, "bin", "rb");
-    if (!file)
-    {
-        return;
-    }
     int columns_offset[columns_count];
     int col_widths[columns_count];
+    int used_columns[MAX_COLUMN_COUNT] = {0};
     for (int i = 0; i < columns_count; i++)
     {
         columns_offset[i] = calculate_offset(table, *columns[i]);
@@ -507,12 +461,12 @@ void print_values_of(const Table *table, Column **columns, int columns_count)
         if (columns_offset[i] == -1)
         {
             printf("Column %s not found\n", columns[i]->name);
-            fclose(file);
             return;
         }
+        used_columns[get_column_index(table, columns[i]->name)] = COLUMN_VALUES;
         if (columns[i]->type == INT)
             col_widths[i] = 12;
-        else if (columns[i]->type == STRING)
+        else
             col_widths[i] = columns[i]->lenght > 20 ? columns[i]->lenght : 20;
         // Ensure column name fits
         int name_len = strlen(columns[i]->name);
@@ -520,6 +474,21 @@ void print_values_of(const Table *table, Column **columns, int columns_count)
             col_widths[i] = name_len;
     }
 
+    // Columnar tables only read the printed columns
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb", used_columns) != 0)
+    {
+        printf("Could not open file for table %s\n", table->table_name);
+        return;
+    }
+    char *row = (char *)calloc(1, table->row_size_in_bytes);
+    if (!row)
+    {
+        printf("Memory allocation failed\n");
+        close_table_storage(&storage);
+        return;
+    }
+
     // Print header
     for (int i = 0; i < columns_count; i++)
         printf("%-*s ", col_widths[i], columns[i]->name);
@@ -535,40 +504,34 @@ void print_values_of(const Table *table, Column **columns, int columns_count)
     printf("\n");
 
     // Print rows
-    for (int i = 0; i < table->record_size; i++)
+    while (read_next_row(&storage, row))
     {
+        if (isfree(table, storage.current_pos))
+        {
+            continue;
+        }
         for (int j = 0; j < columns_count; j++)
         {
-            fseek(file, i * table->row_size_in_bytes + columns_offset[j], SEEK_SET);
             switch (columns[j]->type)
             {
             case INT:
             {
                 int val;
-                fread(&val, sizeof(int), 1, file);
+                memcpy(&val, row + columns_offset[j], sizeof(int));
                 printf("%-*d ", col_widths[j], val);
                 break;
             }
             case STRING:
-            {
-                char *str = (char *)malloc(columns[j]->lenght + 1);
-                if (!str)
-                {
-                    fclose(file);
-                    return;
-                }
-                fread(str, sizeof(char), columns[j]->lenght, file);
-                str[columns[j]->lenght] = '\0';
-                printf("%-*s ", col_widths[j], str);
-                free(str);
+            case VARCHAR:
+                printf("%-*.*s ", col_widths[j], columns[j]->lenght, row + columns_offset[j]);
                 break;
             }
-            }
         }
         printf("\n");
     }
     printf("\n");
-    fclose(file);
+    free(row);
+    close_table_storage(&storage);
 }
 
 int create_hashmap_file(const Table *table)
@@ -651,6 +614,15 @@ int store_table_metadata(const Table *table)
     {
         fwrite(&table->free_spaces[i], sizeof(long), 1, file);
     }
+    fwrite(&table->engine, sizeof(StorageEngine), 1, file);
+    // Dictionaries live in their own .dict files, only the shape of every encoding is kept here
+    for (int i = 0; table->encodings && i < table->columns_count; i++)
+    {
+        fwrite(&table->encodings[i].type, sizeof(EncodingType), 1, file);
+        fwrite(&table->encodings[i].width, sizeof(int), 1, file);
+        fwrite(&table->encodings[i].base, sizeof(int), 1, file);
+    }
+    fwrite(&table->key_hash, sizeof(HashKind), 1, file);
 
     fflush(file);
     fclose(file);
@@ -714,7 +686,7 @@ int update_table_metadata_free_spaces(const Table *table)
     }
 
     fseek(file, sizeof(char) * MAX_NAME_LEN + sizeof(int) * 4 + sizeof(Column) * (table->columns_count + 1) + sizeof(long) * (table->free_spaces_count - 1), SEEK_SET);
-    fwrite(table->free_spaces, sizeof(long), 1, file);
+    fwrite(&table->free_spaces[table->free_spaces_count - 1], sizeof(long), 1, file);
 
     fflush(file);
     fclose(file);
@@ -749,7 +721,25 @@ int update_hashmap_file_free_spaces(const Table *table)
     }
 
     fseek(file, sizeof(int) * 3 + sizeof(long) * (table->hash->free_hash_spaces_count - 1), SEEK_SET);
-    fwrite(table->hash->free_hash_spaces, sizeof(long), 1, file);
+    fwrite(&table->hash->free_hash_spaces[table->hash->free_hash_spaces_count - 1], sizeof(long), 1, file);
+
+    fflush(file);
+    fclose(file);
+    return 0;
+}
+
+int store_hashmap_header(const Table *table)
+{
+    FILE *file = open_file(table->table_name, "hashmap", "rb+");
+    if (!file)
+    {
+        return -1;
+    }
+
+    fwrite(&(table->hash->size), sizeof(int), 1, file);
+    fwrite(&(table->hash->entries), sizeof(int), 1, file);
+    fwrite(&(table->hash->free_hash_spaces_count), sizeof(int), 1, file);
+    fwrite(table->hash->free_hash_spaces, sizeof(long), DEFAULT_FREE_HASH_SPACES, file);
 
     fflush(file);
     fclose(file);
@@ -758,7 +748,8 @@ int update_hashmap_file_free_spaces(const Table *table)
 
 int insert_to_hashmap_file(const Table *table, HashEntry *he)
 {
-    FILE *file = open_file(table->table_name, "hashmap", "ab");
+    // Append mode would ignore the seek to a free slot, open for update instead
+    FILE *file = open_file(table->table_name, "hashmap", "rb+");
     if (!file)
     {
         return -1;
@@ -768,10 +759,10 @@ int insert_to_hashmap_file(const Table *table, HashEntry *he)
     {
         he->hash_entry_pos = table->hash->free_hash_spaces[--table->hash->free_hash_spaces_count];
         table->hash->free_hash_spaces[table->hash->free_hash_spaces_count] = -1; // Mark as used
-        table->hash->free_hash_spaces_count--;
     }
     else
     {
+        fseek(file, 0, SEEK_END);
         he->hash_entry_pos = ftell(file);
     }
     fseek(file, he->hash_entry_pos, SEEK_SET);
@@ -805,17 +796,29 @@ HashTable *read_hashmap_file(const Table *table)
         fread(&(hash->free_hash_spaces[i]), sizeof(long), 1, file);
     }
 
-    for (int i = 0; i < hash->entries; i++)
+    // Deleted entries leave zeroed slots behind, read every slot and skip those
+    int expected_entries = hash->entries;
+    hash->entries = 0;
+    while (1)
     {
-        HashEntry *he = (HashEntry *)malloc(sizeof(HashEntry));
+        HashEntry *he = alloc_hash_entry(hash);
         if (!he)
         {
-            perror("Failed to allocate memory for hash entry");
             fclose(file);
             return NULL;
         }
-        fread(he, sizeof(HashEntry) - sizeof(struct HashEntry *), 1, file);
+        if (fread(he, sizeof(HashEntry) - sizeof(struct HashEntry *), 1, file) != 1)
+        {
+            release_hash_entry(hash, he);
+            break;
+        }
+        if (he->hash_entry_pos == 0)
+        {
+            release_hash_entry(hash, he);
+            continue;
+        }
         he->next = NULL;
+        hash->entries++;
 
         // Insert the hash entry into the hash table
         if (hash->buckets[he->hash % hash->size] == NULL)
@@ -833,6 +836,11 @@ HashTable *read_hashmap_file(const Table *table)
         }
     }
 
+    if (hash->entries != expected_entries)
+    {
+        printf("Warning: hashmap of %s has %d entries, header says %d\n", table->table_name, hash->entries, expected_entries);
+    }
+
     fflush(file);
     fclose(file);
     return hash;
@@ -868,14 +876,73 @@ Table *read_table_metadata(const char *tablename)
     {
         fread(&table->free_spaces[i], sizeof(long), 1, file);
     }
+    // Tables written before the engine was stored are row tables
+    if (fread(&table->engine, sizeof(StorageEngine), 1, file) != 1)
+    {
+        table->engine = ENGINE_ROW;
+    }
+    table->encodings = NULL;
+    table->version = 0;
+    if (table->engine == ENGINE_COMPRESSED)
+    {
+        table->encodings = calloc(table->columns_count, sizeof(ColumnEncoding));
+        for (int i = 0; table->encodings && i < table->columns_count; i++)
+        {
+            fread(&table->encodings[i].type, sizeof(EncodingType), 1, file);
+            fread(&table->encodings[i].width, sizeof(int), 1, file);
+            fread(&table->encodings[i].base, sizeof(int), 1, file);
+        }
+    }
+    // Tables written before the key hash was stored hash their keys with FNV-1a
+    if (fread(&table->key_hash, sizeof(HashKind), 1, file) != 1)
+    {
+        table->key_hash = HASH_FNV1A;
+    }
 
     fflush(file);
     fclose(file);
 
+    if (table->engine == ENGINE_COMPRESSED && (!table->encodings || load_dictionaries(table) != 0))
+    {
+        printf("Failed to load the encodings of table %s\n", table->table_name);
+        free_column_encodings(table->encodings, table->columns_count);
+        free(table);
+        return NULL;
+    }
+
     // Initialize the hash table
     table->hash = read_hashmap_file(table);
     if (!table->hash)
     {
+        free_column_encodings(table->encodings, table->columns_count);
+        free(table);
+        return NULL;
+    }
+    if (load_bloom_filter(table) != 0)
+    {
+        free_hashtable(table->hash);
+        free_column_encodings(table->encodings, table->columns_count);
+        free(table);
+        return NULL;
+    }
+
+    // Statistics are not persisted, rebuild them from the stored rows
+    if (rebuild_table_stats(table) != 0)
+    {
+        printf("Failed to rebuild statistics for table %s\n", table->table_name);
+        free_hashtable(table->hash);
+        free_column_encodings(table->encodings, table->columns_count);
+        free(table);
+        return NULL;
+    }
+
+    init_zone_map(&table->zones);
+    if (load_zone_map(table) != 0)
+    {
+        printf("Failed to load zone map for table %s\n", table->table_name);
+        free_zone_map(&table->zones);
+        free_hashtable(table->hash);
+        free_column_encodings(table->encodings, table->columns_count);
         free(table);
         return NULL;
     }
@@ -889,7 +956,7 @@ int write_string_to_file(FILE *file, const char *val, int length)
     {
         return -1;
     }
-    strncpy(str_copy, val, strlen(val));
+    strncpy(str_copy, val, length);
     str_copy[length] = '\0'; // Null-terminate the string
 
     fwrite(str_copy, length + 1, 1, file);
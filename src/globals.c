@@ -12,6 +12,7 @@ struct Globals
     int table_count; // Size of the array
     char *db_name;   // Name of the current
     int db_loaded;   // Flag to indicate if the database is loaded
+    unsigned long schema_version; // Bumped whenever the set of loaded tables changes
 };
 
 Globals globalvars;
@@ -42,6 +43,7 @@ int initialize_globals(const char *db_name)
         return -1;
     }
     globalvars.db_loaded = 1; // Set the database loaded flag
+    globalvars.schema_version++;
     return 0;
 }
 
@@ -87,7 +89,7 @@ void free_globals()
             if (globalvars.tables[i] != NULL)
             {
                 free_hashtable(globalvars.tables[i]->hash);
-                free(globalvars.tables[i]);
+                free_table(globalvars.tables[i]);
             }
         }
     }
@@ -95,6 +97,7 @@ void free_globals()
     globalvars.tables = NULL;
     globalvars.table_count = 0;
     globalvars.db_loaded = 0; // Reset the database loaded flag
+    globalvars.schema_version++;
 }
 
 char *get_root()
@@ -117,6 +120,11 @@ int is_db_loaded()
     return globalvars.db_loaded;
 }
 
+unsigned long get_schema_version()
+{
+    return globalvars.schema_version;
+}
+
 int add_table(const char *table_name)
 {
     globalvars.tables[globalvars.table_count++] = read_table_metadata(table_name);
@@ -190,6 +198,7 @@ int add_table_to_globals(Table *table)
         return -1;
     }
     globalvars.tables[globalvars.table_count++] = table;
+    globalvars.schema_version++;
     return 0;
 }
 
@@ -199,7 +208,7 @@ int remove_table_from_globals(const char *table_name)
     {
         if (globalvars.tables[i] != NULL && strcmp(globalvars.tables[i]->table_name, table_name) == 0)
         {
-            free(globalvars.tables[i]);
+            free_table(globalvars.tables[i]);
             globalvars.tables[i] = NULL; // Set the pointer to NULL
             // Shift remaining tables
             for (int j = i; j < globalvars.table_count - 1; j++)
@@ -207,6 +216,7 @@ int remove_table_from_globals(const char *table_name)
                 globalvars.tables[j] = globalvars.tables[j + 1];
             }
             globalvars.table_count--;
+            globalvars.schema_version++;
             return 0; // Table removed successfully
         }
     }
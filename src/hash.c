@@ -0,0 +1,150 @@
+#include "hash.h"
+#include "fnv_hash.h"
+#include <string.h>
+#ifdef __x86_64__
+#include <nmmintrin.h>
+#endif
+
+#define WORD_HASH_SEED 0xa0761d6478bd642fULL
+#define WORD_HASH_PRIME 0xe7037ed1a0b428dbULL
+#define CRC32C_POLYNOMIAL 0x82f63b78U // reflected Castagnoli polynomial
+
+static const HashFunctions hash_kinds[] = {
+    {"fnv1a", fnv1a_hash_int, fnv1a_hash_str, fnv1a_hash_bytes},
+    {"word", word_hash_int, word_hash_str, word_hash_bytes}};
+
+const HashFunctions *get_hash_functions(HashKind kind)
+{
+    return &hash_kinds[kind == HASH_WORD ? HASH_WORD : HASH_FNV1A];
+}
+
+static inline uint32_t fmix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+// Multiply to 128 bits and fold the halves, the mixing step of wyhash
+static inline uint64_t fold_multiply(uint64_t a, uint64_t b)
+{
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+uint32_t word_hash_int(int key)
+{
+    return fmix32((uint32_t)key);
+}
+
+uint32_t word_hash_bytes(const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = WORD_HASH_SEED ^ length;
+    uint64_t word;
+    for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+    {
+        memcpy(&word, bytes, sizeof(uint64_t));
+        hash = fold_multiply(hash ^ word, WORD_HASH_PRIME);
+    }
+    if (length > 0)
+    {
+        word = 0;
+        memcpy(&word, bytes, length);
+        hash = fold_multiply(hash ^ word, WORD_HASH_PRIME);
+    }
+    return (uint32_t)fold_multiply(hash, WORD_HASH_SEED);
+}
+
+uint32_t word_hash_str(const char *key)
+{
+    return word_hash_bytes(key, strlen(key));
+}
+
+static uint32_t crc32c_table[256];
+
+static void init_crc32c_table(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+        }
+        crc32c_table[i] = crc;
+    }
+}
+
+#ifdef __x86_64__
+// Built for SSE4.2 on its own so the rest of the binary runs on any x86-64, only called when the CPU has it
+__attribute__((target("sse4.2"))) static uint32_t crc32c_instruction(uint32_t crc, const unsigned char *bytes, size_t length)
+{
+    uint64_t word;
+    for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+    {
+        memcpy(&word, bytes, sizeof(uint64_t));
+        crc = (uint32_t)_mm_crc32_u64(crc, word);
+    }
+    for (; length > 0; length--)
+    {
+        crc = _mm_crc32_u8(crc, *bytes++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c_hash_bytes(const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint32_t crc = 0xffffffffU;
+#ifdef __x86_64__
+    static int has_instruction = -1;
+    if (has_instruction < 0)
+    {
+        has_instruction = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+    if (has_instruction)
+    {
+        return fmix32(~crc32c_instruction(crc, bytes, length));
+    }
+#endif
+    if (crc32c_table[1] == 0)
+    {
+        init_crc32c_table();
+    }
+    for (; length > 0; length--)
+    {
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ *bytes++) & 0xff];
+    }
+    return fmix32(~crc);
+}
+
+void hash_int_batch(HashKind kind, const int keys[], uint32_t hashes[], int count)
+{
+    if (kind == HASH_WORD)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            hashes[i] = fmix32((uint32_t)keys[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        hashes[i] = fnv1a_hash_int(keys[i]);
+    }
+}
+
+void hash_str_batch(HashKind kind, const char *values, size_t stride, uint32_t hashes[], int count)
+{
+    const HashFunctions *functions = get_hash_functions(kind);
+    for (int i = 0; i < count; i++)
+    {
+        const char *value = values + (size_t)i * stride;
+        hashes[i] = functions->hash_bytes(value, strnlen(value, stride));
+    }
+}
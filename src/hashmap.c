@@ -21,25 +21,91 @@ HashTable *create_hashtable(const int size)
         free(ht);
         return NULL;
     }
+    ht->slabs = NULL;
+    ht->slab_used = HASH_SLAB_ENTRIES;
+    ht->free_entries = NULL;
     ht->free_hash_spaces_count = 0;
     for (int i = 0; i < DEFAULT_FREE_HASH_SPACES; i++)
     {
         ht->free_hash_spaces[i] = -1;
     }
+    if (init_bloom_filter(&ht->bloom, 0) != 0)
+    {
+        free(ht->buckets);
+        free(ht);
+        return NULL;
+    }
     return ht;
 }
 
+// A filter full of keys is rebuilt from the entries, which already include the new one
+static void add_to_bloom_filter(HashTable *hash, const uint32_t hash_value)
+{
+    if (hash->bloom.keys < hash->bloom.capacity || rebuild_bloom_filter(hash) != 0)
+    {
+        bloom_add(&hash->bloom, hash_value);
+    }
+}
+
+int rebuild_bloom_filter(HashTable *hash)
+{
+    BloomFilter bloom;
+    if (init_bloom_filter(&bloom, hash->entries * 2) != 0)
+    {
+        return -1;
+    }
+    for (int i = 0; i < hash->size; i++)
+    {
+        for (HashEntry *he = hash->buckets[i]; he; he = he->next)
+        {
+            bloom_add(&bloom, he->hash);
+        }
+    }
+    free_bloom_filter(&hash->bloom);
+    hash->bloom = bloom;
+    return 0;
+}
+
+HashEntry *alloc_hash_entry(HashTable *hash)
+{
+    if (hash->free_entries)
+    {
+        HashEntry *he = hash->free_entries;
+        hash->free_entries = he->next;
+        return he;
+    }
+    if (hash->slab_used == HASH_SLAB_ENTRIES)
+    {
+        HashEntrySlab *slab = (HashEntrySlab *)malloc(sizeof(HashEntrySlab));
+        if (!slab)
+        {
+            perror("Failed to allocate memory for hash entries");
+            return NULL;
+        }
+        slab->next = hash->slabs;
+        hash->slabs = slab;
+        hash->slab_used = 0;
+    }
+    return &hash->slabs->entries[hash->slab_used++];
+}
+
+void release_hash_entry(HashTable *hash, HashEntry *entry)
+{
+    entry->next = hash->free_entries;
+    hash->free_entries = entry;
+}
+
 HashEntry *create_hash_entry(HashTable *hashmap, const Key key, const uint32_t hash, const long file_pos)
 {
-    HashEntry *he = (HashEntry *)malloc(sizeof(HashEntry));
+    HashEntry *he = alloc_hash_entry(hashmap);
     if (!he)
     {
-        perror("Failed to allocate memory for hash entry");
         return NULL;
     }
     he->key = key;
     he->hash = hash;
     he->file_pos = file_pos;
+    he->hash_entry_pos = 0; // set once the entry is written to the hashmap file
     he->next = NULL;
 
     int index = hash % hashmap->size;
@@ -50,19 +116,24 @@ HashEntry *create_hash_entry(HashTable *hashmap, const Key key, const uint32_t h
         {
             current = current->next;
         }
-        current = he;
+        current->next = he;
     }
     else
     {
         hashmap->buckets[index] = he;
     }
     hashmap->entries++;
+    add_to_bloom_filter(hashmap, hash);
 
     return he;
 }
 
 HashEntry *find_right_entry_in_bucket(HashTable *hash, const Key key, const uint32_t hash_value)
 {
+    if (!bloom_may_contain(&hash->bloom, hash_value))
+    {
+        return NULL; // Not found
+    }
     int index = hash_value % hash->size;
     HashEntry *he = hash->buckets[index];
 
@@ -77,6 +148,47 @@ HashEntry *find_right_entry_in_bucket(HashTable *hash, const Key key, const uint
     return NULL; // Not found
 }
 
+HashEntry *find_entry_by_position(HashTable *hash, const uint32_t hash_value, const long file_pos)
+{
+    HashEntry *he = hash->buckets[hash_value % hash->size];
+    while (he)
+    {
+        if (he->hash == hash_value && he->file_pos == file_pos)
+        {
+            return he;
+        }
+        he = he->next;
+    }
+    return NULL; // Not found
+}
+
+int move_hash_entry(HashTable *hash, HashEntry *entry, const Key key, const uint32_t hash_value)
+{
+    int index = entry->hash % hash->size;
+    HashEntry **link = &hash->buckets[index];
+    while (*link && *link != entry)
+    {
+        link = &(*link)->next;
+    }
+    if (!*link)
+    {
+        return -1; // Entry not found
+    }
+    *link = entry->next;
+
+    entry->key = key;
+    entry->hash = hash_value;
+    entry->next = NULL;
+    link = &hash->buckets[hash_value % hash->size];
+    while (*link)
+    {
+        link = &(*link)->next;
+    }
+    *link = entry;
+    add_to_bloom_filter(hash, hash_value);
+    return 0;
+}
+
 int delete_hash_entry(HashTable *hash, HashEntry *entry)
 {
     if (!hash || !entry)
@@ -101,9 +213,13 @@ int delete_hash_entry(HashTable *hash, HashEntry *entry)
                 hash->buckets[index] = current->next;
             }
             hash->entries--;
-            hash->free_hash_spaces[hash->free_hash_spaces_count] = entry->hash_entry_pos;
-            hash->free_hash_spaces_count++;
-            free(current);
+            // A slot that does not fit in the free list stays zeroed on disk and is skipped on load
+            if (entry->hash_entry_pos > 0 && hash->free_hash_spaces_count < DEFAULT_FREE_HASH_SPACES)
+            {
+                hash->free_hash_spaces[hash->free_hash_spaces_count] = entry->hash_entry_pos;
+                hash->free_hash_spaces_count++;
+            }
+            release_hash_entry(hash, current);
             return 0; // Successfully deleted
         }
         prev = current;
@@ -112,23 +228,30 @@ int delete_hash_entry(HashTable *hash, HashEntry *entry)
     return -1; // Entry not found
 }
 
+int count_used_buckets(const HashTable *hash)
+{
+    int used = 0;
+    for (int i = 0; i < hash->size; i++)
+    {
+        used += hash->buckets[i] != NULL;
+    }
+    return used;
+}
+
 int free_hashtable(HashTable *hash)
 {
     if (!hash)
     {
         return -1; // Invalid parameter
     }
-    for (int i = 0; i < hash->size; i++)
+    while (hash->slabs)
     {
-        HashEntry *current = hash->buckets[i];
-        while (current)
-        {
-            HashEntry *temp = current;
-            current = current->next;
-            free(temp);
-        }
+        HashEntrySlab *slab = hash->slabs;
+        hash->slabs = slab->next;
+        free(slab);
     }
     free(hash->buckets);
+    free_bloom_filter(&hash->bloom);
     free(hash);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "table.h"
+#include "globals.h"
+#include "wire.h"
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct Expression Expression;   // Forward declaration of Expression struct
+typedef struct SelectQuery SelectQuery; // Forward declaration of SelectQuery struct
+typedef struct QueryPlan QueryPlan;     // Forward declaration of QueryPlan struct
+
+typedef enum
+{
+    AGGREGATE_COUNT,
+    AGGREGATE_SUM,
+    AGGREGATE_MIN,
+    AGGREGATE_MAX,
+    AGGREGATE_AVG
+} AggregateFunction;
+
+typedef struct
+{
+    AggregateFunction function;
+    Expression *argument; // an INT expression, NULL for COUNT(*)
+} Aggregate;
+
+typedef struct
+{
+    long count;
+    long long sum;
+    int min;
+    int max;
+} AggregateState;
+
+typedef struct
+{
+    uint32_t hash;
+    char *key;               // the values of the GROUP BY columns, GroupTable.key_size bytes
+    AggregateState states[]; // one per aggregate of the query
+} AggregateGroup;
+
+/*
+ * Hash aggregation: the rows coming out of the join are folded into one group per distinct value of the
+ * GROUP BY columns. Groups live in the query arena, the index over them is open addressing.
+ */
+typedef struct GroupTable
+{
+    const SelectQuery *query;
+    int column_tables[MAX_COLUMN_COUNT];  // per GROUP BY column, the index of its table
+    int column_indexes[MAX_COLUMN_COUNT]; // per GROUP BY column, its index in the table
+    int key_offsets[MAX_COLUMN_COUNT];    // per GROUP BY column, where its value starts in a group key
+    int key_size;
+    int item_columns[MAX_COLUMN_COUNT]; // per selected column, its GROUP BY column
+    AggregateGroup **slots;             // slot_count entries, a power of two, at most half used
+    int slot_count;
+    AggregateGroup **groups; // in the order they were first seen
+    int group_count;
+    int group_capacity;
+    int failed; // set when memory for a group could not be allocated
+} GroupTable;
+
+/**
+ * @brief Parse the name of an aggregate function.
+ *
+ * @param name The name, in upper case.
+ * @param length The length of the name.
+ * @return int The AggregateFunction, -1 if the name is not an aggregate function.
+ */
+int parse_aggregate_function(const char *name, int length);
+
+/**
+ * @brief Get the name of an aggregate function.
+ *
+ * @param function The function.
+ * @return const char* The name.
+ */
+const char *aggregate_function_name(AggregateFunction function);
+
+/**
+ * @brief Prepare the group table of a query with aggregates or GROUP BY. Checks that every selected column is
+ *        a GROUP BY column and that SUM, AVG, MIN and MAX are not given a string column.
+ *
+ * @param groups The group table to fill.
+ * @param query The parsed query, must outlive the group table.
+ * @return int 0 on success, -1 on failure.
+ */
+int init_group_table(GroupTable *groups, const SelectQuery *query);
+
+/**
+ * @brief Mark the columns the GROUP BY columns and the aggregate arguments read as used by a plan.
+ *
+ * @param groups The group table.
+ * @param plan The plan of the query.
+ */
+void mark_group_columns(const GroupTable *groups, QueryPlan *plan);
+
+/**
+ * @brief Add a joined row to its group.
+ *
+ * @param groups The group table.
+ * @param tables The tables in FROM-clause order.
+ * @param alias The aliases of the tables.
+ * @param rows The current row data of each table.
+ * @param table_count The number of tables.
+ */
+void aggregate_row(GroupTable *groups, Table *tables[], char *alias[], char *rows[], int table_count);
+
+/**
+ * @brief Check whether a query only counts its rows: no GROUP BY, no plain columns and nothing but COUNT.
+ *        Rows never hold NULLs, so COUNT of any argument is the row count.
+ *
+ * @param groups The group table.
+ * @return int 1 if the query only counts, 0 otherwise.
+ */
+int is_count_only(const GroupTable *groups);
+
+/**
+ * @brief Count rows that were never read into the single group of a count-only query.
+ *
+ * @param groups The group table, see is_count_only.
+ * @param count The number of rows.
+ * @return int 0 on success, -1 on failure.
+ */
+int add_counted_rows(GroupTable *groups, long count);
+
+/**
+ * @brief Describe the result set of a query with aggregates: one column per selected item.
+ *
+ * @param groups The group table.
+ * @param names Filled with the names of the columns.
+ * @param types Filled with the types of the columns.
+ */
+void describe_groups(const GroupTable *groups, const char *names[], WireType types[]);
+
+/**
+ * @brief Write one row per group with the selected columns and aggregates.
+ *
+ * @param groups The group table.
+ * @param out The result set to write to, begun as describe_groups describes it.
+ */
+void print_groups(const GroupTable *groups, ResultWriter *out);
+
+/**
+ * @brief Free the index of a group table. The groups go with the query arena.
+ *
+ * @param groups The group table.
+ */
+void free_group_table(GroupTable *groups);
+
+#endif // AGGREGATE_H
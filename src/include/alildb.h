@@ -0,0 +1,180 @@
+#ifndef ALILDB_H
+#define ALILDB_H
+
+#include "wire.h"
+
+#define DB_ROW 1  // db_step moved to a row
+#define DB_DONE 0 // db_step ran out of rows, or the statement returns none
+
+/*
+ * Embedding API of libalildb. Statements run in the calling process on the same tables the dbms binary
+ * uses, under ./databases. A statement is prepared once, its '?' parameters bound, and its result walked
+ * one row at a time with db_step:
+ *
+ *     AlilDB *db;
+ *     AlilStmt *stmt;
+ *     db_open("shop", &db);
+ *     db_prepare(db, "SELECT name, price FROM products WHERE price > ?;", &stmt);
+ *     db_bind_int(stmt, 0, 100);
+ *     while (db_step(stmt) == DB_ROW)
+ *         printf("%s %d\n", db_column_text(stmt, 0), db_column_int(stmt, 1));
+ *     db_finalize(stmt);
+ *     db_close(db);
+ *
+ * The rows of a plain SELECT are read from the table files when the cursor reaches them and their columns
+ * point straight into the row images, valid until the next db_step. Aggregate results are values. Error
+ * messages are printed to stdout like the dbms binary does. Only one database can be open at a time.
+ */
+typedef struct AlilDB AlilDB;
+typedef struct AlilStmt AlilStmt;
+
+/**
+ * @brief Open a database created with CREATE DATABASE.
+ *
+ * @param name The name of the database.
+ * @param db Set to the handle on success.
+ * @return int 0 on success, -1 on failure.
+ */
+int db_open(const char *name, AlilDB **db);
+
+/**
+ * @brief Close a database. Its statements must be finalized first.
+ *
+ * @param db The handle, can be NULL.
+ */
+void db_close(AlilDB *db);
+
+/**
+ * @brief Run SQL statements without a result cursor, e.g. INSERT, UPDATE or CREATE TABLE. Whatever they
+ *        print goes to stdout.
+ *
+ * @param db The handle, NULL for statements that need no open database such as CREATE DATABASE.
+ * @param sql The statements.
+ * @return int 0 on success, -1 on failure.
+ */
+int db_exec(AlilDB *db, const char *sql);
+
+/**
+ * @brief Prepare a single statement. '?' marks the parameters.
+ *
+ * @param db The handle.
+ * @param sql The statement.
+ * @param stmt Set to the statement on success.
+ * @return int 0 on success, -1 on failure.
+ */
+int db_prepare(AlilDB *db, const char *sql, AlilStmt **stmt);
+
+/**
+ * @brief Bind an integer to a parameter. The statement runs again on the next db_step.
+ *
+ * @param stmt The statement.
+ * @param index The zero-based index of the '?'.
+ * @param value The value.
+ * @return int 0 on success, -1 on failure.
+ */
+int db_bind_int(AlilStmt *stmt, int index, int value);
+
+/**
+ * @brief Bind a string to a parameter. The statement runs again on the next db_step.
+ *
+ * @param stmt The statement.
+ * @param index The zero-based index of the '?'.
+ * @param value The value, it is copied.
+ * @return int 0 on success, -1 on failure.
+ */
+int db_bind_text(AlilStmt *stmt, int index, const char *value);
+
+/**
+ * @brief Run the statement if it has not run yet and move to its next result row.
+ *
+ * @param stmt The statement.
+ * @return int DB_ROW when a row is available, DB_DONE when there are no more, -1 on failure.
+ */
+int db_step(AlilStmt *stmt);
+
+/**
+ * @brief Drop the result of a statement so that the next db_step runs it again. Bindings are kept.
+ *
+ * @param stmt The statement.
+ */
+void db_reset(AlilStmt *stmt);
+
+/**
+ * @brief Get the number of columns of the result, known after the first db_step.
+ *
+ * @param stmt The statement.
+ * @return int The number of columns.
+ */
+int db_column_count(const AlilStmt *stmt);
+
+/**
+ * @brief Get the name of a result column.
+ *
+ * @param stmt The statement.
+ * @param column The zero-based column index.
+ * @return const char* The name, NULL if the column does not exist.
+ */
+const char *db_column_name(const AlilStmt *stmt, int column);
+
+/**
+ * @brief Get the type of a result column.
+ *
+ * @param stmt The statement.
+ * @param column The zero-based column index.
+ * @return WireType The type, WIRE_INT32 for INT columns and WIRE_TEXT for string columns.
+ */
+WireType db_column_type(const AlilStmt *stmt, int column);
+
+/**
+ * @brief Check whether a value of the current row is NULL, only aggregates over no rows are.
+ *
+ * @param stmt The statement.
+ * @param column The zero-based column index.
+ * @return int 1 if the value is NULL, 0 otherwise.
+ */
+int db_column_is_null(const AlilStmt *stmt, int column);
+
+/**
+ * @brief Get a numeric value of the current row as an int.
+ *
+ * @param stmt The statement.
+ * @param column The zero-based column index.
+ * @return int The value, 0 for NULL and text values.
+ */
+int db_column_int(const AlilStmt *stmt, int column);
+
+/**
+ * @brief Get a numeric value of the current row as a 64-bit integer, for COUNT and SUM.
+ *
+ * @param stmt The statement.
+ * @param column The zero-based column index.
+ * @return long long The value, 0 for NULL and text values.
+ */
+long long db_column_int64(const AlilStmt *stmt, int column);
+
+/**
+ * @brief Get a numeric value of the current row as a double, for AVG.
+ *
+ * @param stmt The statement.
+ * @param column The zero-based column index.
+ * @return double The value, 0 for NULL and text values.
+ */
+double db_column_double(const AlilStmt *stmt, int column);
+
+/**
+ * @brief Get a text value of the current row.
+ *
+ * @param stmt The statement.
+ * @param column The zero-based column index.
+ * @return const char* The value, valid until the next db_step. NULL for NULL and numeric values.
+ */
+const char *db_column_text(const AlilStmt *stmt, int column);
+
+/**
+ * @brief Free a statement and its result.
+ *
+ * @param stmt The statement, can be NULL.
+ */
+void db_finalize(AlilStmt *stmt);
+
+#endif // ALILDB_H
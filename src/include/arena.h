@@ -0,0 +1,71 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE 65536
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next; // the chunk allocated before this one
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaChunk;
+
+/*
+ * Bump allocator: allocations are carved out of large chunks and never freed one by one. A mark taken with
+ * arena_mark and handed back to arena_release frees everything allocated after it at once.
+ */
+typedef struct
+{
+    ArenaChunk *head;  // the chunk allocations are carved from, NULL before the first one
+    ArenaChunk *spare; // a released chunk kept for the next growth so marks around small work never call malloc
+} Arena;
+
+typedef struct
+{
+    ArenaChunk *chunk;
+    size_t used;
+} ArenaMark;
+
+/**
+ * @brief Allocate memory from an arena, aligned for any type.
+ *
+ * @param arena The arena.
+ * @param size The number of bytes.
+ * @return void* The memory, NULL on failure. Valid until the arena is released past it.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Remember the current end of an arena.
+ *
+ * @param arena The arena.
+ * @return ArenaMark The mark.
+ */
+ArenaMark arena_mark(const Arena *arena);
+
+/**
+ * @brief Free everything allocated from an arena since a mark was taken.
+ *
+ * @param arena The arena.
+ * @param mark A mark of the arena, marks taken after it become invalid.
+ */
+void arena_release(Arena *arena, ArenaMark mark);
+
+/**
+ * @brief Free every chunk of an arena.
+ *
+ * @param arena The arena.
+ */
+void arena_free(Arena *arena);
+
+/**
+ * @brief Get the arena of the statement being executed. It is released when parser() returns.
+ *
+ * @return Arena* The arena.
+ */
+Arena *get_query_arena();
+
+#endif // ARENA_H
@@ -0,0 +1,89 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdint.h>
+
+#define BLOOM_BLOCK_WORDS 8   // a block is 256 bits, two blocks share a cache line
+#define BLOOM_BITS_PER_KEY 16 // well under 1% false positives for a blocked filter
+#define BLOOM_INITIAL_KEYS 1024
+
+struct Table;
+
+/*
+ * Blocked Bloom filter over the hash values of the primary keys. A key sets one bit in each word of a single
+ * block, so a lookup touches one cache line. Bits are never cleared: deleted keys stay in the filter until it
+ * is rebuilt from the live entries, which happens when the keys added since the last rebuild reach the capacity.
+ */
+typedef struct
+{
+    int block_count;
+    int capacity;     // keys the filter is sized for
+    int keys;         // keys added since the last rebuild, deleted ones included
+    uint32_t *blocks; // block_count * BLOOM_BLOCK_WORDS words
+    int dirty_from;   // first block changed since the last flush, -1 when none
+    int dirty_to;     // one past the last changed block
+    int resized;      // the filter was rebuilt since the last flush, the whole file is rewritten
+    int fd;           // the .bloom file, kept open from the first flush until the filter is freed, -1 before
+} BloomFilter;
+
+/**
+ * @brief Initialize an empty filter sized for capacity keys.
+ *
+ * @param bloom The filter.
+ * @param capacity The number of keys.
+ * @return int 0 on success, -1 on failure.
+ */
+int init_bloom_filter(BloomFilter *bloom, int capacity);
+
+/**
+ * @brief Release the memory of a filter and close its file.
+ *
+ * @param bloom The filter.
+ */
+void free_bloom_filter(BloomFilter *bloom);
+
+/**
+ * @brief Add the hash value of a key to the filter.
+ *
+ * @param bloom The filter.
+ * @param hash The hash value of the key.
+ */
+void bloom_add(BloomFilter *bloom, uint32_t hash);
+
+/**
+ * @brief Check whether a key can be in the filter.
+ *
+ * @param bloom The filter.
+ * @param hash The hash value of the key.
+ * @return int 0 if the key was never added, 1 if it may have been.
+ */
+int bloom_may_contain(const BloomFilter *bloom, uint32_t hash);
+
+/**
+ * @brief Write the header and the blocks changed since the last flush to the .bloom file next to the .hashmap
+ *        file, which stays open for the next flush. An insert writes the header and one block, only a rebuilt
+ *        filter is written whole.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int flush_bloom_filter(struct Table *table);
+
+/**
+ * @brief Load the filter of a table from its .bloom file, or rebuild it from the hash entries when the file
+ *        is missing.
+ *
+ * @param table The table, its hashmap already read.
+ * @return int 0 on success, -1 on failure.
+ */
+int load_bloom_filter(struct Table *table);
+
+/**
+ * @brief Delete the .bloom file of a table.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int remove_bloom_filter(const struct Table *table);
+
+#endif // BLOOM_H
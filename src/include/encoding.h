@@ -0,0 +1,116 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <stdint.h>
+
+struct Table;
+
+typedef enum
+{
+    ENCODING_PLAIN,              // the value as it is in the row image
+    ENCODING_FRAME_OF_REFERENCE, // INT columns: value - base in 1, 2 or 4 bytes
+    ENCODING_DICTIONARY          // STRING columns: the code of the value in the column's dictionary, 1, 2 or 4 bytes
+} EncodingType;
+
+/*
+ * Distinct values of a dictionary encoded column. Code i is the i-th value added, values keep the width of the
+ * column in the row image (lenght + 1 zero padded bytes) so a decoded value is a plain copy.
+ */
+typedef struct
+{
+    int count;
+    int capacity;
+    int value_size;
+    char *values; // count * value_size bytes
+    int *slots;   // open addressing over the values, code + 1 per slot, 0 when empty
+    int slot_count;
+} Dictionary;
+
+typedef struct
+{
+    EncodingType type;
+    int width; // bytes of a stored value
+    int base;  // frame of reference of an INT column
+    Dictionary dictionary;
+} ColumnEncoding;
+
+/**
+ * @brief Create the initial encodings of a compressed table: dictionaries for STRING columns and
+ *        frame of reference for INT columns, both starting one byte wide.
+ *
+ * @param table The table.
+ * @return ColumnEncoding* One encoding per column, NULL on failure.
+ */
+ColumnEncoding *create_column_encodings(const struct Table *table);
+
+/**
+ * @brief Free the encodings of a table and their dictionaries.
+ *
+ * @param encodings The encodings.
+ * @param columns_count The number of columns.
+ */
+void free_column_encodings(ColumnEncoding *encodings, int columns_count);
+
+/**
+ * @brief Find the code of a value.
+ *
+ * @param dictionary The dictionary.
+ * @param value The value, compared up to the value size of the dictionary.
+ * @return int The code, -1 if the value is not in the dictionary.
+ */
+int dictionary_find(const Dictionary *dictionary, const char *value);
+
+/**
+ * @brief Add a value to a dictionary if it is not in it yet.
+ *
+ * @param dictionary The dictionary.
+ * @param value The value, value_size bytes.
+ * @param added Set to 1 if the value was added, 0 if it was already there.
+ * @return int The code of the value, -1 on failure.
+ */
+int dictionary_add(Dictionary *dictionary, const char *value, int *added);
+
+/**
+ * @brief Get the value of a code.
+ *
+ * @param dictionary The dictionary.
+ * @param code A code of the dictionary.
+ * @return const char* The value, value_size bytes.
+ */
+const char *dictionary_value(const Dictionary *dictionary, uint32_t code);
+
+/**
+ * @brief Append the value of a code to the .dict file of a column.
+ *
+ * @param table The table.
+ * @param column_index The dictionary encoded column.
+ * @param code The code that was just added.
+ * @return int 0 on success, -1 on failure.
+ */
+int append_dictionary_value(const struct Table *table, int column_index, int code);
+
+/**
+ * @brief Load the dictionaries of a compressed table from their .dict files.
+ *
+ * @param table The table, its encodings already read from the metadata.
+ * @return int 0 on success, -1 on failure.
+ */
+int load_dictionaries(struct Table *table);
+
+/**
+ * @brief Create the empty .dict files of a compressed table.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int create_dictionary_files(const struct Table *table);
+
+/**
+ * @brief Delete the .dict files of a compressed table.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int remove_dictionary_files(const struct Table *table);
+
+#endif // ENCODING_H
@@ -41,6 +41,7 @@ typedef struct Expression
         {
             char *value;
             int is_string;
+            int parameter; // placeholder index in a prepared statement, -1 for constants
         } literal;
 
         char *column_name;
@@ -86,6 +87,13 @@ Expression *parse_expression(Token *tokens, int *i, int count);
  */
 int evaluate_expression(Expression *expr, Table *tables[], char *alias[], char *row_datas[], int table_count);
 
+/**
+ * Prints the expression tree in SQL form to stdout.
+ *
+ * @param expr The expression tree to print.
+ */
+void print_expression(const Expression *expr);
+
 /**
  * Frees all memory used by the expression tree.
  *
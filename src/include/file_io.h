@@ -142,6 +142,14 @@ int update_hashmap_file_free_spaces_count(const Table *table);
  */
 int update_hashmap_file_free_spaces(const Table *table);
 
+/**
+ * @brief Write the whole header of the hashmap file (size, entries, free spaces count and free spaces) at once.
+ *
+ * @param table The table whose hashmap file is to be updated.
+ * @return int 0 on success, -1 on failure.
+ */
+int store_hashmap_header(const Table *table);
+
 /**
  * @brief Read all data from the binary file of the table.
  *
@@ -272,6 +280,14 @@ int update_table_count_on_file();
  */
 int list_tables();
 
+/**
+ * @brief Print the status of every loaded table: live rows, bytes of its data files, free row slots,
+ *        load factor and average chain length of its primary key index.
+ *
+ * @return int 0 on success, -1 on failure.
+ */
+int list_table_status();
+
 /**
  * @brief Read every table in the .tables file and create the tables.
  * 
@@ -7,9 +7,10 @@
 #define DEFAULT_TABLE_SIZE 1000
 #define MAX_FREE_SPACES 500
 #define MAX_TOKEN_LENGTH 256
-#define MAX_TOKEN_COUNT 256
 #define MAX_TABLE_COUNT 100
 #define MAX_JOIN_COUNT 10
+#define MAX_PARAMETER_COUNT 32
+#define WRITE_BUFFER_SIZE 4096
 
 typedef struct Globals Globals;
 
@@ -113,6 +114,14 @@ int set_db_name(const char *db_name);
  */
 int is_db_loaded();
 
+/**
+ * @brief Get the schema version, which changes whenever tables are loaded, created or dropped.
+ *        Anything caching Table pointers must resolve them again when it changes.
+ *
+ * @return unsigned long The current schema version.
+ */
+unsigned long get_schema_version();
+
 /**
  * @brief Remove a table from the global variables and free its memory.
  *
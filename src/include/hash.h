@@ -0,0 +1,89 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+    HASH_FNV1A, // byte at a time FNV-1a, the primary key hash of tables created before HASH_WORD
+    HASH_WORD   // eight bytes per step folded with 64-bit multiplies, integers through a murmur finalizer
+} HashKind;
+
+/*
+ * The functions of one hash kind. Primary key hashes are stored in the hashmap file, so a table keeps the
+ * kind it was created with.
+ */
+typedef struct
+{
+    const char *name;
+    uint32_t (*hash_int)(int key);
+    uint32_t (*hash_str)(const char *key);
+    uint32_t (*hash_bytes)(const void *data, size_t length);
+} HashFunctions;
+
+/**
+ * @brief Get the functions of a hash kind.
+ *
+ * @param kind The hash kind.
+ * @return const HashFunctions* The functions, never NULL.
+ */
+const HashFunctions *get_hash_functions(HashKind kind);
+
+/**
+ * @brief Hash a 32-bit integer with the murmur3 finalizer, every input bit reaches every output bit.
+ *
+ * @param key The integer.
+ * @return uint32_t The hash value.
+ */
+uint32_t word_hash_int(int key);
+
+/**
+ * @brief Hash a null-terminated string eight bytes at a time.
+ *
+ * @param key The string.
+ * @return uint32_t The hash value.
+ */
+uint32_t word_hash_str(const char *key);
+
+/**
+ * @brief Hash arbitrary bytes eight at a time.
+ *
+ * @param data The bytes.
+ * @param length The number of bytes.
+ * @return uint32_t The hash value.
+ */
+uint32_t word_hash_bytes(const void *data, size_t length);
+
+/**
+ * @brief CRC32C of arbitrary bytes, with the SSE4.2 crc32 instruction when the CPU has it and a table
+ *        otherwise. The CPU is checked at run time, no build flag is needed. Both give the same values.
+ *
+ * @param data The bytes.
+ * @param length The number of bytes.
+ * @return uint32_t The checksum, finalized through the murmur finalizer for use as a hash value.
+ */
+uint32_t crc32c_hash_bytes(const void *data, size_t length);
+
+/**
+ * @brief Hash many integers at once, the loop has no calls for HASH_WORD so the compiler can vectorize it.
+ *
+ * @param kind The hash kind.
+ * @param keys The integers.
+ * @param hashes Filled with one hash value per integer.
+ * @param count The number of integers.
+ */
+void hash_int_batch(HashKind kind, const int keys[], uint32_t hashes[], int count);
+
+/**
+ * @brief Hash many zero padded strings laid out at a fixed stride, like a column of row images.
+ *
+ * @param kind The hash kind.
+ * @param values The first string.
+ * @param stride Bytes from one string to the next, a string ends at its first zero byte or after stride bytes.
+ * @param hashes Filled with one hash value per string.
+ * @param count The number of strings.
+ */
+void hash_str_batch(HashKind kind, const char *values, size_t stride, uint32_t hashes[], int count);
+
+#endif // HASH_H
@@ -2,6 +2,7 @@
 #define HASHMAP_H
 
 #include "globals.h"
+#include "bloom.h"
 #include <stdint.h>
 
 struct Table; // Forward declaration of Table struct
@@ -21,13 +22,26 @@ typedef struct HashEntry
     struct HashEntry *next;
 } HashEntry;
 
+#define HASH_SLAB_ENTRIES 256
+
+// Hash entries are carved out of slabs instead of being malloc'd one by one
+typedef struct HashEntrySlab
+{
+    struct HashEntrySlab *next;
+    HashEntry entries[HASH_SLAB_ENTRIES];
+} HashEntrySlab;
+
 typedef struct
 {
     int size;
     int entries;
     HashEntry **buckets;
+    HashEntrySlab *slabs;    // the newest slab first
+    int slab_used;           // entries handed out from the newest slab
+    HashEntry *free_entries; // released entries, linked through next
     long free_hash_spaces[DEFAULT_FREE_HASH_SPACES];
     int free_hash_spaces_count;
+    BloomFilter bloom; // hash values of the keys, rejects most lookups of absent keys
 } HashTable;
 
 /**
@@ -38,6 +52,22 @@ typedef struct
  */
 HashTable *create_hashtable(const int size);
 
+/**
+ * @brief Take an unlinked hash entry from the slabs of a hash table.
+ *
+ * @param hash The hash table.
+ * @return HashEntry* The entry, NULL if failed.
+ */
+HashEntry *alloc_hash_entry(HashTable *hash);
+
+/**
+ * @brief Give an unlinked hash entry back to the slabs of its hash table.
+ *
+ * @param hash The hash table.
+ * @param entry The entry, taken from the same hash table.
+ */
+void release_hash_entry(HashTable *hash, HashEntry *entry);
+
 /**
  * @brief Create a hash entry with the given key, hash value, and file position and store it in the corresponding index of hashtable.
  *
@@ -51,6 +81,7 @@ HashEntry *create_hash_entry(HashTable *hashmap, const Key key, const uint32_t h
 
 /**
  * @brief Find the right entry in the bucket for the given key and hash value.
+ *        The bloom filter is checked first so most absent keys never walk the bucket.
  *
  * @param hash The hash table.
  * @param key The key to search for.
@@ -59,6 +90,29 @@ HashEntry *create_hash_entry(HashTable *hashmap, const Key key, const uint32_t h
  */
 HashEntry *find_right_entry_in_bucket(HashTable *hash, const Key key, const uint32_t hash_value);
 
+/**
+ * @brief Find the entry that points at the given record position. Works for every key type
+ *        since only the hash value and the position are compared.
+ *
+ * @param hash The hash table.
+ * @param hash_value The hash value of the record's key.
+ * @param file_pos The position of the record in the bin file.
+ * @return HashEntry* Pointer to the found hash entry. NULL if not found.
+ */
+HashEntry *find_entry_by_position(HashTable *hash, const uint32_t hash_value, const long file_pos);
+
+/**
+ * @brief Give an entry a new key, unlinking it from its bucket and appending it to the bucket of the new hash value.
+ *        The entry keeps its file position and its slot in the hashmap file.
+ *
+ * @param hash The hash table.
+ * @param entry The entry to move.
+ * @param key The new key.
+ * @param hash_value The hash value of the new key.
+ * @return int 0 on success, -1 if the entry is not in the table.
+ */
+int move_hash_entry(HashTable *hash, HashEntry *entry, const Key key, const uint32_t hash_value);
+
 /**
  * @brief Delete entry from hashmap and arrange pointers in the same bucket
  *
@@ -68,6 +122,22 @@ HashEntry *find_right_entry_in_bucket(HashTable *hash, const Key key, const uint
  */
 int delete_hash_entry(HashTable *hash, HashEntry *entry);
 
+/**
+ * @brief Rebuild the bloom filter of a hash table from its entries, sized for twice their number.
+ *
+ * @param hash The hash table.
+ * @return int 0 on success, -1 on failure, the old filter is kept then.
+ */
+int rebuild_bloom_filter(HashTable *hash);
+
+/**
+ * @brief Count the buckets that hold at least one entry.
+ *
+ * @param hash The hash table.
+ * @return int The number of non-empty buckets.
+ */
+int count_used_buckets(const HashTable *hash);
+
 /**
  * @brief Delete the entire hash table and free its memory.
  *
@@ -0,0 +1,229 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "expression.h"
+#include "table.h"
+#include "globals.h"
+
+#define MAX_CONJUNCT_COUNT 64
+#define DEFAULT_SELECTIVITY (1.0 / 3.0)
+
+typedef enum
+{
+    EXPLAIN_NONE,
+    EXPLAIN_PLAN,
+    EXPLAIN_ANALYZE
+} ExplainMode;
+
+typedef enum
+{
+    ACCESS_SCAN,
+    ACCESS_HASH_LOOKUP
+} AccessMethod;
+
+typedef struct
+{
+    Expression *expr;        // borrowed from the WHERE expression tree, not owned
+    unsigned int tables;     // bitmask of the table indexes the conjunct references
+    int depth;               // shallowest join depth at which every referenced table is bound
+    double selectivity;      // estimated fraction of rows that satisfy the conjunct
+    int key_table;           // table whose INT primary key the conjunct equates, -1 if none
+    Expression *key_expr;    // the other side of that equality
+    unsigned int key_tables; // bitmask of the tables key_expr references
+    int code_table;          // table whose dictionary encoded column the conjunct compares with a literal, -1 if none
+    int code_column;         // that column
+    long code;               // code of the literal, resolved when the plan is executed
+    int zone_table;          // table whose INT column the conjunct compares with a number, -1 if none
+    int zone_column;         // that column
+    Operator zone_op;        // the comparison with the column on the left side
+    int zone_value;          // the number, resolved when the plan is executed
+    int zone_usable;         // set when the literal is bound to a number, block bounds are checked only then
+} Conjunct;
+
+typedef struct
+{
+    AccessMethod method;
+    Expression *key; // value probed in the primary key index for ACCESS_HASH_LOOKUP
+} AccessPath;
+
+typedef struct
+{
+    long loops;          // times the table was scanned or probed
+    long rows_read;      // live rows fetched from the file
+    long rows_out;       // rows that passed the conjuncts of the depth
+    long bytes_read;     // bytes fetched from the file
+    long index_probes;   // primary key index lookups
+    long blocks_skipped; // blocks of rows passed over by the zone map
+    double time_ms;      // time spent fetching and filtering, deeper levels excluded
+} OperatorStats;
+
+/*
+ * Row positions of the matches of a join, one per table for each match, grown as the matches come in.
+ */
+typedef struct PositionList
+{
+    long *positions;
+    long count;    // matches held
+    long capacity; // matches that fit before it grows
+    int failed;    // set when it could not grow
+} PositionList;
+
+typedef struct QueryPlan
+{
+    int table_count;
+    int order[MAX_JOIN_COUNT];              // table indexes in join order, outermost first
+    AccessPath access[MAX_JOIN_COUNT];      // per table index
+    double estimated_rows[MAX_JOIN_COUNT];  // per table index, after its single-table conjuncts
+    double estimated_cost;                  // estimated number of rows read by the join
+    Conjunct conjuncts[MAX_CONJUNCT_COUNT]; // sorted by depth
+    int conjunct_count;
+    int depth_start[MAX_JOIN_COUNT + 1];    // first conjunct evaluated at each depth
+    int used_columns[MAX_JOIN_COUNT][MAX_COLUMN_COUNT]; // per table index, COLUMN_VALUES or COLUMN_CODES when the conjuncts read a column
+    int analyze;                            // collect OperatorStats while executing
+    OperatorStats stats[MAX_JOIN_COUNT];    // per depth
+    double total_time_ms;
+    int match_count;
+    struct GroupTable *aggregate; // matching rows are folded into its groups instead of being returned, NULL for none
+    struct Sorter *sorter;        // matching rows are handed to it instead of being returned, NULL for none
+    PositionList *matches;        // positions of matching rows are appended to it instead of being returned, NULL for none
+    long row_limit;               // the join stops once this many rows matched, -1 for no limit
+} QueryPlan;
+
+/**
+ * @brief Build an execution plan for a WHERE expression over the given tables.
+ *        Splits the expression into AND conjuncts tagged with the tables they reference, chooses the
+ *        cheapest join order and access paths using the table statistics and assigns every conjunct
+ *        to the shallowest join depth where all of its tables are bound.
+ *
+ * @param plan The plan to fill.
+ * @param expr The WHERE expression, can be NULL. The plan borrows its nodes so it must outlive the plan.
+ * @param tables The tables in FROM-clause order.
+ * @param alias The aliases of the tables.
+ * @param table_count The number of tables.
+ * @return int 0 on success, -1 on failure.
+ */
+int build_query_plan(QueryPlan *plan, Expression *expr, Table *tables[], char *alias[], int table_count);
+
+/**
+ * @brief Find the table and column a column expression refers to.
+ *
+ * @param expr An EXPR_COLUMN or EXPR_ALIAS_COLUMN expression.
+ * @param tables The tables in FROM-clause order.
+ * @param alias The aliases of the tables.
+ * @param table_count The number of tables.
+ * @param column_index Set to the index of the column in its table.
+ * @return int The index of the table, -1 if the column does not exist, -2 if more than one table has it.
+ */
+int resolve_column(Expression *expr, Table *tables[], char *alias[], int table_count, int *column_index);
+
+/**
+ * @brief Find the table and column of a column named the way SelectQuery stores selected columns.
+ *
+ * @param tables The tables in FROM-clause order.
+ * @param alias The aliases of the tables.
+ * @param table_count The number of tables.
+ * @param column_alias The alias of the column's table, the column name itself when the column is not qualified.
+ * @param name The column name.
+ * @param column_index Set to the index of the column in its table.
+ * @return int The index of the table, -1 if the column does not exist, -2 if more than one table has it.
+ */
+int resolve_named_column(Table *tables[], char *alias[], int table_count, char *column_alias, char *name, int *column_index);
+
+/**
+ * @brief Mark every column an expression reads as used by the plan, so scans of columnar tables read it.
+ *
+ * @param plan The plan.
+ * @param expr The expression, can be NULL.
+ * @param tables The tables in FROM-clause order.
+ * @param alias The aliases of the tables.
+ * @param table_count The number of tables.
+ */
+void mark_used_columns(QueryPlan *plan, Expression *expr, Table *tables[], char *alias[], int table_count);
+
+/**
+ * @brief Evaluate the conjuncts assigned to a join depth against the current rows.
+ *
+ * @param plan The plan holding the conjuncts.
+ * @param depth The join depth, rows of the tables at plan->order[0..depth] must be loaded.
+ * @param tables The tables in FROM-clause order.
+ * @param alias The aliases of the tables.
+ * @param rows The current row data of each table.
+ * @param table_count The number of tables.
+ * @return int 1 if every conjunct is satisfied, 0 otherwise.
+ */
+int evaluate_conjuncts_at_depth(const QueryPlan *plan, int depth, Table *tables[], char *alias[], char *rows[], int table_count);
+
+/**
+ * @brief Evaluate the conjuncts assigned to a join depth that compare dictionary codes.
+ *        evaluate_conjuncts_at_depth leaves them out.
+ *
+ * @param plan The plan holding the conjuncts, its codes resolved by resolve_conjunct_literals.
+ * @param depth The join depth.
+ * @param codes The dictionary codes of the current row of the table at plan->order[depth].
+ * @return int 1 if every such conjunct is satisfied, 0 otherwise.
+ */
+int evaluate_code_conjuncts_at_depth(const QueryPlan *plan, int depth, const uint32_t codes[]);
+
+/**
+ * @brief Check the zone map of a block of rows against the conjuncts assigned to a join depth.
+ *
+ * @param plan The plan holding the conjuncts, its literals resolved by resolve_conjunct_literals.
+ * @param depth The join depth.
+ * @param table The table at plan->order[depth].
+ * @param block The block of ZONE_BLOCK_ROWS rows.
+ * @return int 0 if no row of the block can satisfy the conjuncts, 1 if it has to be read.
+ */
+int block_may_match(const QueryPlan *plan, int depth, const Table *table, int block);
+
+/**
+ * @brief Look the literals of the dictionary code conjuncts up in their dictionaries and convert the
+ *        numbers the zone map conjuncts compare with. Done before every execution since prepared
+ *        statements bind the literals after planning.
+ *
+ * @param plan The plan.
+ * @param tables The tables in FROM-clause order.
+ */
+void resolve_conjunct_literals(QueryPlan *plan, Table *tables[]);
+
+/**
+ * @brief Check whether a plan only counts the rows of one table, either all of them or the one its primary
+ *        key equality selects. Such a plan is answered from Table.record_size or the primary key index
+ *        without reading the table.
+ *
+ * @param plan The plan, with its aggregate set.
+ * @return int 1 if the count needs no rows, 0 otherwise.
+ */
+int is_index_only_count(const QueryPlan *plan);
+
+/**
+ * @brief Print the plan: join order, access path and filters of every table, and the
+ *        collected OperatorStats when the plan was executed with analyze set.
+ *
+ * @param plan The plan to print.
+ * @param tables The tables in FROM-clause order.
+ * @param alias The aliases of the tables.
+ */
+void print_query_plan(const QueryPlan *plan, Table *tables[], char *alias[]);
+
+/**
+ * @brief Set the EXPLAIN mode of the statement being parsed.
+ *
+ * @param mode The new mode.
+ */
+void set_explain_mode(ExplainMode mode);
+
+/**
+ * @brief Get the EXPLAIN mode of the statement being parsed.
+ *
+ * @return ExplainMode The current mode, EXPLAIN_NONE for normal execution.
+ */
+ExplainMode get_explain_mode();
+
+/**
+ * @brief Get a monotonic timestamp for measuring durations.
+ *
+ * @return double The timestamp in milliseconds.
+ */
+double get_time_ms();
+
+#endif // PLANNER_H
@@ -0,0 +1,116 @@
+#ifndef PREPARED_H
+#define PREPARED_H
+
+#include "sql_tokenizer.h"
+#include "planner.h"
+#include "globals.h"
+
+#define MAX_PREPARED_COUNT 64
+
+typedef enum
+{
+    PREPARED_INSERT,
+    PREPARED_SELECT,
+    PREPARED_OTHER // parsed again from the cached tokens on every execution
+} PreparedKind;
+
+typedef struct PreparedStatement
+{
+    char name[MAX_NAME_LEN];
+    char *sql;     // copy of the statement text the tokens point into
+    Token *tokens; // the statement followed by TOKEN_EOF, placeholders numbered from 0
+    int token_count;
+    Token *bound_tokens; // scratch copy with the placeholders replaced, for PREPARED_OTHER
+    int parameter_count;
+    Token parameters[MAX_PARAMETER_COUNT];                    // bound values, TOKEN_ERROR until bound
+    char parameter_text[MAX_PARAMETER_COUNT][MAX_TOKEN_LENGTH]; // text the bound values point into
+    PreparedKind kind;
+    unsigned long schema_version; // schema the cached tables and columns were resolved against
+    InsertQuery insert;
+    SelectQuery select;
+    QueryPlan plan;                                   // plan of select.where
+    Expression *parameter_nodes[MAX_PARAMETER_COUNT]; // literals of select.where that take the bound values
+} PreparedStatement;
+
+/**
+ * @brief Prepare a statement from its SQL text. '?' marks the parameters.
+ *
+ * @param sql A single SQL statement.
+ * @return PreparedStatement* The prepared statement, NULL on failure. Free with free_prepared_statement.
+ */
+PreparedStatement *prepare_statement(const char *sql);
+
+/**
+ * @brief Prepare a statement from already tokenized SQL. INSERT and SELECT statements are parsed once,
+ *        their tables, columns and plan are cached; other statements only cache the tokens.
+ *
+ * @param tokens The tokens of a single statement, they and the SQL text they point into are copied.
+ * @param token_count The number of tokens, without the trailing TOKEN_EOF.
+ * @return PreparedStatement* The prepared statement, NULL on failure. Free with free_prepared_statement.
+ */
+PreparedStatement *prepare_tokens(const Token *tokens, int token_count);
+
+/**
+ * @brief Bind an integer to a parameter.
+ *
+ * @param stmt The prepared statement.
+ * @param index The zero-based index of the '?' in the statement.
+ * @param value The value to bind.
+ * @return int 0 on success, -1 on failure.
+ */
+int bind_parameter_int(PreparedStatement *stmt, int index, int value);
+
+/**
+ * @brief Bind a string to a parameter.
+ *
+ * @param stmt The prepared statement.
+ * @param index The zero-based index of the '?' in the statement.
+ * @param value The value to bind, it is copied.
+ * @return int 0 on success, -1 on failure.
+ */
+int bind_parameter_text(PreparedStatement *stmt, int index, const char *value);
+
+/**
+ * @brief Bind a TOKEN_NUMBER or TOKEN_STRING token to a parameter.
+ *
+ * @param stmt The prepared statement.
+ * @param index The zero-based index of the '?' in the statement.
+ * @param value The token to bind, it is copied.
+ * @return int 0 on success, -1 on failure.
+ */
+int bind_parameter_token(PreparedStatement *stmt, int index, const Token *value);
+
+/**
+ * @brief Run a prepared statement with its bound parameters. Bindings are kept between executions.
+ *        Tables and columns are resolved again if tables were created, dropped or loaded since.
+ *
+ * @param stmt The prepared statement.
+ * @return int 0 on success, -1 on failure.
+ */
+int execute_prepared_statement(PreparedStatement *stmt);
+
+/**
+ * @brief Free a prepared statement.
+ *
+ * @param stmt The statement to free, can be NULL.
+ */
+void free_prepared_statement(PreparedStatement *stmt);
+
+/**
+ * @brief Register a prepared statement under a name for EXECUTE, replacing any statement with that name.
+ *
+ * @param name The name of the statement.
+ * @param stmt The statement, owned by the registry on success.
+ * @return int 0 on success, -1 on failure.
+ */
+int register_prepared_statement(const char *name, PreparedStatement *stmt);
+
+/**
+ * @brief Get a registered prepared statement by name.
+ *
+ * @param name The name of the statement.
+ * @return PreparedStatement* The statement, NULL if not found.
+ */
+PreparedStatement *get_prepared_statement(const char *name);
+
+#endif // PREPARED_H
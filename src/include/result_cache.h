@@ -0,0 +1,70 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "sql_tokenizer.h"
+#include "globals.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESULT_CACHE_ENTRIES 64
+#define RESULT_CACHE_MAX_OUTPUT (1 << 20) // results printing more bytes than this are not cached
+
+/*
+ * Printed output of a SELECT statement. It stays valid while the schema and every table the statement
+ * reads keep the versions they had when the statement ran.
+ */
+typedef struct
+{
+    uint32_t hash; // hash of key
+    char *key;     // normalized tokens of the statement, NULL for an unused entry
+    size_t key_length;
+    char *output;
+    size_t output_length;
+    unsigned long schema_version;
+    unsigned long table_versions[MAX_JOIN_COUNT];
+    int table_count;
+    unsigned long last_used; // for evicting the least recently used entry
+} ResultCacheEntry;
+
+/**
+ * @brief Build the cache key of a statement: the protocol of the session, then the token types, with the text
+ *        of identifiers, strings and numbers. Whitespace does not change the key.
+ *
+ * @param tokens The tokens of the statement.
+ * @param token_count The number of tokens.
+ * @param key_length Set to the length of the key.
+ * @return char* The key, allocated from the query arena. NULL on failure.
+ */
+char *build_result_cache_key(const Token *tokens, int token_count, size_t *key_length);
+
+/**
+ * @brief Find the cached output of a statement that is still valid for the given tables.
+ *
+ * @param key The key of the statement.
+ * @param key_length The length of the key.
+ * @param tables The tables the statement reads.
+ * @param table_count The number of tables.
+ * @return const ResultCacheEntry* The entry, NULL on a miss. Valid until the next call that changes the cache.
+ */
+const ResultCacheEntry *find_cached_result(const char *key, size_t key_length, Table *tables[], int table_count);
+
+/**
+ * @brief Cache the output of a statement, evicting the least recently used entry when the cache is full.
+ *
+ * @param key The key of the statement.
+ * @param key_length The length of the key.
+ * @param tables The tables the statement read.
+ * @param table_count The number of tables.
+ * @param output The printed output.
+ * @param output_length The length of the output.
+ * @return int 0 on success or when the output is too large to cache, -1 on failure.
+ */
+int cache_result(const char *key, size_t key_length, Table *tables[], int table_count, const char *output,
+                 size_t output_length);
+
+/**
+ * @brief Drop every cached result.
+ */
+void clear_result_cache();
+
+#endif // RESULT_CACHE_H
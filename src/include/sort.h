@@ -0,0 +1,81 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "table.h"
+#include "globals.h"
+#include "wire.h"
+#include <stdio.h>
+
+#define SORT_MEMORY_LIMIT (4 << 20) // bytes of sort records kept in memory before a run is spilled to disk
+#define MAX_SORT_RUNS 64            // runs merged at once, more are first merged into one
+
+typedef struct SelectQuery SelectQuery; // Forward declaration of SelectQuery struct
+typedef struct QueryPlan QueryPlan;     // Forward declaration of QueryPlan struct
+
+/*
+ * ORDER BY: every matching row becomes a record of its sort key followed by the positions of its joined rows.
+ * Records are sorted in memory, spilled as sorted runs to temporary files when they outgrow SORT_MEMORY_LIMIT
+ * and merged at the end. With a LIMIT only the best limit records are kept, in a heap.
+ */
+typedef struct Sorter
+{
+    const SelectQuery *query;
+    int key_tables[MAX_COLUMN_COUNT];  // per ORDER BY column, the index of its table
+    int key_columns[MAX_COLUMN_COUNT]; // per ORDER BY column, its index in the table
+    int key_offsets[MAX_COLUMN_COUNT]; // per ORDER BY column, where its value starts in a record
+    int key_size;
+    int record_size; // the key, then one long position per table
+    long limit;      // records kept by a top-N sort, LIMIT plus OFFSET, -1 for a full sort
+    char *records;
+    long record_count;
+    long capacity;
+    FILE *runs[MAX_SORT_RUNS];
+    int run_count;
+    int spilled_runs; // runs written over the whole sort, for EXPLAIN ANALYZE
+    int failed;       // set when a record could not be kept
+} Sorter;
+
+/**
+ * @brief Prepare the sorter of a query with ORDER BY.
+ *
+ * @param sorter The sorter to fill.
+ * @param query The parsed query, must outlive the sorter.
+ * @return int 0 on success, -1 on failure.
+ */
+int init_sorter(Sorter *sorter, const SelectQuery *query);
+
+/**
+ * @brief Mark the ORDER BY columns as used by a plan.
+ *
+ * @param sorter The sorter.
+ * @param plan The plan of the query.
+ */
+void mark_sort_columns(const Sorter *sorter, QueryPlan *plan);
+
+/**
+ * @brief Add a joined row to the sort.
+ *
+ * @param sorter The sorter.
+ * @param tables The tables in FROM-clause order.
+ * @param rows The current row data of each table.
+ * @param positions The positions of the current rows.
+ */
+void sort_row(Sorter *sorter, Table *tables[], char *rows[], const long positions[]);
+
+/**
+ * @brief Write the positions of the sorted rows, one row per joined row.
+ *
+ * @param sorter The sorter.
+ * @param out The result set to write to, begun with one INT64 column per table.
+ * @return int 0 on success, -1 on failure.
+ */
+int print_sorted(Sorter *sorter, ResultWriter *out);
+
+/**
+ * @brief Free the records and close the runs of a sorter.
+ *
+ * @param sorter The sorter.
+ */
+void free_sorter(Sorter *sorter);
+
+#endif // SORT_H
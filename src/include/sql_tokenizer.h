@@ -3,10 +3,14 @@
 
 #include "expression.h"
 #include "table.h"
+#include "storage.h"
 #include "globals.h"
+#include "aggregate.h"
 #include <stdio.h>
 
 typedef struct Expression Expression;
+typedef struct PositionList PositionList;
+typedef struct QueryPlan QueryPlan;
 typedef enum
 {
     TOKEN_SELECT,
@@ -54,6 +58,11 @@ typedef enum
     TOKEN_SUB,
     TOKEN_DIV,
     TOKEN_NOT,
+    TOKEN_EXPLAIN,
+    TOKEN_ANALYZE,
+    TOKEN_PREPARE,
+    TOKEN_EXECUTE,
+    TOKEN_PARAMETER, // '?' placeholder, the token holds its zero-based index in the statement
     TOKEN_EOF,
     TOKEN_ERROR
 } TokenType;
@@ -61,20 +70,114 @@ typedef enum
 typedef struct Token
 {
     TokenType type;
-    char token[MAX_TOKEN_LENGTH];
+    union
+    {
+        int length;    // bytes of the lexeme
+        int parameter; // zero-based placeholder index for TOKEN_PARAMETER
+    };
+    const char *start; // points into the SQL text the token was read from, not NUL-terminated
 } Token;
 
+typedef struct TokenVector
+{
+    Token *tokens;
+    int count;
+    int capacity;
+} TokenVector;
+
+typedef struct InsertQuery
+{
+    Table *table;
+    const Token *values[MAX_COLUMN_COUNT]; // TOKEN_NUMBER, TOKEN_STRING or TOKEN_PARAMETER per column, point into the token array
+} InsertQuery;
+
+typedef struct SelectQuery
+{
+    int all;
+    char *column_names[MAX_COLUMN_COUNT]; // NULL for an aggregate
+    char *column_alias[MAX_COLUMN_COUNT];
+    int item_aggregate[MAX_COLUMN_COUNT]; // per selected item, the index of its aggregate, -1 for a column
+    int column_count;
+    Aggregate aggregates[MAX_COLUMN_COUNT];
+    int aggregate_count;
+    char *group_names[MAX_COLUMN_COUNT]; // GROUP BY columns, named like the selected columns
+    char *group_alias[MAX_COLUMN_COUNT];
+    int group_count;
+    char *order_names[MAX_COLUMN_COUNT]; // ORDER BY columns, named like the selected columns
+    char *order_alias[MAX_COLUMN_COUNT];
+    int order_descending[MAX_COLUMN_COUNT];
+    int order_count;
+    long limit;  // -1 without LIMIT
+    long offset; // result rows skipped before the first printed one
+    Table *tables[MAX_JOIN_COUNT];
+    char *alias[MAX_JOIN_COUNT];
+    int table_count;
+    Expression *where; // NULL without a WHERE clause
+} SelectQuery;
+
 /**
- * @brief Tokenize the given SQL string.
+ * @brief Tokenize the given SQL string into a reusable vector. The tokens point into sql,
+ *        which must outlive them. The vector only allocates when it has to grow.
  *
  * @param sql The SQL string to tokenize.
+ * @param vector The vector to fill, its previous tokens are discarded.
+ * @return int 0 on success, -1 on failure.
+ */
+int tokenize_into(const char *sql, TokenVector *vector);
+
+/**
+ * @brief Tokenize the given SQL string.
+ *
+ * @param sql The SQL string to tokenize, must outlive the tokens.
  * @param out_count Pointer to store the number of tokens.
- * @return Token* Pointer to the array of tokens.
+ * @return Token* Pointer to the array of tokens, NULL on failure. The caller must free it.
  */
 Token *tokenize(const char *sql, int *out_count);
 
+/**
+ * @brief Free the tokens of a vector and reset it.
+ *
+ * @param vector The vector to free.
+ */
+void free_token_vector(TokenVector *vector);
+
+/**
+ * @brief Compare the text of a token with a string.
+ *
+ * @param token The token.
+ * @param str The NUL-terminated string.
+ * @return int 1 if equal, 0 otherwise.
+ */
+int token_equals(const Token *token, const char *str);
+
+/**
+ * @brief Copy the text of a token to a new string.
+ *
+ * @param token The token.
+ * @return char* The NUL-terminated copy, the caller must free it. NULL on failure.
+ */
+char *token_strdup(const Token *token);
+
+/**
+ * @brief Copy the text of a token into a buffer, truncating it to fit.
+ *
+ * @param token The token.
+ * @param buffer The buffer.
+ * @param size The size of the buffer.
+ */
+void token_copy(const Token *token, char *buffer, int size);
+
+/**
+ * @brief Get the integer value of a number token.
+ *
+ * @param token The token, an optional leading '-' is accepted.
+ * @return int The value.
+ */
+int token_to_int(const Token *token);
+
 /**
  * @brief Parse the tokens and execute the corresponding SQL command by calling other parser functions.
+ *        Memory taken from the query arena while executing is released before returning.
  *
  * @param tokens The array of tokens to parse.
  * @param token_count The number of tokens.
@@ -92,6 +195,53 @@ int parser(Token *tokens, int token_count);
  */
 int parse_insert(Token *tokens, int token_count, int *iterator);
 
+/**
+ * @brief Parse the body of an INSERT statement and resolve its table without inserting anything.
+ *
+ * @param tokens The array of tokens to parse, must outlive the query.
+ * @param token_count The number of tokens.
+ * @param iterator Pointer to the current position in the token array.
+ * @param query The query to fill.
+ * @return int 0 on success, -1 on failure.
+ */
+int parse_insert_query(Token *tokens, int token_count, int *iterator, InsertQuery *query);
+
+/**
+ * @brief Insert the row described by a parsed INSERT query.
+ *
+ * @param query The parsed query.
+ * @param parameters The bound parameter values, NULL when the query has no placeholders.
+ * @return int 0 on success, -1 on failure.
+ */
+int run_insert_query(const InsertQuery *query, const Token parameters[]);
+
+/**
+ * @brief Parse the body of a SELECT statement and resolve its tables and columns without running it.
+ *
+ * @param tokens The array of tokens to parse.
+ * @param token_count The number of tokens.
+ * @param iterator Pointer to the current position in the token array.
+ * @param query The query to fill, release it with free_select_query.
+ * @return int 0 on success, -1 on failure.
+ */
+int parse_select_query(Token *tokens, int token_count, int *iterator, SelectQuery *query);
+
+/**
+ * @brief Run a parsed SELECT query and print its result, honouring the current EXPLAIN mode.
+ *
+ * @param query The parsed query.
+ * @param plan A plan built for the query's WHERE expression, NULL to plan it now.
+ * @return int 0 on success, -1 on failure.
+ */
+int run_select_query(SelectQuery *query, QueryPlan *plan);
+
+/**
+ * @brief Free the memory owned by a parsed SELECT query.
+ *
+ * @param query The query to release.
+ */
+void free_select_query(SelectQuery *query);
+
 /**
  * @brief Parse a SELECT statement.
  *
@@ -121,6 +271,17 @@ int parse_create(Token *tokens, int token_count, int *iterator);
  */
 int parse_show(Token *tokens, int token_count, int *iterator);
 
+/**
+ * @brief Parse a SET PROTOCOL TEXT or SET PROTOCOL BINARY statement, which selects the protocol of the
+ *        session. The response to the statement itself already comes in the selected protocol.
+ *
+ * @param tokens The array of tokens to parse.
+ * @param token_count The number of tokens.
+ * @param iterator Pointer to the current position in the token array.
+ * @return int 0 on success, -1 on failure.
+ */
+int parse_set(Token *tokens, int token_count, int *iterator);
+
 /**
  * @brief Parse a LOAD statement.
  *
@@ -161,6 +322,38 @@ int parse_delete(Token *tokens, int token_count, int *iterator);
  */
 int parse_update(Token *tokens, int token_count, int *iterator);
 
+/**
+ * @brief Parse an EXPLAIN [ANALYZE] statement. EXPLAIN prints the plan of the SELECT that follows
+ *        without running it, EXPLAIN ANALYZE runs it and prints the plan with per-operator statistics.
+ *
+ * @param tokens The array of tokens to parse.
+ * @param token_count The number of tokens.
+ * @param iterator Pointer to the current position in the token array.
+ * @return int 0 on success, -1 on failure.
+ */
+int parse_explain(Token *tokens, int token_count, int *iterator);
+
+/**
+ * @brief Parse a PREPARE name AS statement. The statement is the rest of the line,
+ *        '?' placeholders in it are bound by EXECUTE.
+ *
+ * @param tokens The array of tokens to parse.
+ * @param token_count The number of tokens.
+ * @param iterator Pointer to the current position in the token array.
+ * @return int 0 on success, -1 on failure.
+ */
+int parse_prepare(Token *tokens, int token_count, int *iterator);
+
+/**
+ * @brief Parse an EXECUTE name(values) statement and run the prepared statement with the given values.
+ *
+ * @param tokens The array of tokens to parse.
+ * @param token_count The number of tokens.
+ * @param iterator Pointer to the current position in the token array.
+ * @return int 0 on success, -1 on failure.
+ */
+int parse_execute(Token *tokens, int token_count, int *iterator);
+
 /**
  * @brief Get tables and aliases from a JOIN statement.
  *
@@ -184,27 +377,50 @@ int parse_join(Token *tokens, int token_count, int *iterator, Table **tables, ch
  * @param tables Pointer to an array of Table pointers to check conditions against.
  * @param alias Pointer to an array of strings for table aliases.
  * @param table_count The number of tables involved in the WHERE clause.
+ * @param matches List the positions of matching records are appended to, table_count positions per match.
+ * @param match_count Pointer to an integer to store the number of matching records found.
+ * @return int 0 on success, -1 on failure.
+ */
+int parse_where(Token *tokens, int token_count, int *iterator, Table **tables, char **alias, int table_count, PositionList *matches, int *match_count);
+
+/**
+ * @brief Run a query plan over the given tables, honouring the current EXPLAIN mode.
+ *
+ * @param plan The plan to run, its OperatorStats are reset and collected again.
+ * @param tables Pointer to an array of Table pointers the plan was built for.
+ * @param alias Pointer to an array of strings for table aliases.
+ * @param table_count The number of tables.
  * @param positions A 2D array to store positions of matching records.
  * @param match_count Pointer to an integer to store the number of matching records found.
  * @return int 0 on success, -1 on failure.
  */
-int parse_where(Token *tokens, int token_count, int *iterator, Table **tables, char **alias, int table_count, long positions[][table_count], int *match_count);
+int execute_query_plan(QueryPlan *plan, Table **tables, char **alias, int table_count, long positions[][table_count], int *match_count);
+
+/**
+ * @brief Plan and run a WHERE expression over the given tables, honouring the current EXPLAIN mode.
+ *
+ * @param expr The parsed WHERE expression, NULL to match every combination of rows.
+ * @param tables Pointer to an array of Table pointers to check conditions against.
+ * @param alias Pointer to an array of strings for table aliases.
+ * @param table_count The number of tables involved in the WHERE clause.
+ * @param matches List the positions of matching records are appended to, table_count positions per match.
+ * @param match_count Pointer to an integer to store the number of matching records found.
+ * @return int 0 on success, -1 on failure.
+ */
+int execute_where_expression(Expression *expr, Table **tables, char **alias, int table_count, PositionList *matches, int *match_count);
 
 /**
- * @brief Recursively perform a nested loop join on the given expression and tables to express joins and check using exression.
- * @param expr The expression to evaluate for the join.
+ * @brief Recursively perform a nested loop join in the order chosen by the plan, pruning at each depth on the conjuncts bound there.
+ * @param plan The query plan holding the join order, access paths and conjuncts, its OperatorStats are updated.
  * @param tables The array of tables to join.
  * @param alias The array of aliases for the tables.
- * @param files The array of file pointers for the tables.
+ * @param storages The opened storage of every table.
  * @param table_count The number of tables involved in the join.
  * @param rows The array of row data buffers for each table.
- * @param current_table_index The index of the current table being processed.
- * @param return_positions A 2D array to store the positions of matching records for each table.
+ * @param depth The position in the join order of the table being processed.
+ * @param return_positions A 2D array to store the positions of matching records for each table, in FROM-clause order.
  * @param match_count Pointer to an integer to count the number of matches found.
- * @param columns The array of columns for each table (optional, can be NULL).
- * @param column_alias The array of column aliases (optional, can be NULL).
- * @param column_count The number of columns in the tables (optional, can be 0).
  * @return void
  */
-void nested_loop_join(Expression *expr, Table **tables, char **alias, FILE **files, int table_count, char **rows, int current_table_index, long return_positions[][table_count], int *match_count /*, Column **columns, char **column_alias, int column_count*/);
+void nested_loop_join(QueryPlan *plan, Table **tables, char **alias, TableStorage *storages, int table_count, char **rows, int depth, long return_positions[][table_count], int *match_count /*, Column **columns, char **column_alias, int column_count*/);
 #endif // SQL_TOKENIZER_H
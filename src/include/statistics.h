@@ -0,0 +1,65 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include "globals.h"
+#include <stdint.h>
+
+#define HLL_REGISTER_BITS 6
+#define HLL_REGISTER_COUNT (1 << HLL_REGISTER_BITS)
+
+struct Table; // Forward declaration of Table struct
+
+typedef struct
+{
+    int min;                                  // smallest INT value seen
+    int max;                                  // largest INT value seen
+    int has_values;                           // 0 until the first value is added
+    unsigned char hll[HLL_REGISTER_COUNT];    // HyperLogLog registers for distinct count
+} ColumnStats;
+
+typedef struct
+{
+    ColumnStats columns[MAX_COLUMN_COUNT];
+} TableStats;
+
+/**
+ * @brief Reset the statistics of a table to the empty state.
+ *
+ * @param stats The statistics to reset.
+ */
+void init_table_stats(TableStats *stats);
+
+/**
+ * @brief Add a single column value to the statistics of the table.
+ *
+ * @param table The table the value belongs to.
+ * @param column_index The index of the column in table->columns.
+ * @param value Pointer to the value (int * for INT, char * for STRING).
+ */
+void update_column_stats(struct Table *table, int column_index, const void *value);
+
+/**
+ * @brief Add every column of a binary-form row to the statistics of the table.
+ *
+ * @param table The table the row belongs to.
+ * @param row The row data in binary format.
+ */
+void update_table_stats_from_row(struct Table *table, const char *row);
+
+/**
+ * @brief Rebuild the statistics of the table by scanning its binary file.
+ *
+ * @param table The table whose statistics are to be rebuilt.
+ * @return int 0 on success, -1 on failure.
+ */
+int rebuild_table_stats(struct Table *table);
+
+/**
+ * @brief Estimate the number of distinct values of a column.
+ *
+ * @param stats The statistics of the column.
+ * @return double The estimated distinct count, at least 1.
+ */
+double estimate_distinct_count(const ColumnStats *stats);
+
+#endif // STATISTICS_H
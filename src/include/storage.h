@@ -0,0 +1,164 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "table.h"
+#include <stdio.h>
+
+// Flags of the used_columns given to open_table_storage
+#define COLUMN_VALUES 1 // the values of the column are read
+#define COLUMN_CODES 2  // only the dictionary codes of the column are read, its values are left undecoded
+
+// VARCHAR columns longer than a slot keep a slot in the stored row: the value itself when it is at most
+// VARCHAR_INLINE_LENGTH long, otherwise its length and offset in the table's .heap file
+#define VARCHAR_SLOT_SIZE 32
+#define VARCHAR_INLINE_LENGTH (VARCHAR_SLOT_SIZE - 2)
+
+/*
+ * Row storage of a table. Records are addressed by position, row i of the table being at position
+ * i * row_size_in_bytes. A row table keeps its rows in the .bin file, a columnar table stores every column in
+ * its own .col file. Compressed tables are columnar tables whose files hold encoded values, see ColumnEncoding.
+ * VARCHAR values that do not fit their slot are kept in the .heap file of the table. Every function moves whole
+ * row images, a columnar table only reads and writes the columns it was opened with.
+ */
+typedef struct
+{
+    const Table *table;
+    FILE *file;                            // the .bin file of a row table
+    FILE *heap;                            // the .heap file, NULL when no column has a VARCHAR slot
+    FILE *column_files[MAX_COLUMN_COUNT];  // the .col file of every opened column of a columnar table, NULL for the others
+    int column_offsets[MAX_COLUMN_COUNT];  // offset of every column in the row image
+    int column_widths[MAX_COLUMN_COUNT];   // bytes of every column in the row image
+    int stored_widths[MAX_COLUMN_COUNT];   // bytes of every column on disk
+    int stored_offsets[MAX_COLUMN_COUNT];  // offset of every column in a stored row of a row table
+    int stored_row_size;                   // bytes of a stored row of a row table
+    int decode[MAX_COLUMN_COUNT];          // 0 for columns left undecoded: dictionary codes only, heap values not fetched
+    uint32_t codes[MAX_COLUMN_COUNT];      // dictionary codes of the last row read
+    int bytes_per_row;                     // bytes read from the files for one row
+    long file_pos;                         // position the files are at, -1 after a write or when unknown
+    long scan_pos;                         // position of the next row of a scan
+    long current_pos;                      // position of the first row of the last read
+    char *scratch;                         // stored values of a multi-row read or write
+    size_t scratch_size;
+} TableStorage;
+
+/**
+ * @brief Create the empty data files of a table, the .bin file or one .col file per column, and the .heap file.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int create_table_storage(const Table *table);
+
+/**
+ * @brief Get the size of the data files of a table: the .bin file or the .col files, and the .heap file.
+ *
+ * @param table The table.
+ * @return long The size in bytes, -1 if a file could not be checked.
+ */
+long table_storage_bytes(const Table *table);
+
+/**
+ * @brief Delete the data files of a table.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int remove_table_storage(const Table *table);
+
+/**
+ * @brief Open the data files of a table.
+ *
+ * @param storage The storage to initialize.
+ * @param table The table.
+ * @param mode The fopen mode, "rb" or "rb+".
+ * @param used_columns COLUMN_VALUES, COLUMN_CODES or 0 per column of the table, columnar tables only open the
+ *                     flagged columns. Read-only row tables leave the heap values of unflagged columns unfetched.
+ *                     NULL opens every column.
+ * @return int 0 on success, -1 on failure.
+ */
+int open_table_storage(TableStorage *storage, const Table *table, const char *mode, const int used_columns[]);
+
+/**
+ * @brief Close the data files of a table.
+ *
+ * @param storage The storage to close.
+ */
+void close_table_storage(TableStorage *storage);
+
+/**
+ * @brief Read consecutive rows into row images. Columns that were not opened are left untouched.
+ *
+ * @param storage The opened storage.
+ * @param pos The position of the first row.
+ * @param rows Buffer of row_count * row_size_in_bytes bytes.
+ * @param row_count The number of rows to read.
+ * @return int The number of complete rows read, 0 at the end of the table, -1 on failure.
+ */
+int read_table_rows(TableStorage *storage, long pos, char *rows, int row_count);
+
+/**
+ * @brief Write consecutive row images. A columnar table only writes the opened columns,
+ *        adding or removing rows needs every column.
+ *
+ * @param storage The storage, opened for writing.
+ * @param pos The position of the first row.
+ * @param rows The row images.
+ * @param row_count The number of rows to write.
+ * @return int 0 on success, -1 on failure.
+ */
+int write_table_rows(TableStorage *storage, long pos, const char *rows, int row_count);
+
+/**
+ * @brief Zero the stored bytes of consecutive rows, the rows are free afterwards.
+ *
+ * @param storage The storage, opened for writing with every column.
+ * @param pos The position of the first row.
+ * @param row_count The number of rows to clear.
+ * @return int 0 on success, -1 on failure.
+ */
+int clear_table_rows(TableStorage *storage, long pos, int row_count);
+
+/**
+ * @brief Restart the scan of read_next_row at the first row.
+ *
+ * @param storage The opened storage.
+ */
+void rewind_table_storage(TableStorage *storage);
+
+/**
+ * @brief Continue the scan of read_next_row at a given row.
+ *
+ * @param storage The opened storage.
+ * @param pos The position of the next row to read.
+ */
+void seek_table_storage(TableStorage *storage, long pos);
+
+/**
+ * @brief Read the next row of a scan, free rows included. Its position is left in storage->current_pos.
+ *
+ * @param storage The opened storage.
+ * @param row Buffer of row_size_in_bytes bytes.
+ * @return int 1 if a row was read, 0 at the end of the table.
+ */
+int read_next_row(TableStorage *storage, char *row);
+
+/**
+ * @brief Get the position just after the last row.
+ *
+ * @param storage The opened storage.
+ * @return long The position, -1 on failure.
+ */
+long table_storage_end(TableStorage *storage);
+
+/**
+ * @brief Cut the rows at and after a position off. The .heap file is compacted once it is more than twice the
+ *        size the remaining rows could reference, values overwritten by longer ones and the values of deleted rows
+ *        only give their space back then.
+ *
+ * @param storage The storage, opened for writing with every column.
+ * @param end The position of the first row to drop.
+ * @return int 0 on success, -1 on failure.
+ */
+int truncate_table_storage(TableStorage *storage, long end);
+
+#endif // STORAGE_H
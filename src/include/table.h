@@ -3,14 +3,19 @@
 
 #include "hashmap.h"
 #include "fnv_hash.h"
+#include "hash.h"
 #include "globals.h"
+#include "statistics.h"
+#include "encoding.h"
+#include "zonemap.h"
 #include <stdlib.h>
 #include <stdarg.h>
 
 typedef enum
 {
     INT,
-    STRING
+    STRING,
+    VARCHAR // a STRING in the row image, long values are kept in the table's overflow heap on disk
 } DataType;
 
 typedef struct
@@ -20,6 +25,13 @@ typedef struct
     int lenght; // for strings
 } Column;
 
+typedef enum
+{
+    ENGINE_ROW,       // whole rows in the .bin file
+    ENGINE_COLUMNAR,  // every column in its own .col file
+    ENGINE_COMPRESSED // every column in its own .col file, encoded as described by Table.encodings
+} StorageEngine;
+
 typedef struct Table
 {
     char table_name[MAX_NAME_LEN];
@@ -31,6 +43,12 @@ typedef struct Table
     int row_size_in_bytes;
     long free_spaces[MAX_FREE_SPACES];
     int free_spaces_count;
+    StorageEngine engine;
+    ColumnEncoding *encodings; // one per column for compressed tables, NULL for the others
+    HashKind key_hash;         // hash of the primary key in the hashmap
+    unsigned long version;     // bumped by every insert, update and delete, not persisted
+    TableStats stats; // kept in memory, rebuilt from the binary file on load
+    ZoneMap zones;    // bounds of the INT columns per block of rows, persisted in the .zonemap file
 } Table;
 
 /**
@@ -50,6 +68,24 @@ int calculate_row_size_in_bytes(const Column *columns, const int columns_count);
  */
 int create_initial_files_for_table(Table *table);
 
+/**
+ * @brief Hash an INT primary key value with the hash kind of the table.
+ *
+ * @param table The table.
+ * @param key The key value.
+ * @return uint32_t The hash value stored in the hashmap.
+ */
+uint32_t hash_int_key(const Table *table, int key);
+
+/**
+ * @brief Hash a STRING primary key value with the hash kind of the table.
+ *
+ * @param table The table.
+ * @param key The key value, null-terminated.
+ * @return uint32_t The hash value stored in the hashmap.
+ */
+uint32_t hash_str_key(const Table *table, const char *key);
+
 /**
  * @brief Create a table with the given name, columns, and primary key.
  *
@@ -57,9 +93,10 @@ int create_initial_files_for_table(Table *table);
  * @param columns The columns of the table.
  * @param columns_count The number of columns in the table.
  * @param primary_key The primary key of the table.
+ * @param engine How the rows are stored, see StorageEngine.
  * @return Table* Pointer to the created table.
  */
-Table *create_table(const char *table_name, const Column *columns, const int columns_count, const Column primary_key);
+Table *create_table(const char *table_name, const Column *columns, const int columns_count, const Column primary_key, const StorageEngine engine);
 
 /**
  * @brief Insert a record into the table.
@@ -132,7 +169,7 @@ long find_record_position(const Table *table, va_list args);
  * @param ... Primary key and The new value for the column.
  * @return int 0 on success, -1 on failure.
  */
-int update_record(const Table *table, const Column column, ...);
+int update_record(Table *table, const Column column, ...);
 
 /**
  * @brief Compare two columns by their fields.
@@ -189,6 +226,15 @@ Table *create_temp_table(const char *table_name, const Column *columns, const in
  */
 Column *get_column(const Table *table, const char *column_name);
 
+/**
+ * @brief Get the index of a column in the table by its name.
+ *
+ * @param table The table to search in.
+ * @param column_name The name of the column.
+ * @return int The index of the column in table->columns, or -1 if not found.
+ */
+int get_column_index(const Table *table, const char *column_name);
+
 /**
  * @brief Drops table, frees its memory, and deletes its files.
  *
@@ -223,6 +269,37 @@ int delete_record_by_row_position(Table *table, long pos);
  * @param pos The position of the record in the file.
  * @return int 1 if the record is free (deleted), 0 if it is not, -1 on failure.
  */
-int isfree(Table *table, long pos);
+int isfree(const Table *table, long pos);
+
+/**
+ * @brief Set columns of the records at the given positions to new values.
+ *        The positions are sorted, rows are patched in a WRITE_BUFFER_SIZE buffer at offsets computed once,
+ *        and every contiguous range of patched rows is written back with a single pwrite.
+ *        Setting the primary key is refused when it would duplicate a key, otherwise the index entry
+ *        of the record is moved to the new key in memory and rewritten in its slot of the hashmap file.
+ *
+ * @param table The table to update.
+ * @param positions The positions of the records in the file, sorted in place. Free positions are skipped.
+ * @param position_count The number of positions.
+ * @param column_indexes The indexes of the columns to set.
+ * @param values The new value of each column, int* for INT and char* for STRING columns.
+ * @param column_count The number of columns to set.
+ * @return int The number of updated records, -1 on failure.
+ */
+int update_records(Table *table, long positions[], int position_count, const int column_indexes[], void *values[], int column_count);
+
+/**
+ * @brief Delete the records at the given positions as one batch.
+ *        Rows are zeroed in a WRITE_BUFFER_SIZE buffer and written back per contiguous range, index entries are
+ *        found by position instead of by key, and the metadata and hashmap header are written once at the end.
+ *        Deleted rows at the end of the file are truncated away, the others are added to the free spaces;
+ *        when those are full the last row of the file is moved into the hole.
+ *
+ * @param table The table to delete from.
+ * @param positions The positions of the records in the file, sorted in place. Free positions are skipped.
+ * @param position_count The number of positions.
+ * @return int The number of deleted records, -1 on failure.
+ */
+int delete_records(Table *table, long positions[], int position_count);
 
 #endif
\ No newline at end of file
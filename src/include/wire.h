@@ -0,0 +1,230 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "globals.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define WIRE_BATCH_BYTES (64 << 10) // a row batch is sent once it holds this many bytes
+#define WIRE_MAX_COLUMNS MAX_COLUMN_COUNT
+
+/*
+ * Frames of the binary protocol: a kind byte, the payload length as a little-endian uint32, the payload.
+ * All numbers in payloads are little-endian.
+ *
+ * FRAME_SCHEMA  uint16 column count, then per column a WireType byte, a name length byte and the name.
+ * FRAME_BATCH   uint32 row count, then per row a null bitmap of (column count + 7) / 8 bytes, bit i set when
+ *               column i is NULL, followed by the non-NULL values: INT32 4 bytes, INT64 8 bytes, DOUBLE 8 bytes
+ *               IEEE 754, TEXT a uint16 length and the bytes.
+ * FRAME_MESSAGE the text the statements printed, errors and plans included.
+ * FRAME_END     int32 status of the request, 0 on success and -1 on failure, then the uint32 id of the batch the
+ *               response answers, 0 for a request sent as a plain line. Ends every response.
+ *
+ * A response holds a FRAME_SCHEMA and its FRAME_BATCHes per result set, then at most one FRAME_MESSAGE and
+ * the FRAME_END.
+ */
+#define FRAME_SCHEMA 'S'
+#define FRAME_BATCH 'B'
+#define FRAME_MESSAGE 'M'
+#define FRAME_END 'E'
+
+typedef enum
+{
+    PROTOCOL_TEXT,  // result rows as comma-separated text lines, every response ends with !END!
+    PROTOCOL_BINARY // every response is a sequence of frames
+} Protocol;
+
+typedef enum
+{
+    WIRE_INT32 = 1,
+    WIRE_INT64,
+    WIRE_DOUBLE,
+    WIRE_TEXT
+} WireType;
+
+/*
+ * Writes one result set in the protocol of the session. Values are given column by column, end_row closes
+ * a row. The text protocol prints them as they come, the binary protocol collects rows into batches.
+ */
+typedef struct
+{
+    FILE *out;
+    Protocol protocol;
+    int column_count;
+    WireType types[WIRE_MAX_COLUMNS];
+    long row_count;
+    int column;        // column the next value belongs to
+    char *batch;       // the frame being filled, header included
+    size_t batch_length;
+    size_t batch_capacity;
+    uint32_t batch_rows;
+    size_t row_start;  // where the null bitmap of the current row starts in batch
+    int failed;        // set when the batch could not grow or a frame could not be written
+} ResultWriter;
+
+/*
+ * Reads back a result set written in the binary protocol, one row at a time.
+ */
+typedef struct
+{
+    const char *data; // the frames
+    size_t length;
+    size_t pos; // start of the next frame
+    int column_count;
+    WireType types[WIRE_MAX_COLUMNS];
+    char names[WIRE_MAX_COLUMNS][256];
+    const char *batch; // payload of the current batch
+    size_t batch_length;
+    size_t batch_pos; // start of the next row in batch
+    uint32_t rows_left;
+    // the current row
+    int nulls[WIRE_MAX_COLUMNS];
+    long long ints[WIRE_MAX_COLUMNS];
+    double doubles[WIRE_MAX_COLUMNS];
+    size_t texts[WIRE_MAX_COLUMNS]; // offset of each TEXT value in text, null-terminated there
+    char *text;
+    size_t text_capacity;
+} ResultReader;
+
+/**
+ * @brief Select the protocol results and responses of the session are written in.
+ *
+ * @param protocol The protocol.
+ */
+void set_protocol(Protocol protocol);
+
+/**
+ * @brief Get the protocol of the session.
+ *
+ * @return Protocol The protocol.
+ */
+Protocol get_protocol();
+
+/**
+ * @brief Set the stream result sets are written to. The binary protocol sends them on the real standard
+ *        output while the messages of the statement are collected separately.
+ *
+ * @param stream The stream, NULL for stdout.
+ */
+void set_result_stream(FILE *stream);
+
+/**
+ * @brief Get the stream result sets are written to.
+ *
+ * @return FILE* The stream.
+ */
+FILE *get_result_stream();
+
+/**
+ * @brief Write one frame of the binary protocol.
+ *
+ * @param out The stream.
+ * @param kind The frame kind, one of the FRAME_ constants.
+ * @param payload The payload, can be NULL when length is 0.
+ * @param length The length of the payload.
+ * @return int 0 on success, -1 on failure.
+ */
+int write_frame(FILE *out, char kind, const void *payload, uint32_t length);
+
+/**
+ * @brief Start a result set. The binary protocol sends its schema right away.
+ *
+ * @param writer The writer to fill.
+ * @param out The stream to write to.
+ * @param column_count The number of columns, at most WIRE_MAX_COLUMNS.
+ * @param names The names of the columns.
+ * @param types The types of the columns.
+ * @return int 0 on success, -1 on failure.
+ */
+int begin_result(ResultWriter *writer, FILE *out, int column_count, const char *names[], const WireType types[]);
+
+/**
+ * @brief Add an INT32 value to the current row.
+ *
+ * @param writer The writer.
+ * @param value The value.
+ */
+void write_int32(ResultWriter *writer, int value);
+
+/**
+ * @brief Add an INT64 value to the current row.
+ *
+ * @param writer The writer.
+ * @param value The value.
+ */
+void write_int64(ResultWriter *writer, long long value);
+
+/**
+ * @brief Add a DOUBLE value to the current row.
+ *
+ * @param writer The writer.
+ * @param value The value.
+ */
+void write_double(ResultWriter *writer, double value);
+
+/**
+ * @brief Add a TEXT value to the current row.
+ *
+ * @param writer The writer.
+ * @param value The value, null-terminated.
+ */
+void write_text(ResultWriter *writer, const char *value);
+
+/**
+ * @brief Add a NULL to the current row.
+ *
+ * @param writer The writer.
+ */
+void write_null(ResultWriter *writer);
+
+/**
+ * @brief Close the current row.
+ *
+ * @param writer The writer.
+ */
+void end_row(ResultWriter *writer);
+
+/**
+ * @brief Finish a result set: send the last batch, or in the text protocol report a result without rows.
+ *
+ * @param writer The writer.
+ * @return int 0 on success, -1 if any part of the result could not be written.
+ */
+int end_result(ResultWriter *writer);
+
+/**
+ * @brief Start reading the first result set of a response in the binary protocol.
+ *
+ * @param reader The reader to fill.
+ * @param data The frames, must outlive the reader.
+ * @param length The length of the frames.
+ * @return int 1 when a result set was found, 0 when the response has none, -1 if the frames are malformed.
+ */
+int open_result(ResultReader *reader, const char *data, size_t length);
+
+/**
+ * @brief Move to the next row of the result set.
+ *
+ * @param reader The reader.
+ * @return int 1 on a row, 0 after the last row, -1 if the frames are malformed.
+ */
+int next_result_row(ResultReader *reader);
+
+/**
+ * @brief Get a TEXT value of the current row.
+ *
+ * @param reader The reader.
+ * @param column The column.
+ * @return const char* The value, valid until the next row.
+ */
+const char *result_text(const ResultReader *reader, int column);
+
+/**
+ * @brief Free the buffers of a reader.
+ *
+ * @param reader The reader.
+ */
+void close_result(ResultReader *reader);
+
+#endif // WIRE_H
@@ -0,0 +1,113 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#define ZONE_BLOCK_ROWS 4096
+
+struct Table;
+
+/*
+ * Per block of ZONE_BLOCK_ROWS consecutive row positions: the number of live rows and the smallest and largest
+ * value of every INT column among them. Bounds only ever widen while a block has live rows, so they may be loose
+ * after updates and deletes but never exclude a stored value. A block whose rows are all deleted starts over.
+ */
+typedef struct
+{
+    int block_count;
+    int capacity;
+    int *live_rows;         // per block
+    int *bounds;            // per block and column, min then max: bounds[(block * columns_count + column) * 2]
+    int dirty_from;         // first block changed since the last flush, -1 when none
+    int dirty_to;           // one past the last changed block
+    int stored_block_count; // blocks in the .zonemap file
+    int fd;                 // the .zonemap file, kept open from the first flush until the map is freed, -1 before
+} ZoneMap;
+
+/**
+ * @brief Initialize an empty zone map.
+ *
+ * @param zones The zone map.
+ */
+void init_zone_map(ZoneMap *zones);
+
+/**
+ * @brief Release the memory of a zone map, close its file and reset it to the empty state.
+ *
+ * @param zones The zone map.
+ */
+void free_zone_map(ZoneMap *zones);
+
+/**
+ * @brief Account for a row written at a free position: count it and widen the bounds of its block.
+ *
+ * @param table The table.
+ * @param pos The position of the row.
+ * @param row The row image.
+ * @return int 0 on success, -1 on failure.
+ */
+int zone_map_add_row(struct Table *table, long pos, const char *row);
+
+/**
+ * @brief Widen the bounds of the block of a live row whose values changed.
+ *
+ * @param table The table.
+ * @param pos The position of the row.
+ * @param row The row image.
+ * @param columns Flag per column, only the flagged columns of the row are valid.
+ */
+void zone_map_update_row(struct Table *table, long pos, const char *row, const int columns[]);
+
+/**
+ * @brief Account for a deleted row. A block without live rows loses its bounds.
+ *
+ * @param table The table.
+ * @param pos The position of the row.
+ */
+void zone_map_remove_row(struct Table *table, long pos);
+
+/**
+ * @brief Drop the blocks after the end of a truncated table.
+ *
+ * @param table The table.
+ * @param end The position just after the last row.
+ */
+void zone_map_truncate(struct Table *table, long end);
+
+/**
+ * @brief Get the bounds of an INT column in a block.
+ *
+ * @param table The table.
+ * @param block The block.
+ * @param column_index An INT column.
+ * @param min Set to the smallest value the block can hold.
+ * @param max Set to the largest value the block can hold.
+ * @return int 1 if the block has live rows, 0 if it has none, -1 if it lies beyond the zone map.
+ */
+int zone_bounds(const struct Table *table, int block, int column_index, int *min, int *max);
+
+/**
+ * @brief Write the entries of the blocks changed since the last flush to the .zonemap file, which stays open
+ *        for the next flush. A single-row statement writes one entry.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int flush_zone_map(struct Table *table);
+
+/**
+ * @brief Load the zone map of a table from its .zonemap file, or rebuild it from the stored rows when the
+ *        file is missing.
+ *
+ * @param table The table, its zone map initialized and empty.
+ * @return int 0 on success, -1 on failure.
+ */
+int load_zone_map(struct Table *table);
+
+/**
+ * @brief Delete the .zonemap file of a table.
+ *
+ * @param table The table.
+ * @return int 0 on success, -1 on failure.
+ */
+int remove_zone_map(const struct Table *table);
+
+#endif // ZONEMAP_H
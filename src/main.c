@@ -3,10 +3,14 @@
 #include "fnv_hash.h"
 #include "hashmap.h"
 #include "sql_tokenizer.h"
+#include "wire.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define BATCH_START "!BATCH "
+#define BATCH_END "!GO"
+
 void get_query(char *query)
 {
     printf("Query: %s\n", query);
@@ -51,6 +55,109 @@ void setup()
     get_query("SHOW TABLES;");
 }
 
+// Finish the response to a request in the protocol the session uses now, a SET PROTOCOL answers in the new one.
+// messages holds what the statements printed while the request came in the binary protocol, NULL otherwise.
+// A request sent as a batch is answered with its id, plain lines with id 0.
+static void end_response(int result, uint32_t id, const char *messages, size_t messages_length)
+{
+    if (get_protocol() == PROTOCOL_BINARY)
+    {
+        char end[8];
+        uint32_t value = (uint32_t)result;
+        for (int i = 0; i < 4; i++)
+        {
+            end[i] = (char)((value >> (8 * i)) & 0xff);
+            end[4 + i] = (char)((id >> (8 * i)) & 0xff);
+        }
+        if (messages_length > 0)
+        {
+            write_frame(stdout, FRAME_MESSAGE, messages, (uint32_t)messages_length);
+        }
+        write_frame(stdout, FRAME_END, end, sizeof(end));
+    }
+    else
+    {
+        if (messages_length > 0)
+        {
+            fwrite(messages, 1, messages_length, stdout);
+        }
+        // Notify end of result block
+        if (id != 0)
+        {
+            printf("!END! %u\n", id);
+        }
+        else
+        {
+            printf("!END!\n");
+        }
+    }
+    fflush(stdout);
+}
+
+// Collect the lines of a batch up to its BATCH_END line into batch, joined by newlines so that statements can
+// span lines. A batch cut short by the end of input keeps what arrived.
+static int read_batch(char **line, size_t *line_capacity, char **batch, size_t *batch_capacity)
+{
+    size_t length = 0;
+    (*batch)[0] = '\0';
+    while (getline(line, line_capacity, stdin) != -1)
+    {
+        (*line)[strcspn(*line, "\n")] = 0;
+        if (strcmp(*line, BATCH_END) == 0)
+        {
+            return 0;
+        }
+        size_t line_length = strlen(*line);
+        if (length + line_length + 2 > *batch_capacity)
+        {
+            size_t capacity = *batch_capacity * 2;
+            while (length + line_length + 2 > capacity)
+            {
+                capacity *= 2;
+            }
+            char *grown = realloc(*batch, capacity);
+            if (!grown)
+            {
+                perror("Failed to grow batch buffer");
+                return -1;
+            }
+            *batch = grown;
+            *batch_capacity = capacity;
+        }
+        memcpy(*batch + length, *line, line_length);
+        length += line_length;
+        (*batch)[length++] = '\n';
+        (*batch)[length] = '\0';
+    }
+    return 0;
+}
+
+// Run the statements of a batch one at a time, a failing statement does not stop the ones after it
+static int run_batch(TokenVector *tokens)
+{
+    int result = 0;
+    int start = 0;
+    while (tokens->tokens[start].type != TOKEN_EOF)
+    {
+        int end = start;
+        while (tokens->tokens[end].type != TOKEN_SEMICOLON && tokens->tokens[end].type != TOKEN_EOF)
+        {
+            end++;
+        }
+        if (tokens->tokens[end].type == TOKEN_SEMICOLON)
+        {
+            end++;
+        }
+        if (parser(tokens->tokens + start, end - start) == -1)
+        {
+            printf("Error: Could not parse query.\n");
+            result = -1;
+        }
+        start = end;
+    }
+    return result;
+}
+
 int main()
 {
     // Initialization (optional for testing)
@@ -58,9 +165,22 @@ int main()
 
     // setup(); // Uncomment to run the setup queries
 
-    char query[2048]; // Enough for a single SQL line
+    // The line buffer and the token vector are reused, so a query only allocates when it is longer than any before
+    char *query = NULL;
+    size_t query_capacity = 0;
+    TokenVector tokens = {NULL, 0, 0};
+    size_t batch_capacity = 4096;
+    char *batch = malloc(batch_capacity);
+    if (!batch)
+    {
+        perror("Failed to allocate batch buffer");
+        return 1;
+    }
 
-    while (fgets(query, sizeof(query), stdin))
+    // A request is one line, or a batch: a BATCH_START line with the request id, any number of lines holding
+    // ';'-separated statements, and a BATCH_END line. Clients may send the next request before the answer
+    // to the last one arrives, answers come in order and carry the id of their batch.
+    while (getline(&query, &query_capacity, stdin) != -1)
     {
         // Remove trailing newline (for compatibility)
         query[strcspn(query, "\n")] = 0;
@@ -69,27 +189,63 @@ int main()
         if (strlen(query) == 0)
             continue;
 
-        // Tokenize and parse
-        int token_count = 0;
-        Token *tokens = tokenize(query, &token_count);
-        if (!tokens)
+        const char *sql = query;
+        uint32_t id = 0;
+        int is_batch = strncmp(query, BATCH_START, strlen(BATCH_START)) == 0;
+        if (is_batch)
         {
-            printf("!END!\n");
-            fflush(stdout);
-            continue;
+            char *end;
+            unsigned long value = strtoul(query + strlen(BATCH_START), &end, 10);
+            id = value <= UINT32_MAX ? (uint32_t)value : 0;
+            if (read_batch(&query, &query_capacity, &batch, &batch_capacity) != 0)
+            {
+                break;
+            }
+            sql = batch;
         }
 
-        if (parser(tokens, token_count) == -1)
+        // In the binary protocol result sets go out as frames while everything the statements print is
+        // collected and sent as one message frame, so stdout is pointed at a buffer for the request
+        FILE *terminal = stdout;
+        char *messages = NULL;
+        size_t messages_length = 0;
+        if (get_protocol() == PROTOCOL_BINARY)
         {
-            printf("Error: Could not parse query.\n");
+            FILE *collected = open_memstream(&messages, &messages_length);
+            if (collected)
+            {
+                stdout = collected;
+                set_result_stream(terminal);
+            }
         }
 
-        free(tokens);
+        // Tokenize and parse
+        int result = -1;
+        if (is_batch && id == 0)
+        {
+            printf("Error: Batch needs a request id greater than 0\n");
+        }
+        else if (tokenize_into(sql, &tokens) == 0)
+        {
+            result = is_batch ? run_batch(&tokens) : parser(tokens.tokens, tokens.count);
+            if (result == -1 && !is_batch)
+            {
+                printf("Error: Could not parse query.\n");
+            }
+        }
 
-        // Notify end of result block
-        printf("!END!\n");
-        fflush(stdout);
+        if (stdout != terminal)
+        {
+            fclose(stdout);
+            stdout = terminal;
+            set_result_stream(NULL);
+        }
+        end_response(result, id, messages, messages_length);
+        free(messages);
     }
 
+    free_token_vector(&tokens);
+    free(batch);
+    free(query);
     return 0;
 }
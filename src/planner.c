@@ -0,0 +1,899 @@
+#include "planner.h"
+#include "storage.h"
+#include "aggregate.h"
+#include "sort.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static ExplainMode explain_mode = EXPLAIN_NONE;
+
+void set_explain_mode(ExplainMode mode)
+{
+    explain_mode = mode;
+}
+
+ExplainMode get_explain_mode()
+{
+    return explain_mode;
+}
+
+double get_time_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int resolve_column(Expression *expr, Table *tables[], char *alias[], int table_count, int *column_index)
+{
+    if (expr->type == EXPR_ALIAS_COLUMN)
+    {
+        for (int i = 0; i < table_count; i++)
+        {
+            if (strcmp(alias[i], expr->alias_column.alias) == 0)
+            {
+                *column_index = get_column_index(tables[i], expr->alias_column.column_name);
+                return *column_index == -1 ? -1 : i;
+            }
+        }
+        return -1; // Unknown alias
+    }
+
+    int found = -1;
+    for (int i = 0; i < table_count; i++)
+    {
+        int index = get_column_index(tables[i], expr->column_name);
+        if (index != -1)
+        {
+            if (found != -1)
+            {
+                return -2; // Ambiguous column
+            }
+            found = i;
+            *column_index = index;
+        }
+    }
+    return found;
+}
+
+int resolve_named_column(Table *tables[], char *alias[], int table_count, char *column_alias, char *name, int *column_index)
+{
+    Expression column;
+    if (strcmp(column_alias, name) == 0)
+    {
+        column.type = EXPR_COLUMN;
+        column.column_name = name;
+    }
+    else
+    {
+        column.type = EXPR_ALIAS_COLUMN;
+        column.alias_column.alias = column_alias;
+        column.alias_column.column_name = name;
+    }
+    return resolve_column(&column, tables, alias, table_count, column_index);
+}
+
+static unsigned int referenced_tables(Expression *expr, Table *tables[], char *alias[], int table_count)
+{
+    if (!expr)
+    {
+        return 0;
+    }
+    switch (expr->type)
+    {
+    case EXPR_LITERAL:
+        return 0;
+    case EXPR_COLUMN:
+    case EXPR_ALIAS_COLUMN:
+    {
+        int column_index;
+        int table_index = resolve_column(expr, tables, alias, table_count, &column_index);
+        if (table_index >= 0)
+        {
+            return 1U << table_index;
+        }
+        if (table_index == -2)
+        {
+            // Ambiguous columns depend on every table having them, evaluation reports the error
+            unsigned int mask = 0;
+            for (int i = 0; i < table_count; i++)
+            {
+                if (get_column_index(tables[i], expr->column_name) != -1)
+                {
+                    mask |= 1U << i;
+                }
+            }
+            return mask;
+        }
+        return 0;
+    }
+    case EXPR_BINARY:
+        return referenced_tables(expr->binary.left, tables, alias, table_count) |
+               referenced_tables(expr->binary.right, tables, alias, table_count);
+    case EXPR_UNARY:
+        return referenced_tables(expr->unary.child, tables, alias, table_count);
+    }
+    return 0;
+}
+
+void mark_used_columns(QueryPlan *plan, Expression *expr, Table *tables[], char *alias[], int table_count)
+{
+    if (!expr)
+    {
+        return;
+    }
+    switch (expr->type)
+    {
+    case EXPR_LITERAL:
+        break;
+    case EXPR_COLUMN:
+    case EXPR_ALIAS_COLUMN:
+    {
+        int column_index;
+        int table_index = resolve_column(expr, tables, alias, table_count, &column_index);
+        if (table_index >= 0)
+        {
+            plan->used_columns[table_index][column_index] = COLUMN_VALUES;
+        }
+        else if (table_index == -2)
+        {
+            for (int i = 0; i < table_count; i++)
+            {
+                int index = get_column_index(tables[i], expr->column_name);
+                if (index != -1)
+                {
+                    plan->used_columns[i][index] = COLUMN_VALUES;
+                }
+            }
+        }
+        break;
+    }
+    case EXPR_BINARY:
+        mark_used_columns(plan, expr->binary.left, tables, alias, table_count);
+        mark_used_columns(plan, expr->binary.right, tables, alias, table_count);
+        break;
+    case EXPR_UNARY:
+        mark_used_columns(plan, expr->unary.child, tables, alias, table_count);
+        break;
+    }
+}
+
+static int count_conjuncts(Expression *expr)
+{
+    if (expr->type == EXPR_BINARY && expr->binary.op == OP_AND)
+    {
+        return count_conjuncts(expr->binary.left) + count_conjuncts(expr->binary.right);
+    }
+    return 1;
+}
+
+static void split_conjuncts(QueryPlan *plan, Expression *expr)
+{
+    if (expr->type == EXPR_BINARY && expr->binary.op == OP_AND)
+    {
+        split_conjuncts(plan, expr->binary.left);
+        split_conjuncts(plan, expr->binary.right);
+        return;
+    }
+    plan->conjuncts[plan->conjunct_count++].expr = expr;
+}
+
+static int is_comparison(Operator op)
+{
+    return op == OP_EQ || op == OP_NE || op == OP_LT || op == OP_LE || op == OP_GT || op == OP_GE;
+}
+
+static Operator mirror_operator(Operator op)
+{
+    switch (op)
+    {
+    case OP_LT:
+        return OP_GT;
+    case OP_LE:
+        return OP_GE;
+    case OP_GT:
+        return OP_LT;
+    case OP_GE:
+        return OP_LE;
+    default:
+        return op;
+    }
+}
+
+static double clamp_selectivity(double selectivity)
+{
+    if (selectivity < 0.0)
+        return 0.0;
+    if (selectivity > 1.0)
+        return 1.0;
+    return selectivity;
+}
+
+static double comparison_selectivity(Expression *expr, Table *tables[], char *alias[], int table_count)
+{
+    Expression *left = expr->binary.left;
+    Expression *right = expr->binary.right;
+    Operator op = expr->binary.op;
+
+    if (left->type == EXPR_LITERAL && right->type != EXPR_LITERAL)
+    {
+        Expression *tmp = left;
+        left = right;
+        right = tmp;
+        op = mirror_operator(op);
+    }
+    if (left->type != EXPR_COLUMN && left->type != EXPR_ALIAS_COLUMN)
+    {
+        return DEFAULT_SELECTIVITY;
+    }
+
+    int left_column;
+    int left_table = resolve_column(left, tables, alias, table_count, &left_column);
+    if (left_table < 0)
+    {
+        return DEFAULT_SELECTIVITY;
+    }
+    const ColumnStats *left_stats = &tables[left_table]->stats.columns[left_column];
+    if (!left_stats->has_values)
+    {
+        return DEFAULT_SELECTIVITY;
+    }
+    double left_distinct = estimate_distinct_count(left_stats);
+
+    // Join predicate between two columns
+    if (right->type == EXPR_COLUMN || right->type == EXPR_ALIAS_COLUMN)
+    {
+        int right_column;
+        int right_table = resolve_column(right, tables, alias, table_count, &right_column);
+        if (op != OP_EQ || right_table < 0 || right_table == left_table)
+        {
+            return DEFAULT_SELECTIVITY;
+        }
+        double right_distinct = estimate_distinct_count(&tables[right_table]->stats.columns[right_column]);
+        return 1.0 / (left_distinct > right_distinct ? left_distinct : right_distinct);
+    }
+    if (right->type != EXPR_LITERAL)
+    {
+        return DEFAULT_SELECTIVITY;
+    }
+
+    switch (op)
+    {
+    case OP_EQ:
+        return 1.0 / left_distinct;
+    case OP_NE:
+        return 1.0 - 1.0 / left_distinct;
+    default:
+        break;
+    }
+
+    if (tables[left_table]->columns[left_column].type != INT || right->literal.is_string || right->literal.parameter >= 0)
+    {
+        return DEFAULT_SELECTIVITY;
+    }
+
+    // Range predicate, interpolate the literal between min and max assuming a uniform distribution
+    double value = atoi(right->literal.value);
+    double below = (value - left_stats->min) / ((double)left_stats->max - left_stats->min + 1.0);
+    double equal = 1.0 / left_distinct;
+    switch (op)
+    {
+    case OP_LT:
+        return clamp_selectivity(below);
+    case OP_LE:
+        return clamp_selectivity(below + equal);
+    case OP_GT:
+        return clamp_selectivity(1.0 - below - equal);
+    case OP_GE:
+        return clamp_selectivity(1.0 - below);
+    default:
+        return DEFAULT_SELECTIVITY;
+    }
+}
+
+static double estimate_selectivity(Expression *expr, Table *tables[], char *alias[], int table_count)
+{
+    switch (expr->type)
+    {
+    case EXPR_BINARY:
+        if (is_comparison(expr->binary.op))
+        {
+            return comparison_selectivity(expr, tables, alias, table_count);
+        }
+        if (expr->binary.op == OP_AND)
+        {
+            return estimate_selectivity(expr->binary.left, tables, alias, table_count) *
+                   estimate_selectivity(expr->binary.right, tables, alias, table_count);
+        }
+        if (expr->binary.op == OP_OR)
+        {
+            double a = estimate_selectivity(expr->binary.left, tables, alias, table_count);
+            double b = estimate_selectivity(expr->binary.right, tables, alias, table_count);
+            return a + b - a * b;
+        }
+        return DEFAULT_SELECTIVITY;
+    case EXPR_UNARY:
+        return 1.0 - estimate_selectivity(expr->unary.child, tables, alias, table_count);
+    default:
+        return DEFAULT_SELECTIVITY;
+    }
+}
+
+// Detect `pk = value` where pk is the INT primary key of a table and value does not depend on that table
+static void detect_key_equality(Conjunct *c, Table *tables[], char *alias[], int table_count)
+{
+    c->key_table = -1;
+    c->key_expr = NULL;
+    c->key_tables = 0;
+    if (c->expr->type != EXPR_BINARY || c->expr->binary.op != OP_EQ)
+    {
+        return;
+    }
+
+    Expression *sides[2] = {c->expr->binary.left, c->expr->binary.right};
+    for (int s = 0; s < 2; s++)
+    {
+        Expression *column = sides[s];
+        Expression *other = sides[1 - s];
+        if (column->type != EXPR_COLUMN && column->type != EXPR_ALIAS_COLUMN)
+        {
+            continue;
+        }
+        int column_index;
+        int t = resolve_column(column, tables, alias, table_count, &column_index);
+        if (t < 0 || tables[t]->primary_key.type != INT ||
+            strcmp(tables[t]->columns[column_index].name, tables[t]->primary_key.name) != 0)
+        {
+            continue;
+        }
+        if (other->type == EXPR_LITERAL && other->literal.is_string)
+        {
+            continue;
+        }
+        if (other->type == EXPR_COLUMN || other->type == EXPR_ALIAS_COLUMN)
+        {
+            int other_column;
+            int other_table = resolve_column(other, tables, alias, table_count, &other_column);
+            if (other_table < 0 || tables[other_table]->columns[other_column].type != INT)
+            {
+                continue;
+            }
+        }
+        unsigned int other_tables = referenced_tables(other, tables, alias, table_count);
+        if (other_tables & (1U << t))
+        {
+            continue;
+        }
+        c->key_table = t;
+        c->key_expr = other;
+        c->key_tables = other_tables;
+        return;
+    }
+}
+
+static Expression *literal_side(const Expression *expr)
+{
+    if (expr->binary.right->type == EXPR_LITERAL)
+    {
+        return expr->binary.right;
+    }
+    return expr->binary.left->type == EXPR_LITERAL ? expr->binary.left : NULL;
+}
+
+// Detect `column = 'value'` and `column <> 'value'` on a dictionary encoded column, those compare the code of
+// the stored value with the code of the literal and leave the column undecoded
+static void detect_code_comparison(Conjunct *c, Table *tables[], char *alias[], int table_count)
+{
+    c->code_table = -1;
+    c->code_column = -1;
+    if (c->expr->type != EXPR_BINARY || (c->expr->binary.op != OP_EQ && c->expr->binary.op != OP_NE))
+    {
+        return;
+    }
+    Expression *literal = literal_side(c->expr);
+    Expression *column = literal == c->expr->binary.left ? c->expr->binary.right : c->expr->binary.left;
+    if (!literal || (column->type != EXPR_COLUMN && column->type != EXPR_ALIAS_COLUMN))
+    {
+        return;
+    }
+    // Constants must be strings, parameters are checked once bound
+    if (literal->literal.parameter < 0 && !literal->literal.is_string)
+    {
+        return;
+    }
+    int column_index;
+    int t = resolve_column(column, tables, alias, table_count, &column_index);
+    if (t < 0 || !tables[t]->encodings || tables[t]->encodings[column_index].type != ENCODING_DICTIONARY)
+    {
+        return;
+    }
+    c->code_table = t;
+    c->code_column = column_index;
+}
+
+// Detect `column op number` on an INT column with op one of =, <, <=, >, >=, the zone map of the table can rule
+// out whole blocks of rows for those
+static void detect_zone_comparison(Conjunct *c, Table *tables[], char *alias[], int table_count)
+{
+    c->zone_table = -1;
+    c->zone_column = -1;
+    if (c->expr->type != EXPR_BINARY || c->expr->binary.op == OP_NE || !is_comparison(c->expr->binary.op))
+    {
+        return;
+    }
+    Expression *literal = literal_side(c->expr);
+    Expression *column = literal == c->expr->binary.left ? c->expr->binary.right : c->expr->binary.left;
+    if (!literal || (column->type != EXPR_COLUMN && column->type != EXPR_ALIAS_COLUMN))
+    {
+        return;
+    }
+    if (literal->literal.parameter < 0 && literal->literal.is_string)
+    {
+        return;
+    }
+    int column_index;
+    int t = resolve_column(column, tables, alias, table_count, &column_index);
+    if (t < 0 || tables[t]->columns[column_index].type != INT)
+    {
+        return;
+    }
+    c->zone_table = t;
+    c->zone_column = column_index;
+    c->zone_op = literal == c->expr->binary.left ? mirror_operator(c->expr->binary.op) : c->expr->binary.op;
+}
+
+// Conjunct that allows probing the primary key index of table t once the tables in bound are joined
+static int find_key_conjunct(const QueryPlan *plan, int t, unsigned int bound)
+{
+    for (int i = 0; i < plan->conjunct_count; i++)
+    {
+        const Conjunct *c = &plan->conjuncts[i];
+        if (c->key_table == t && (c->key_tables & ~bound) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int compare_conjuncts(const void *a, const void *b)
+{
+    const Conjunct *ca = (const Conjunct *)a;
+    const Conjunct *cb = (const Conjunct *)b;
+    if (ca->depth != cb->depth)
+        return ca->depth - cb->depth;
+    if (ca->selectivity < cb->selectivity)
+        return -1;
+    if (ca->selectivity > cb->selectivity)
+        return 1;
+    return 0;
+}
+
+static int bit_count(unsigned int mask)
+{
+    int count = 0;
+    while (mask)
+    {
+        mask &= mask - 1;
+        count++;
+    }
+    return count;
+}
+
+// Estimated number of row combinations surviving a join of the tables in the subset
+static double subset_cardinality(const QueryPlan *plan, unsigned int subset)
+{
+    double cardinality = 1.0;
+    for (int i = 0; i < plan->table_count; i++)
+    {
+        if (subset & (1U << i))
+        {
+            cardinality *= plan->estimated_rows[i];
+        }
+    }
+    for (int i = 0; i < plan->conjunct_count; i++)
+    {
+        const Conjunct *c = &plan->conjuncts[i];
+        if (bit_count(c->tables) > 1 && (c->tables & ~subset) == 0)
+        {
+            cardinality *= c->selectivity;
+        }
+    }
+    return cardinality;
+}
+
+int build_query_plan(QueryPlan *plan, Expression *expr, Table *tables[], char *alias[], int table_count)
+{
+    if (table_count <= 0 || table_count > MAX_JOIN_COUNT)
+    {
+        printf("Error: Invalid number of tables for plan: %d\n", table_count);
+        return -1;
+    }
+    memset(plan, 0, sizeof(QueryPlan));
+    plan->table_count = table_count;
+    plan->row_limit = -1;
+
+    if (expr)
+    {
+        if (count_conjuncts(expr) > MAX_CONJUNCT_COUNT)
+        {
+            plan->conjuncts[plan->conjunct_count++].expr = expr; // Too many to split, evaluate as a whole
+        }
+        else
+        {
+            split_conjuncts(plan, expr);
+        }
+    }
+
+    for (int i = 0; i < table_count; i++)
+    {
+        plan->estimated_rows[i] = tables[i]->record_size;
+    }
+
+    // Single-table conjuncts filter their table before it is joined
+    for (int i = 0; i < plan->conjunct_count; i++)
+    {
+        Conjunct *c = &plan->conjuncts[i];
+        c->tables = referenced_tables(c->expr, tables, alias, table_count);
+        c->selectivity = estimate_selectivity(c->expr, tables, alias, table_count);
+        detect_key_equality(c, tables, alias, table_count);
+        detect_code_comparison(c, tables, alias, table_count);
+        detect_zone_comparison(c, tables, alias, table_count);
+        if (c->code_table < 0)
+        {
+            mark_used_columns(plan, c->expr, tables, alias, table_count);
+        }
+        if (bit_count(c->tables) == 1)
+        {
+            for (int t = 0; t < table_count; t++)
+            {
+                if (c->tables == 1U << t)
+                {
+                    plan->estimated_rows[t] *= c->selectivity;
+                }
+            }
+        }
+    }
+    // Columns only compared on their codes are read without decoding
+    for (int i = 0; i < plan->conjunct_count; i++)
+    {
+        const Conjunct *c = &plan->conjuncts[i];
+        if (c->code_table >= 0 && !plan->used_columns[c->code_table][c->code_column])
+        {
+            plan->used_columns[c->code_table][c->code_column] = COLUMN_CODES;
+        }
+    }
+
+    // Left-deep join order by dynamic programming over table subsets.
+    // Cost of a nested loop join is the rows read: every inner table is scanned once per outer combination,
+    // or probed once through its primary key index when an equality on the key is bound.
+    unsigned int full = (1U << table_count) - 1;
+    double cost[1 << MAX_JOIN_COUNT];
+    int last[1 << MAX_JOIN_COUNT];
+    for (unsigned int s = 0; s <= full; s++)
+    {
+        cost[s] = HUGE_VAL;
+        last[s] = -1;
+    }
+    for (int t = 0; t < table_count; t++)
+    {
+        cost[1U << t] = find_key_conjunct(plan, t, 0) != -1 ? 1.0 : tables[t]->record_size;
+        last[1U << t] = t;
+    }
+    for (unsigned int s = 1; s <= full; s++)
+    {
+        if (cost[s] == HUGE_VAL)
+        {
+            continue;
+        }
+        double cardinality = subset_cardinality(plan, s);
+        for (int t = 0; t < table_count; t++)
+        {
+            unsigned int next = s | (1U << t);
+            if (next == s)
+            {
+                continue;
+            }
+            double access_cost = find_key_conjunct(plan, t, s) != -1 ? 1.0 : tables[t]->record_size;
+            double next_cost = cost[s] + cardinality * access_cost;
+            if (next_cost < cost[next])
+            {
+                cost[next] = next_cost;
+                last[next] = t;
+            }
+        }
+    }
+
+    unsigned int subset = full;
+    for (int depth = table_count - 1; depth >= 0; depth--)
+    {
+        plan->order[depth] = last[subset];
+        subset &= ~(1U << last[subset]);
+    }
+    plan->estimated_cost = cost[full];
+
+    unsigned int bound = 0;
+    for (int depth = 0; depth < table_count; depth++)
+    {
+        int t = plan->order[depth];
+        int key = find_key_conjunct(plan, t, bound);
+        plan->access[t].method = key != -1 ? ACCESS_HASH_LOOKUP : ACCESS_SCAN;
+        plan->access[t].key = key != -1 ? plan->conjuncts[key].key_expr : NULL;
+        bound |= 1U << t;
+    }
+
+    // Every conjunct is evaluated at the shallowest depth where all the tables it references are bound.
+    // Conjuncts without column references are checked on the outermost table.
+    for (int i = 0; i < plan->conjunct_count; i++)
+    {
+        Conjunct *c = &plan->conjuncts[i];
+        c->depth = 0;
+        for (int depth = 0; depth < table_count; depth++)
+        {
+            if (c->tables & (1U << plan->order[depth]))
+            {
+                c->depth = depth;
+            }
+        }
+    }
+
+    // Group the conjuncts by depth, most selective first so failing rows are rejected early
+    qsort(plan->conjuncts, plan->conjunct_count, sizeof(Conjunct), compare_conjuncts);
+    int next = 0;
+    for (int depth = 0; depth <= table_count; depth++)
+    {
+        while (next < plan->conjunct_count && plan->conjuncts[next].depth < depth)
+        {
+            next++;
+        }
+        plan->depth_start[depth] = next;
+    }
+    plan->depth_start[table_count] = plan->conjunct_count;
+    return 0;
+}
+
+int evaluate_conjuncts_at_depth(const QueryPlan *plan, int depth, Table *tables[], char *alias[], char *rows[], int table_count)
+{
+    for (int i = plan->depth_start[depth]; i < plan->depth_start[depth + 1]; i++)
+    {
+        if (plan->conjuncts[i].code_table < 0 && !evaluate_expression(plan->conjuncts[i].expr, tables, alias, rows, table_count))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int evaluate_code_conjuncts_at_depth(const QueryPlan *plan, int depth, const uint32_t codes[])
+{
+    for (int i = plan->depth_start[depth]; i < plan->depth_start[depth + 1]; i++)
+    {
+        const Conjunct *c = &plan->conjuncts[i];
+        if (c->code_table < 0)
+        {
+            continue;
+        }
+        // A code of -1 is a string missing from the dictionary, -2 a literal that is not a string
+        int equal = c->code >= 0 && codes[c->code_column] == (uint32_t)c->code;
+        if (c->expr->binary.op == OP_EQ ? !equal : c->code == -2 || equal)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int block_may_match(const QueryPlan *plan, int depth, const Table *table, int block)
+{
+    int min, max;
+    int live = zone_bounds(table, block, 0, &min, &max);
+    if (live <= 0)
+    {
+        return live < 0; // Rows past the zone map are read, blocks without live rows never are
+    }
+    for (int i = plan->depth_start[depth]; i < plan->depth_start[depth + 1]; i++)
+    {
+        const Conjunct *c = &plan->conjuncts[i];
+        if (c->zone_table < 0 || !c->zone_usable)
+        {
+            continue;
+        }
+        zone_bounds(table, block, c->zone_column, &min, &max);
+        int x = c->zone_value;
+        switch (c->zone_op)
+        {
+        case OP_EQ:
+            if (x < min || x > max)
+                return 0;
+            break;
+        case OP_LT:
+            if (min >= x)
+                return 0;
+            break;
+        case OP_LE:
+            if (min > x)
+                return 0;
+            break;
+        case OP_GT:
+            if (max <= x)
+                return 0;
+            break;
+        case OP_GE:
+            if (max < x)
+                return 0;
+            break;
+        default:
+            break;
+        }
+    }
+    return 1;
+}
+
+void resolve_conjunct_literals(QueryPlan *plan, Table *tables[])
+{
+    for (int i = 0; i < plan->conjunct_count; i++)
+    {
+        Conjunct *c = &plan->conjuncts[i];
+        if (c->zone_table >= 0)
+        {
+            const Expression *literal = literal_side(c->expr);
+            c->zone_usable = !literal->literal.is_string;
+            c->zone_value = c->zone_usable ? atoi(literal->literal.value) : 0;
+        }
+        if (c->code_table < 0)
+        {
+            continue;
+        }
+        const Expression *literal = literal_side(c->expr);
+        c->code = literal->literal.is_string
+                      ? dictionary_find(&tables[c->code_table]->encodings[c->code_column].dictionary, literal->literal.value)
+                      : -2;
+    }
+}
+
+static void print_table_reference(Table *table, const char *alias)
+{
+    printf("%s", table->table_name);
+    if (strcmp(table->table_name, alias) != 0)
+    {
+        printf(" %s", alias);
+    }
+}
+
+int is_index_only_count(const QueryPlan *plan)
+{
+    if (!plan->aggregate || plan->table_count != 1 || !is_count_only(plan->aggregate))
+    {
+        return 0;
+    }
+    // The only conjunct allowed is the primary key equality the hash lookup answers by itself
+    return plan->conjunct_count == 0 || (plan->conjunct_count == 1 && plan->access[0].method == ACCESS_HASH_LOOKUP);
+}
+
+void print_query_plan(const QueryPlan *plan, Table *tables[], char *alias[])
+{
+    int index_only = is_index_only_count(plan);
+    printf("Join order: ");
+    for (int depth = 0; depth < plan->table_count; depth++)
+    {
+        if (depth > 0)
+            printf(" -> ");
+        print_table_reference(tables[plan->order[depth]], alias[plan->order[depth]]);
+    }
+    printf("\n");
+    printf("Estimated rows read: %.1f\n", plan->estimated_cost);
+
+    for (int depth = 0; depth < plan->table_count; depth++)
+    {
+        int t = plan->order[depth];
+        printf("%*s", depth * 2, "");
+        if (depth > 0)
+        {
+            printf("-> %s: ", plan->access[t].method == ACCESS_HASH_LOOKUP ? "Index Nested Loop Join" : "Nested Loop Join");
+        }
+        if (index_only)
+        {
+            printf("Index Only Count on ");
+            print_table_reference(tables[t], alias[t]);
+            if (plan->access[t].method == ACCESS_HASH_LOOKUP)
+            {
+                printf(" using %s = ", tables[t]->primary_key.name);
+                print_expression(plan->access[t].key);
+            }
+            else
+            {
+                printf(" using row count");
+            }
+        }
+        else if (plan->access[t].method == ACCESS_HASH_LOOKUP)
+        {
+            printf("Hash Lookup on ");
+            print_table_reference(tables[t], alias[t]);
+            printf(" using %s = ", tables[t]->primary_key.name);
+            print_expression(plan->access[t].key);
+        }
+        else if (tables[t]->engine != ENGINE_ROW)
+        {
+            printf("%s Scan on ", tables[t]->engine == ENGINE_COLUMNAR ? "Columnar" : "Compressed");
+            print_table_reference(tables[t], alias[t]);
+            printf(" reading");
+            int any = 0;
+            for (int c = 0; c < tables[t]->columns_count; c++)
+            {
+                if (plan->used_columns[t][c])
+                {
+                    printf("%s %s%s", any ? "," : "", tables[t]->columns[c].name,
+                           plan->used_columns[t][c] == COLUMN_CODES ? " (codes)" : "");
+                    any = 1;
+                }
+            }
+            if (!any)
+            {
+                printf(" no columns");
+            }
+        }
+        else
+        {
+            printf("Seq Scan on ");
+            print_table_reference(tables[t], alias[t]);
+        }
+        printf(" (estimated rows: %.1f)\n", plan->estimated_rows[t]);
+
+        for (int i = plan->depth_start[depth]; i < plan->depth_start[depth + 1] && !index_only; i++)
+        {
+            printf("%*s  Filter: ", depth * 2, "");
+            print_expression(plan->conjuncts[i].expr);
+            if (plan->conjuncts[i].code_table >= 0)
+            {
+                printf(" (on dictionary codes)");
+            }
+            else if (plan->conjuncts[i].zone_table >= 0 && plan->access[t].method == ACCESS_SCAN)
+            {
+                printf(" (zone map)");
+            }
+            printf("\n");
+        }
+        if (plan->analyze)
+        {
+            const OperatorStats *s = &plan->stats[depth];
+            printf("%*s  Actual: loops=%ld rows read=%ld rows out=%ld bytes read=%ld index probes=%ld blocks skipped=%ld time=%.3f ms\n",
+                   depth * 2, "", s->loops, s->rows_read, s->rows_out, s->bytes_read, s->index_probes, s->blocks_skipped,
+                   s->time_ms);
+        }
+    }
+    if (plan->aggregate)
+    {
+        printf("Hash Aggregate on %d group columns", plan->aggregate->query->group_count);
+        if (plan->analyze)
+        {
+            printf(" (groups: %d)", plan->aggregate->group_count);
+        }
+        printf("\n");
+    }
+    if (plan->sorter)
+    {
+        if (plan->sorter->limit >= 0)
+        {
+            printf("Top-N Sort on %d columns (limit: %ld)", plan->sorter->query->order_count, plan->sorter->limit);
+        }
+        else
+        {
+            printf("Sort on %d columns", plan->sorter->query->order_count);
+        }
+        if (plan->analyze)
+        {
+            printf(" (runs spilled: %d)", plan->sorter->spilled_runs);
+        }
+        printf("\n");
+    }
+    if (plan->row_limit >= 0)
+    {
+        printf("Limit: stop after %ld rows\n", plan->row_limit);
+    }
+    if (plan->analyze)
+    {
+        printf("Execution: %d matching rows in %.3f ms\n", plan->match_count, plan->total_time_ms);
+    }
+}
@@ -0,0 +1,312 @@
+#include "prepared.h"
+#include "expression.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static PreparedStatement *prepared_statements[MAX_PREPARED_COUNT];
+static int prepared_count = 0;
+
+static void collect_parameter_nodes(PreparedStatement *stmt, Expression *expr)
+{
+    if (expr == NULL)
+    {
+        return;
+    }
+    switch (expr->type)
+    {
+    case EXPR_LITERAL:
+        if (expr->literal.parameter >= 0)
+        {
+            stmt->parameter_nodes[expr->literal.parameter] = expr;
+        }
+        break;
+    case EXPR_BINARY:
+        collect_parameter_nodes(stmt, expr->binary.left);
+        collect_parameter_nodes(stmt, expr->binary.right);
+        break;
+    case EXPR_UNARY:
+        collect_parameter_nodes(stmt, expr->unary.child);
+        break;
+    default:
+        break;
+    }
+}
+
+static void release_resolution(PreparedStatement *stmt)
+{
+    if (stmt->kind == PREPARED_SELECT)
+    {
+        free_select_query(&stmt->select);
+    }
+    memset(stmt->parameter_nodes, 0, sizeof(stmt->parameter_nodes));
+    stmt->kind = PREPARED_OTHER;
+}
+
+// Parse the statement once and cache everything that does not depend on the parameter values
+static int resolve_statement(PreparedStatement *stmt)
+{
+    int iterator = 1;
+    stmt->kind = PREPARED_OTHER;
+    switch (stmt->tokens[0].type)
+    {
+    case TOKEN_INSERT:
+        if (parse_insert_query(stmt->tokens, stmt->token_count, &iterator, &stmt->insert) != 0)
+        {
+            return -1;
+        }
+        stmt->kind = PREPARED_INSERT;
+        break;
+    case TOKEN_SELECT:
+        if (parse_select_query(stmt->tokens, stmt->token_count, &iterator, &stmt->select) != 0)
+        {
+            return -1;
+        }
+        stmt->kind = PREPARED_SELECT;
+        collect_parameter_nodes(stmt, stmt->select.where);
+        if (build_query_plan(&stmt->plan, stmt->select.where, stmt->select.tables, stmt->select.alias, stmt->select.table_count) != 0)
+        {
+            release_resolution(stmt);
+            return -1;
+        }
+        break;
+    case TOKEN_PREPARE:
+    case TOKEN_EXECUTE:
+        printf("Error: PREPARE and EXECUTE statements cannot be prepared\n");
+        return -1;
+    default:
+        break;
+    }
+    stmt->schema_version = get_schema_version();
+    return 0;
+}
+
+PreparedStatement *prepare_tokens(const Token *tokens, int token_count)
+{
+    if (token_count <= 0)
+    {
+        printf("Error: Empty statement\n");
+        return NULL;
+    }
+
+    PreparedStatement *stmt = calloc(1, sizeof(PreparedStatement));
+    if (!stmt)
+    {
+        printf("Error: Memory allocation failed\n");
+        return NULL;
+    }
+    // The tokens point into the caller's SQL text, keep a copy of the part they span
+    const char *begin = tokens[0].start;
+    const char *end = begin;
+    for (int i = 0; i < token_count; i++)
+    {
+        int length = tokens[i].type == TOKEN_PARAMETER ? 1 : tokens[i].length;
+        if (tokens[i].start + length > end)
+        {
+            end = tokens[i].start + length;
+        }
+    }
+    stmt->sql = strndup(begin, end - begin);
+    stmt->tokens = malloc(sizeof(Token) * (token_count + 1));
+    stmt->bound_tokens = malloc(sizeof(Token) * (token_count + 1));
+    if (!stmt->sql || !stmt->tokens || !stmt->bound_tokens)
+    {
+        printf("Error: Memory allocation failed\n");
+        free_prepared_statement(stmt);
+        return NULL;
+    }
+    for (int i = 0; i < token_count; i++)
+    {
+        stmt->tokens[i] = tokens[i];
+        stmt->tokens[i].start = stmt->sql + (tokens[i].start - begin);
+    }
+    stmt->tokens[token_count].type = TOKEN_EOF;
+    stmt->tokens[token_count].length = 0;
+    stmt->tokens[token_count].start = stmt->sql + (end - begin);
+    stmt->token_count = token_count + 1;
+
+    // Number the placeholders from the start of the statement
+    for (int i = 0; i < token_count; i++)
+    {
+        if (stmt->tokens[i].type == TOKEN_PARAMETER)
+        {
+            if (stmt->parameter_count == MAX_PARAMETER_COUNT)
+            {
+                printf("Error: Too many parameters, Maximum is %d\n", MAX_PARAMETER_COUNT);
+                free_prepared_statement(stmt);
+                return NULL;
+            }
+            stmt->tokens[i].parameter = stmt->parameter_count;
+            stmt->parameters[stmt->parameter_count].type = TOKEN_ERROR;
+            stmt->parameter_count++;
+        }
+    }
+
+    if (resolve_statement(stmt) != 0)
+    {
+        free_prepared_statement(stmt);
+        return NULL;
+    }
+    return stmt;
+}
+
+PreparedStatement *prepare_statement(const char *sql)
+{
+    int token_count = 0;
+    Token *tokens = tokenize(sql, &token_count);
+    if (!tokens)
+    {
+        return NULL;
+    }
+    // Drop the trailing TOKEN_EOF, prepare_tokens adds its own
+    PreparedStatement *stmt = prepare_tokens(tokens, token_count - 1);
+    free(tokens);
+    return stmt;
+}
+
+int bind_parameter_token(PreparedStatement *stmt, int index, const Token *value)
+{
+    if (index < 0 || index >= stmt->parameter_count)
+    {
+        printf("Error: Parameter index %d out of range, statement has %d parameters\n", index, stmt->parameter_count);
+        return -1;
+    }
+    if (value->type != TOKEN_NUMBER && value->type != TOKEN_STRING)
+    {
+        printf("Error: Parameter value must be a number or a string\n");
+        return -1;
+    }
+    if (value->length >= MAX_TOKEN_LENGTH)
+    {
+        printf("Error: Parameter value is too long, Maximum is %d characters\n", MAX_TOKEN_LENGTH - 1);
+        return -1;
+    }
+    token_copy(value, stmt->parameter_text[index], MAX_TOKEN_LENGTH);
+    stmt->parameters[index].type = value->type;
+    stmt->parameters[index].length = value->length;
+    stmt->parameters[index].start = stmt->parameter_text[index];
+    return 0;
+}
+
+int bind_parameter_int(PreparedStatement *stmt, int index, int value)
+{
+    char text[16];
+    Token token;
+    token.type = TOKEN_NUMBER;
+    token.length = snprintf(text, sizeof(text), "%d", value);
+    token.start = text;
+    return bind_parameter_token(stmt, index, &token);
+}
+
+int bind_parameter_text(PreparedStatement *stmt, int index, const char *value)
+{
+    Token token;
+    token.type = TOKEN_STRING;
+    token.length = strlen(value);
+    token.start = value;
+    return bind_parameter_token(stmt, index, &token);
+}
+
+int execute_prepared_statement(PreparedStatement *stmt)
+{
+    for (int i = 0; i < stmt->parameter_count; i++)
+    {
+        if (stmt->parameters[i].type == TOKEN_ERROR)
+        {
+            printf("Error: Parameter %d is not bound\n", i);
+            return -1;
+        }
+    }
+
+    // Cached Table pointers are stale once the set of tables changed
+    if (stmt->schema_version != get_schema_version())
+    {
+        release_resolution(stmt);
+        if (resolve_statement(stmt) != 0)
+        {
+            return -1;
+        }
+    }
+
+    switch (stmt->kind)
+    {
+    case PREPARED_INSERT:
+        return run_insert_query(&stmt->insert, stmt->parameters);
+
+    case PREPARED_SELECT:
+        for (int i = 0; i < stmt->parameter_count; i++)
+        {
+            Expression *node = stmt->parameter_nodes[i];
+            if (node)
+            {
+                token_copy(&stmt->parameters[i], node->literal.value, MAX_TOKEN_LENGTH);
+                node->literal.is_string = stmt->parameters[i].type == TOKEN_STRING;
+            }
+        }
+        return run_select_query(&stmt->select, &stmt->plan);
+
+    case PREPARED_OTHER:
+        memcpy(stmt->bound_tokens, stmt->tokens, sizeof(Token) * stmt->token_count);
+        for (int i = 0; i < stmt->token_count; i++)
+        {
+            if (stmt->bound_tokens[i].type == TOKEN_PARAMETER)
+            {
+                stmt->bound_tokens[i] = stmt->parameters[stmt->tokens[i].parameter];
+            }
+        }
+        return parser(stmt->bound_tokens, stmt->token_count);
+    }
+    return -1;
+}
+
+void free_prepared_statement(PreparedStatement *stmt)
+{
+    if (!stmt)
+    {
+        return;
+    }
+    release_resolution(stmt);
+    free(stmt->sql);
+    free(stmt->tokens);
+    free(stmt->bound_tokens);
+    free(stmt);
+}
+
+int register_prepared_statement(const char *name, PreparedStatement *stmt)
+{
+    if (strlen(name) >= MAX_NAME_LEN)
+    {
+        printf("Error: Statement name is too long, Maximum is %d characters\n", MAX_NAME_LEN - 1);
+        return -1;
+    }
+    strcpy(stmt->name, name);
+
+    for (int i = 0; i < prepared_count; i++)
+    {
+        if (strcmp(prepared_statements[i]->name, name) == 0)
+        {
+            free_prepared_statement(prepared_statements[i]);
+            prepared_statements[i] = stmt;
+            return 0;
+        }
+    }
+    if (prepared_count == MAX_PREPARED_COUNT)
+    {
+        printf("Error: Too many prepared statements, Maximum is %d\n", MAX_PREPARED_COUNT);
+        return -1;
+    }
+    prepared_statements[prepared_count++] = stmt;
+    return 0;
+}
+
+PreparedStatement *get_prepared_statement(const char *name)
+{
+    for (int i = 0; i < prepared_count; i++)
+    {
+        if (strcmp(prepared_statements[i]->name, name) == 0)
+        {
+            return prepared_statements[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,142 @@
+#include "result_cache.h"
+#include "table.h"
+#include "hash.h"
+#include "arena.h"
+#include "wire.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ResultCacheEntry entries[RESULT_CACHE_ENTRIES];
+static unsigned long use_clock = 0;
+
+// Keywords and punctuation are fully described by their type, the other tokens also need their text
+static int token_has_text(TokenType type)
+{
+    return type == TOKEN_IDENTIFIER || type == TOKEN_STRING || type == TOKEN_NUMBER;
+}
+
+char *build_result_cache_key(const Token *tokens, int token_count, size_t *key_length)
+{
+    size_t size = 1;
+    for (int i = 0; i < token_count; i++)
+    {
+        size += 1 + (token_has_text(tokens[i].type) ? sizeof(int) + tokens[i].length : 0);
+    }
+    char *key = arena_alloc(get_query_arena(), size);
+    if (!key)
+    {
+        return NULL;
+    }
+    char *out = key;
+    *out++ = (char)get_protocol(); // the cached output is written in the protocol of the session
+    for (int i = 0; i < token_count; i++)
+    {
+        *out++ = (char)tokens[i].type;
+        if (token_has_text(tokens[i].type))
+        {
+            // the length keeps 'a b' and 'a' 'b' apart
+            memcpy(out, &tokens[i].length, sizeof(int));
+            out += sizeof(int);
+            memcpy(out, tokens[i].start, tokens[i].length);
+            out += tokens[i].length;
+        }
+    }
+    *key_length = size;
+    return key;
+}
+
+static void free_entry(ResultCacheEntry *entry)
+{
+    free(entry->key);
+    free(entry->output);
+    memset(entry, 0, sizeof(ResultCacheEntry));
+}
+
+static int entry_is_current(const ResultCacheEntry *entry, Table *tables[], int table_count)
+{
+    if (entry->schema_version != get_schema_version() || entry->table_count != table_count)
+    {
+        return 0;
+    }
+    for (int i = 0; i < table_count; i++)
+    {
+        if (entry->table_versions[i] != tables[i]->version)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+const ResultCacheEntry *find_cached_result(const char *key, size_t key_length, Table *tables[], int table_count)
+{
+    uint32_t hash = word_hash_bytes(key, key_length);
+    for (int i = 0; i < RESULT_CACHE_ENTRIES; i++)
+    {
+        ResultCacheEntry *entry = &entries[i];
+        if (!entry->key || entry->hash != hash || entry->key_length != key_length ||
+            memcmp(entry->key, key, key_length) != 0)
+        {
+            continue;
+        }
+        // Versions only grow, an entry that fell behind can never be served again
+        if (!entry_is_current(entry, tables, table_count))
+        {
+            free_entry(entry);
+            return NULL;
+        }
+        entry->last_used = ++use_clock;
+        return entry;
+    }
+    return NULL;
+}
+
+int cache_result(const char *key, size_t key_length, Table *tables[], int table_count, const char *output,
+                 size_t output_length)
+{
+    if (output_length > RESULT_CACHE_MAX_OUTPUT || table_count > MAX_JOIN_COUNT)
+    {
+        return 0;
+    }
+    ResultCacheEntry *victim = &entries[0];
+    for (int i = 0; i < RESULT_CACHE_ENTRIES && victim->key; i++)
+    {
+        if (!entries[i].key || entries[i].last_used < victim->last_used)
+        {
+            victim = &entries[i];
+        }
+    }
+    free_entry(victim);
+
+    victim->key = malloc(key_length);
+    victim->output = malloc(output_length + 1);
+    if (!victim->key || !victim->output)
+    {
+        perror("Failed to allocate memory for cached result");
+        free_entry(victim);
+        return -1;
+    }
+    memcpy(victim->key, key, key_length);
+    victim->key_length = key_length;
+    victim->hash = word_hash_bytes(key, key_length);
+    memcpy(victim->output, output, output_length);
+    victim->output[output_length] = '\0';
+    victim->output_length = output_length;
+    victim->schema_version = get_schema_version();
+    victim->table_count = table_count;
+    for (int i = 0; i < table_count; i++)
+    {
+        victim->table_versions[i] = tables[i]->version;
+    }
+    victim->last_used = ++use_clock;
+    return 0;
+}
+
+void clear_result_cache()
+{
+    for (int i = 0; i < RESULT_CACHE_ENTRIES; i++)
+    {
+        free_entry(&entries[i]);
+    }
+}
@@ -0,0 +1,397 @@
+#include "sort.h"
+#include "sql_tokenizer.h"
+#include "planner.h"
+#include "storage.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const Sorter *comparing; // qsort passes no context to its comparison
+
+static int column_width(const Column *column)
+{
+    return column->type == INT ? (int)sizeof(int) : column->lenght + 1;
+}
+
+// Records a sort keeps in memory, at least one however wide they are
+static long max_memory_records(const Sorter *sorter)
+{
+    long records = SORT_MEMORY_LIMIT / sorter->record_size;
+    return records > 0 ? records : 1;
+}
+
+int init_sorter(Sorter *sorter, const SelectQuery *query)
+{
+    memset(sorter, 0, sizeof(Sorter));
+    sorter->query = query;
+    for (int i = 0; i < query->order_count; i++)
+    {
+        int t = resolve_named_column((Table **)query->tables, (char **)query->alias, query->table_count, query->order_alias[i],
+                                     query->order_names[i], &sorter->key_columns[i]);
+        if (t < 0)
+        {
+            printf(t == -2 ? "Error: Column %s exists in more than one table, give specifications\n"
+                           : "Error: ORDER BY column %s does not exist\n",
+                   query->order_names[i]);
+            return -1;
+        }
+        sorter->key_tables[i] = t;
+        sorter->key_offsets[i] = sorter->key_size;
+        sorter->key_size += column_width(&query->tables[t]->columns[sorter->key_columns[i]]);
+    }
+    sorter->record_size = sorter->key_size + query->table_count * sizeof(long);
+
+    // A top-N heap is only used when it fits where a full sort would keep its records
+    long max_records = max_memory_records(sorter);
+    long keep = query->limit >= 0 ? query->limit + query->offset : -1;
+    sorter->limit = keep >= 0 && keep <= max_records ? keep : -1;
+    sorter->capacity = sorter->limit >= 0 ? sorter->limit : (max_records < 1024 ? max_records : 1024);
+    if (sorter->capacity > 0)
+    {
+        sorter->records = malloc(sorter->capacity * sorter->record_size);
+        if (!sorter->records)
+        {
+            perror("Failed to allocate memory for sort");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void mark_sort_columns(const Sorter *sorter, QueryPlan *plan)
+{
+    for (int i = 0; i < sorter->query->order_count; i++)
+    {
+        plan->used_columns[sorter->key_tables[i]][sorter->key_columns[i]] = COLUMN_VALUES;
+    }
+}
+
+// Order of two records, ties are broken by the row positions so every sort path gives the same order
+static int compare_records(const Sorter *sorter, const char *a, const char *b)
+{
+    const SelectQuery *query = sorter->query;
+    for (int i = 0; i < query->order_count; i++)
+    {
+        const Column *column = &query->tables[sorter->key_tables[i]]->columns[sorter->key_columns[i]];
+        const char *x = a + sorter->key_offsets[i];
+        const char *y = b + sorter->key_offsets[i];
+        int result;
+        if (column->type == INT)
+        {
+            int left, right;
+            memcpy(&left, x, sizeof(int));
+            memcpy(&right, y, sizeof(int));
+            result = (left > right) - (left < right);
+        }
+        else
+        {
+            result = strncmp(x, y, column->lenght + 1);
+        }
+        if (result != 0)
+        {
+            return query->order_descending[i] ? -result : result;
+        }
+    }
+    for (int t = 0; t < query->table_count; t++)
+    {
+        long left, right;
+        memcpy(&left, a + sorter->key_size + t * sizeof(long), sizeof(long));
+        memcpy(&right, b + sorter->key_size + t * sizeof(long), sizeof(long));
+        if (left != right)
+        {
+            return left < right ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_for_qsort(const void *a, const void *b)
+{
+    return compare_records(comparing, a, b);
+}
+
+static void sort_records(Sorter *sorter)
+{
+    comparing = sorter;
+    qsort(sorter->records, sorter->record_count, sorter->record_size, compare_for_qsort);
+}
+
+static void swap_records(Sorter *sorter, long i, long j)
+{
+    char temp[sorter->record_size];
+    memcpy(temp, sorter->records + i * sorter->record_size, sorter->record_size);
+    memcpy(sorter->records + i * sorter->record_size, sorter->records + j * sorter->record_size, sorter->record_size);
+    memcpy(sorter->records + j * sorter->record_size, temp, sorter->record_size);
+}
+
+// The top-N heap keeps the record that sorts last at its root, a better record replaces it
+static void heap_sift_down(Sorter *sorter, long i)
+{
+    for (;;)
+    {
+        long largest = i;
+        for (long child = 2 * i + 1; child <= 2 * i + 2 && child < sorter->record_count; child++)
+        {
+            if (compare_records(sorter, sorter->records + child * sorter->record_size,
+                                sorter->records + largest * sorter->record_size) > 0)
+            {
+                largest = child;
+            }
+        }
+        if (largest == i)
+        {
+            return;
+        }
+        swap_records(sorter, i, largest);
+        i = largest;
+    }
+}
+
+static void heap_push(Sorter *sorter, const char *record)
+{
+    if (sorter->record_count < sorter->limit)
+    {
+        long i = sorter->record_count++;
+        memcpy(sorter->records + i * sorter->record_size, record, sorter->record_size);
+        while (i > 0 && compare_records(sorter, sorter->records + ((i - 1) / 2) * sorter->record_size,
+                                        sorter->records + i * sorter->record_size) < 0)
+        {
+            swap_records(sorter, i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+    else if (sorter->limit > 0 && compare_records(sorter, record, sorter->records) < 0)
+    {
+        memcpy(sorter->records, record, sorter->record_size);
+        heap_sift_down(sorter, 0);
+    }
+}
+
+static void print_record(const Sorter *sorter, const char *record, ResultWriter *out)
+{
+    for (int t = 0; t < sorter->query->table_count; t++)
+    {
+        long pos;
+        memcpy(&pos, record + sorter->key_size + t * sizeof(long), sizeof(long));
+        write_int64(out, pos);
+    }
+    end_row(out);
+}
+
+// Merge the runs into one run written to into. When into is NULL, skip the first offset records and print up to
+// limit of the rest to out. Returns the records written or printed, -1 on failure.
+static long merge_runs(Sorter *sorter, FILE *into, ResultWriter *out, long offset, long limit)
+{
+    int run_count = sorter->run_count;
+    char *heads = malloc((size_t)run_count * sorter->record_size);
+    int heap[MAX_SORT_RUNS]; // indexes of the runs that still have records, the smallest head at the root
+    int heap_size = 0;
+    if (!heads)
+    {
+        perror("Failed to allocate memory for merge");
+        return -1;
+    }
+    for (int r = 0; r < run_count; r++)
+    {
+        rewind(sorter->runs[r]);
+        if (fread(heads + (size_t)r * sorter->record_size, sorter->record_size, 1, sorter->runs[r]) != 1)
+        {
+            continue;
+        }
+        int i = heap_size++;
+        heap[i] = r;
+        while (i > 0 && compare_records(sorter, heads + (size_t)heap[i] * sorter->record_size,
+                                        heads + (size_t)heap[(i - 1) / 2] * sorter->record_size) < 0)
+        {
+            int temp = heap[i];
+            heap[i] = heap[(i - 1) / 2];
+            heap[(i - 1) / 2] = temp;
+            i = (i - 1) / 2;
+        }
+    }
+
+    long written = 0;
+    for (long skipped = 0; heap_size > 0 && (limit < 0 || written < limit);)
+    {
+        int r = heap[0];
+        char *head = heads + (size_t)r * sorter->record_size;
+        if (into)
+        {
+            if (fwrite(head, sorter->record_size, 1, into) != 1)
+            {
+                perror("Failed to write sort run");
+                written = -1;
+                break;
+            }
+            written++;
+        }
+        else if (skipped < offset)
+        {
+            skipped++;
+        }
+        else
+        {
+            print_record(sorter, head, out);
+            written++;
+        }
+        if (fread(head, sorter->record_size, 1, sorter->runs[r]) != 1)
+        {
+            heap[0] = heap[--heap_size];
+        }
+        for (int i = 0;;)
+        {
+            int smallest = i;
+            for (int child = 2 * i + 1; child <= 2 * i + 2 && child < heap_size; child++)
+            {
+                if (compare_records(sorter, heads + (size_t)heap[child] * sorter->record_size,
+                                    heads + (size_t)heap[smallest] * sorter->record_size) < 0)
+                {
+                    smallest = child;
+                }
+            }
+            if (smallest == i)
+            {
+                break;
+            }
+            int temp = heap[i];
+            heap[i] = heap[smallest];
+            heap[smallest] = temp;
+            i = smallest;
+        }
+    }
+    free(heads);
+    return written;
+}
+
+// Sort the records in memory and write them to a temporary file as a run
+static int spill_run(Sorter *sorter)
+{
+    if (sorter->run_count == MAX_SORT_RUNS)
+    {
+        // Too many runs to merge at once, fold the ones so far into a single run
+        FILE *merged = tmpfile();
+        if (!merged || merge_runs(sorter, merged, NULL, 0, -1) < 0)
+        {
+            perror("Failed to merge sort runs");
+            if (merged)
+            {
+                fclose(merged);
+            }
+            return -1;
+        }
+        for (int r = 0; r < sorter->run_count; r++)
+        {
+            fclose(sorter->runs[r]);
+        }
+        sorter->runs[0] = merged;
+        sorter->run_count = 1;
+    }
+
+    sort_records(sorter);
+    FILE *run = tmpfile();
+    if (!run)
+    {
+        perror("Failed to create sort run");
+        return -1;
+    }
+    if (fwrite(sorter->records, sorter->record_size, sorter->record_count, run) != (size_t)sorter->record_count)
+    {
+        perror("Failed to write sort run");
+        fclose(run);
+        return -1;
+    }
+    sorter->runs[sorter->run_count++] = run;
+    sorter->spilled_runs++;
+    sorter->record_count = 0;
+    return 0;
+}
+
+void sort_row(Sorter *sorter, Table *tables[], char *rows[], const long positions[])
+{
+    const SelectQuery *query = sorter->query;
+    char record[sorter->record_size];
+    for (int i = 0; i < query->order_count; i++)
+    {
+        const Table *table = tables[sorter->key_tables[i]];
+        const Column *column = &table->columns[sorter->key_columns[i]];
+        const char *value = rows[sorter->key_tables[i]] + calculate_offset(table, *column);
+        if (column->type == INT)
+        {
+            memcpy(record + sorter->key_offsets[i], value, sizeof(int));
+        }
+        else
+        {
+            strncpy(record + sorter->key_offsets[i], value, column->lenght);
+            record[sorter->key_offsets[i] + column->lenght] = '\0';
+        }
+    }
+    memcpy(record + sorter->key_size, positions, query->table_count * sizeof(long));
+
+    if (sorter->limit >= 0)
+    {
+        heap_push(sorter, record);
+        return;
+    }
+    if (sorter->record_count == sorter->capacity)
+    {
+        long max_records = max_memory_records(sorter);
+        if (sorter->capacity >= max_records)
+        {
+            if (spill_run(sorter) != 0)
+            {
+                sorter->failed = 1;
+                return;
+            }
+        }
+        else
+        {
+            long capacity = sorter->capacity * 2 < max_records ? sorter->capacity * 2 : max_records;
+            char *grown = realloc(sorter->records, capacity * sorter->record_size);
+            if (!grown)
+            {
+                perror("Failed to allocate memory for sort");
+                sorter->failed = 1;
+                return;
+            }
+            sorter->records = grown;
+            sorter->capacity = capacity;
+        }
+    }
+    memcpy(sorter->records + sorter->record_count * sorter->record_size, record, sorter->record_size);
+    sorter->record_count++;
+}
+
+int print_sorted(Sorter *sorter, ResultWriter *out)
+{
+    long offset = sorter->query->offset;
+    long limit = sorter->query->limit;
+    long printed = 0;
+    if (sorter->run_count == 0)
+    {
+        sort_records(sorter);
+        for (long i = offset; i < sorter->record_count && (limit < 0 || printed < limit); i++, printed++)
+        {
+            print_record(sorter, sorter->records + i * sorter->record_size, out);
+        }
+    }
+    else
+    {
+        if (sorter->record_count > 0 && spill_run(sorter) != 0)
+        {
+            return -1;
+        }
+        printed = merge_runs(sorter, NULL, out, offset, limit);
+    }
+    return printed < 0 ? -1 : 0;
+}
+
+void free_sorter(Sorter *sorter)
+{
+    for (int r = 0; r < sorter->run_count; r++)
+    {
+        fclose(sorter->runs[r]);
+    }
+    free(sorter->records);
+    sorter->records = NULL;
+    sorter->run_count = 0;
+    sorter->record_count = 0;
+}
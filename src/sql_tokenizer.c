@@ -1,422 +1,442 @@
 #include "sql_tokenizer.h"
 #include "table.h"
 #include "file_io.h"
+#include "planner.h"
+#include "prepared.h"
+#include "arena.h"
+#include "result_cache.h"
+#include "sort.h"
+#include "wire.h"
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
 
-void nested_loop_join(Expression *expr, Table *tables[], char *alias[], FILE *files[], int table_count, char *rows[], int current_table, long return_positions[][table_count], int *match_count /*, Column *columns[], char *column_alias[], int column_count*/)
+// Fetch the next candidate row of the table at this depth into rows, 0 when there are none left
+static int fetch_next_row(QueryPlan *plan, Table *tables[], char *alias[], TableStorage storages[], int table_count, char *rows[], int depth, int *probed)
 {
-    if (current_table >= table_count)
-    {
-        if (evaluate_expression(expr, tables, alias, rows, table_count))
-        {
-            for (int i = 0; i < table_count; i++)
-            {
-                return_positions[*match_count][i] = ftell(files[i]) - tables[i]->row_size_in_bytes;
-            }
-            (*match_count)++;
-        }
-        return;
-    }
+    int t = plan->order[depth];
+    OperatorStats *stats = &plan->stats[depth];
 
-    while (fread(rows[current_table], tables[current_table]->row_size_in_bytes, 1, files[current_table]) == 1)
+    if (plan->access[t].method == ACCESS_HASH_LOOKUP)
     {
-        if (isfree(tables[current_table], ftell(files[current_table]) - tables[current_table]->row_size_in_bytes))
+        // A primary key matches at most one row
+        if (*probed)
         {
-            continue; // Skip free rows
+            return 0;
         }
-        // Recursively process next table
-        nested_loop_join(expr, tables, alias, files, table_count, rows, current_table + 1, return_positions, match_count /*, columns, column_alias, column_count*/);
-
-        // After processing all deeper tables, rewind them for next iteration
-        for (int i = current_table + 1; i < table_count; i++)
+        *probed = 1;
+        Key key;
+        memset(&key, 0, sizeof(Key));
+        key.int_key = evaluate_expression(plan->access[t].key, tables, alias, rows, table_count);
+        stats->index_probes++;
+        HashEntry *he = find_right_entry_in_bucket(tables[t]->hash, key, hash_int_key(tables[t], key.int_key));
+        if (he == NULL || read_table_rows(&storages[t], he->file_pos, rows[t], 1) != 1)
         {
-            rewind(files[i]);
+            return 0;
         }
+        stats->rows_read++;
+        stats->bytes_read += storages[t].bytes_per_row;
+        return 1;
     }
 
-    // Rewind current table for potential future joins
-    rewind(files[current_table]);
-}
-
-Token *tokenize(const char *sql, int *out_count)
-{
-    Token *tokens = malloc(sizeof(Token) * MAX_TOKEN_COUNT);
-    int token_count = 0;
-
-    while (1)
+    // Blocks whose zone map rules out a conjunct of this depth are jumped over when the scan enters them
+    long block_bytes = (long)ZONE_BLOCK_ROWS * tables[t]->row_size_in_bytes;
+    for (;;)
     {
-        if (token_count >= MAX_TOKEN_COUNT)
+        long pos = storages[t].scan_pos;
+        if (pos % block_bytes == 0 && !block_may_match(plan, depth, tables[t], pos / block_bytes))
         {
-            printf("Error: Too many tokens, Maximum is %d\n", MAX_TOKEN_COUNT);
-            free(tokens);
-            return NULL;
-        }
-        Token token = {TOKEN_ERROR, ""};
-
-        while (isspace(*sql))
-        {
-            sql++;
+            seek_table_storage(&storages[t], pos + block_bytes);
+            stats->blocks_skipped++;
+            continue;
         }
-
-        if (*sql == '\0')
+        if (!read_next_row(&storages[t], rows[t]))
         {
-            token.type = TOKEN_EOF;
-            tokens[token_count++] = token;
             break;
         }
-        if (strncmp(sql, "SELECT", 6) == 0)
-        {
-            token.type = TOKEN_SELECT;
-            strncpy(token.token, sql, 6);
-            token.token[6] = '\0';
-            sql += 6;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "INSERT", 6) == 0)
-        {
-            token.type = TOKEN_INSERT;
-            strcpy(token.token, "INSERT");
-            sql += 6;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "CREATE", 6) == 0)
-        {
-            token.type = TOKEN_CREATE;
-            strcpy(token.token, "CREATE");
-            sql += 6;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "TABLES", 6) == 0)
-        {
-            token.type = TOKEN_TABLES;
-            strcpy(token.token, "TABLES");
-            sql += 6;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "DROP", 4) == 0)
-        {
-            token.type = TOKEN_DROP;
-            strcpy(token.token, "DROP");
-            sql += 4;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "TABLE", 5) == 0)
-        {
-            token.type = TOKEN_TABLE;
-            strcpy(token.token, "TABLE");
-            sql += 5;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "LOAD", 4) == 0)
-        {
-            token.type = TOKEN_LOAD;
-            strcpy(token.token, "LOAD");
-            sql += 4;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "DATABASES", 9) == 0)
-        {
-            token.type = TOKEN_DATABASES;
-            strcpy(token.token, "DATABASES");
-            sql += 9;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "SHOW", 4) == 0)
-        {
-            token.type = TOKEN_SHOW;
-            strcpy(token.token, "SHOW");
-            sql += 4;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "DATABASE", 8) == 0)
-        {
-            token.type = TOKEN_DATABASE;
-            strcpy(token.token, "DATABASE");
-            sql += 8;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "VALUES", 6) == 0)
-        {
-            token.type = TOKEN_VALUES;
-            strcpy(token.token, "VALUES");
-            sql += 6;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "UPDATE", 6) == 0)
-        {
-            token.type = TOKEN_UPDATE;
-            strcpy(token.token, "UPDATE");
-            sql += 6;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "DELETE", 6) == 0)
-        {
-            token.type = TOKEN_DELETE;
-            strcpy(token.token, "DELETE");
-            sql += 6;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "FROM", 4) == 0)
-        {
-            token.type = TOKEN_FROM;
-            strcpy(token.token, "FROM");
-            sql += 4;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "PRIMARY", 7) == 0)
+        stats->bytes_read += storages[t].bytes_per_row;
+        if (isfree(tables[t], storages[t].current_pos))
         {
-            token.type = TOKEN_PRIMARY;
-            strcpy(token.token, "PRIMARY");
-            sql += 7;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "KEY", 3) == 0)
-        {
-            token.type = TOKEN_KEY;
-            strcpy(token.token, "KEY");
-            sql += 3;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "char", 4) == 0)
-        {
-            token.type = TOKEN_CHAR;
-            strcpy(token.token, "char");
-            sql += 4;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "int", 3) == 0)
-        {
-            token.type = TOKEN_INT;
-            strcpy(token.token, "int");
-            sql += 3;
-            tokens[token_count++] = token;
+            continue; // Skip free rows
         }
+        stats->rows_read++;
+        return 1;
+    }
+    return 0;
+}
 
-        else if (strncmp(sql, "INTO", 4) == 0)
-        {
-            token.type = TOKEN_INTO;
-            strcpy(token.token, "INTO");
-            sql += 4;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "SET", 3) == 0)
-        {
-            token.type = TOKEN_SET;
-            strcpy(token.token, "SET");
-            sql += 3;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "WHERE", 5) == 0)
-        {
-            token.type = TOKEN_WHERE;
-            strcpy(token.token, "WHERE");
-            sql += 5;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, ">=", 2) == 0)
-        {
-            token.type = TOKEN_GE;
-            strcpy(token.token, ">=");
-            sql += 2;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "<=", 2) == 0)
-        {
-            token.type = TOKEN_LE;
-            strcpy(token.token, "<=");
-            sql += 2;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "<>", 2) == 0)
-        {
-            token.type = TOKEN_NE;
-            strcpy(token.token, "<>");
-            sql += 2;
-            tokens[token_count++] = token;
-        }
-        else if (strncmp(sql, "BETWEEN", 8) == 0)
+// Append the positions the storages are at as one match, doubling the list when it is full
+static void add_match(PositionList *list, TableStorage storages[], int table_count)
+{
+    if (list->count == list->capacity)
+    {
+        long capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        long *grown = realloc(list->positions, sizeof(long) * table_count * capacity);
+        if (!grown)
         {
-            token.type = TOKEN_BETWEEN;
-            strcpy(token.token, "BETWEEN");
-            sql += 8;
-            tokens[token_count++] = token;
+            list->failed = 1;
+            return;
         }
-        else if (strncmp(sql, "LIKE", 4) == 0)
+        list->positions = grown;
+        list->capacity = capacity;
+    }
+    for (int i = 0; i < table_count; i++)
+    {
+        list->positions[list->count * table_count + i] = storages[i].current_pos;
+    }
+    list->count++;
+}
+
+void nested_loop_join(QueryPlan *plan, Table *tables[], char *alias[], TableStorage storages[], int table_count, char *rows[], int depth, long return_positions[][table_count], int *match_count /*, Column *columns[], char *column_alias[], int column_count*/)
+{
+    if (depth >= table_count)
+    {
+        // Every conjunct has already been checked on the way down
+        if (plan->aggregate)
         {
-            token.type = TOKEN_LIKE;
-            strcpy(token.token, "LIKE");
-            sql += 4;
-            tokens[token_count++] = token;
+            aggregate_row(plan->aggregate, tables, alias, rows, table_count);
+            (*match_count)++;
+            return;
         }
-        else if (strncmp(sql, "IN", 2) == 0)
+        if (plan->sorter)
         {
-            token.type = TOKEN_IN;
-            strcpy(token.token, "IN");
-            sql += 2;
-            tokens[token_count++] = token;
+            long positions[table_count];
+            for (int i = 0; i < table_count; i++)
+            {
+                positions[i] = storages[i].current_pos;
+            }
+            sort_row(plan->sorter, tables, rows, positions);
+            (*match_count)++;
+            return;
         }
-        else if (strncmp(sql, "AND", 3) == 0)
+        if (plan->matches)
         {
-            token.type = TOKEN_AND;
-            strcpy(token.token, "AND");
-            sql += 3;
-            tokens[token_count++] = token;
+            add_match(plan->matches, storages, table_count);
+            (*match_count)++;
+            return;
         }
-        else if (strncmp(sql, "OR", 2) == 0)
+        for (int i = 0; i < table_count; i++)
         {
-            token.type = TOKEN_OR;
-            strcpy(token.token, "OR");
-            sql += 2;
-            tokens[token_count++] = token;
+            return_positions[*match_count][i] = storages[i].current_pos;
         }
-        else if (strncmp(sql, "NOT", 3) == 0)
+        (*match_count)++;
+        return;
+    }
+
+    OperatorStats *stats = &plan->stats[depth];
+    double start = plan->analyze ? get_time_ms() : 0.0;
+    int probed = 0;
+    stats->loops++;
+    // With a LIMIT no more rows are read at any depth once enough have matched
+    while ((plan->row_limit < 0 || *match_count < plan->row_limit) &&
+           fetch_next_row(plan, tables, alias, storages, table_count, rows, depth, &probed))
+    {
+        // Prune on every conjunct whose tables are bound at this depth before going deeper
+        if (!evaluate_code_conjuncts_at_depth(plan, depth, storages[plan->order[depth]].codes) ||
+            !evaluate_conjuncts_at_depth(plan, depth, tables, alias, rows, table_count))
         {
-            token.type = TOKEN_NOT;
-            strcpy(token.token, "NOT");
-            sql += 3;
-            tokens[token_count++] = token;
+            continue;
         }
-        else if (*sql == '+')
+        stats->rows_out++;
+        if (plan->analyze)
         {
-            token.type = TOKEN_ADD;
-            strcpy(token.token, "+");
-            sql++;
-            tokens[token_count++] = token;
+            stats->time_ms += get_time_ms() - start;
         }
-        else if (*sql == '-')
+
+        // Recursively process next table
+        nested_loop_join(plan, tables, alias, storages, table_count, rows, depth + 1, return_positions, match_count /*, columns, column_alias, column_count*/);
+
+        // After processing all deeper tables, rewind them for next iteration
+        for (int i = depth + 1; i < table_count; i++)
         {
-            token.type = TOKEN_SUB;
-            strcpy(token.token, "-");
-            sql++;
-            tokens[token_count++] = token;
+            rewind_table_storage(&storages[plan->order[i]]);
         }
-        else if (*sql == '/')
+        if (plan->analyze)
         {
-            token.type = TOKEN_DIV;
-            strcpy(token.token, "/");
-            sql++;
-            tokens[token_count++] = token;
+            start = get_time_ms();
         }
-        else if (*sql == '=' && *(sql + 1) == '=')
+    }
+    if (plan->analyze)
+    {
+        stats->time_ms += get_time_ms() - start;
+    }
+
+    // Rewind current table for potential future joins
+    rewind_table_storage(&storages[plan->order[depth]]);
+}
+
+typedef struct
+{
+    const char *word;
+    int length;
+    TokenType type;
+} Keyword;
+
+// Perfect hash over the keywords: no two keywords share a slot, so a lookup is one string compare.
+// The multipliers were searched for this keyword set, check for collisions when adding a keyword.
+#define KEYWORD_SLOTS 64
+#define KEYWORD_HASH(first, last, length) (((first) * 13 + (last) * 11 + (length) * 7) & (KEYWORD_SLOTS - 1))
+
+static const Keyword keywords[KEYWORD_SLOTS] = {
+    [0] = {"DROP", 4, TOKEN_DROP},
+    [4] = {"DATABASES", 9, TOKEN_DATABASES},
+    [5] = {"WHERE", 5, TOKEN_WHERE},
+    [8] = {"CREATE", 6, TOKEN_CREATE},
+    [9] = {"char", 4, TOKEN_CHAR},
+    [12] = {"EXPLAIN", 7, TOKEN_EXPLAIN},
+    [14] = {"AND", 3, TOKEN_AND},
+    [16] = {"SHOW", 4, TOKEN_SHOW},
+    [20] = {"PRIMARY", 7, TOKEN_PRIMARY},
+    [21] = {"DELETE", 6, TOKEN_DELETE},
+    [23] = {"OR", 2, TOKEN_OR},
+    [25] = {"VALUES", 6, TOKEN_VALUES},
+    [29] = {"IN", 2, TOKEN_IN},
+    [30] = {"TABLE", 5, TOKEN_TABLE},
+    [35] = {"DATABASE", 8, TOKEN_DATABASE},
+    [36] = {"LOAD", 4, TOKEN_LOAD},
+    [37] = {"BETWEEN", 7, TOKEN_BETWEEN},
+    [38] = {"int", 3, TOKEN_INT},
+    [39] = {"NOT", 3, TOKEN_NOT},
+    [40] = {"SET", 3, TOKEN_SET},
+    [41] = {"EXECUTE", 7, TOKEN_EXECUTE},
+    [47] = {"LIKE", 4, TOKEN_LIKE},
+    [50] = {"UPDATE", 6, TOKEN_UPDATE},
+    [53] = {"ANALYZE", 7, TOKEN_ANALYZE},
+    [54] = {"INTO", 4, TOKEN_INTO},
+    [55] = {"KEY", 3, TOKEN_KEY},
+    [56] = {"PREPARE", 7, TOKEN_PREPARE},
+    [57] = {"FROM", 4, TOKEN_FROM},
+    [59] = {"INSERT", 6, TOKEN_INSERT},
+    [61] = {"SELECT", 6, TOKEN_SELECT},
+    [63] = {"TABLES", 6, TOKEN_TABLES},
+};
+
+static TokenType lookup_keyword(const char *word, int length)
+{
+    const Keyword *keyword = &keywords[KEYWORD_HASH((unsigned char)word[0], (unsigned char)word[length - 1], length)];
+    if (keyword->length == length && memcmp(keyword->word, word, length) == 0)
+    {
+        return keyword->type;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+static int push_token(TokenVector *vector, TokenType type, const char *start, int length)
+{
+    if (vector->count == vector->capacity)
+    {
+        int capacity = vector->capacity ? vector->capacity * 2 : 64;
+        Token *tokens = realloc(vector->tokens, sizeof(Token) * capacity);
+        if (!tokens)
         {
-            token.type = TOKEN_EQ;
-            strcpy(token.token, "==");
-            sql += 2;
-            tokens[token_count++] = token;
+            printf("Error: Memory allocation failed\n");
+            return -1;
         }
-        else if (*sql == '=')
+        vector->tokens = tokens;
+        vector->capacity = capacity;
+    }
+    Token *token = &vector->tokens[vector->count++];
+    token->type = type;
+    token->length = length;
+    token->start = start;
+    return 0;
+}
+
+int tokenize_into(const char *sql, TokenVector *vector)
+{
+    vector->count = 0;
+    int parameter_count = 0;
+
+    while (1)
+    {
+        while (isspace((unsigned char)*sql))
         {
-            token.type = TOKEN_EQ;
-            strcpy(token.token, "=");
             sql++;
-            tokens[token_count++] = token;
         }
-        else if (*sql == ',')
+
+        const char *start = sql;
+        TokenType type = TOKEN_ERROR;
+        int length = 1;
+
+        if (*sql == '\0')
         {
-            token.type = TOKEN_COMMA;
-            strcpy(token.token, ",");
-            sql++;
-            tokens[token_count++] = token;
+            return push_token(vector, TOKEN_EOF, sql, 0);
         }
-        else if (*sql == '.')
+        if (isalpha((unsigned char)*sql))
         {
-            token.type = TOKEN_DOT;
-            strcpy(token.token, ".");
-            sql++;
-            tokens[token_count++] = token;
+            while (isalnum((unsigned char)sql[length]) || sql[length] == '_')
+            {
+                length++;
+            }
+            type = lookup_keyword(sql, length);
         }
-        else if (*sql == '>')
+        else if (isdigit((unsigned char)*sql))
         {
-            token.type = TOKEN_GT;
-            strcpy(token.token, ">");
-            sql++;
-            tokens[token_count++] = token;
+            while (isdigit((unsigned char)sql[length]))
+            {
+                length++;
+            }
+            type = TOKEN_NUMBER;
         }
-        else if (*sql == '<')
+        else if (*sql == '\'')
         {
-            token.type = TOKEN_LT;
-            strcpy(token.token, "<");
-            sql++;
-            tokens[token_count++] = token;
+            start = ++sql;
+            length = 0;
+            while (sql[length] != '\'' && sql[length] != '\0')
+            {
+                length++;
+            }
+            if (sql[length] == '\0')
+            {
+                printf("Error: Unterminated string literal\n");
+                return -1;
+            }
+            if (push_token(vector, TOKEN_STRING, start, length) != 0)
+            {
+                return -1;
+            }
+            sql += length + 1; // skip the closing quote
+            continue;
         }
-
-        else if (*sql == '*')
+        else if (*sql == '?')
         {
-            token.type = TOKEN_STAR;
-            strcpy(token.token, "*");
+            if (push_token(vector, TOKEN_PARAMETER, sql, 0) != 0)
+            {
+                return -1;
+            }
+            vector->tokens[vector->count - 1].parameter = parameter_count++;
             sql++;
-            tokens[token_count++] = token;
+            continue;
         }
-        else if (*sql == ';')
+        else if (strncmp(sql, ">=", 2) == 0)
         {
-            token.type = TOKEN_SEMICOLON;
-            strcpy(token.token, ";");
-            sql++;
-            tokens[token_count++] = token;
+            type = TOKEN_GE;
+            length = 2;
         }
-        else if (*sql == '(')
+        else if (strncmp(sql, "<=", 2) == 0)
         {
-            token.type = TOKEN_OPEN_PARENTHESIS;
-            strcpy(token.token, "(");
-            sql++;
-            tokens[token_count++] = token;
+            type = TOKEN_LE;
+            length = 2;
         }
-        else if (*sql == ')')
+        else if (strncmp(sql, "<>", 2) == 0)
         {
-            token.type = TOKEN_CLOSE_PARENTHESIS;
-            strcpy(token.token, ")");
-            sql++;
-            tokens[token_count++] = token;
+            type = TOKEN_NE;
+            length = 2;
         }
-        else if (isalpha(*sql))
+        else if (strncmp(sql, "==", 2) == 0)
         {
-            int i = 0;
-            while (isalnum(*sql) || *sql == '_')
-            {
-                token.token[i++] = *sql;
-                sql++;
-            }
-            token.token[i] = '\0';
-            token.type = TOKEN_IDENTIFIER;
-            tokens[token_count++] = token;
+            type = TOKEN_EQ;
+            length = 2;
         }
-        else if (isdigit(*sql))
+        else
         {
-            int i = 0;
-            while (isdigit(*sql))
+            switch (*sql)
             {
-                token.token[i++] = *sql;
-                sql++;
+            case '+':
+                type = TOKEN_ADD;
+                break;
+            case '-':
+                type = TOKEN_SUB;
+                break;
+            case '/':
+                type = TOKEN_DIV;
+                break;
+            case '=':
+                type = TOKEN_EQ;
+                break;
+            case ',':
+                type = TOKEN_COMMA;
+                break;
+            case '.':
+                type = TOKEN_DOT;
+                break;
+            case '>':
+                type = TOKEN_GT;
+                break;
+            case '<':
+                type = TOKEN_LT;
+                break;
+            case '*':
+                type = TOKEN_STAR;
+                break;
+            case ';':
+                type = TOKEN_SEMICOLON;
+                break;
+            case '(':
+                type = TOKEN_OPEN_PARENTHESIS;
+                break;
+            case ')':
+                type = TOKEN_CLOSE_PARENTHESIS;
+                break;
+            default:
+                printf("Error: Unexpected character '%c'\n", *sql);
+                return -1;
             }
-            token.token[i] = '\0';
-            token.type = TOKEN_NUMBER;
-            tokens[token_count++] = token;
         }
-        else if (*sql == '\'')
+
+        if (push_token(vector, type, start, length) != 0)
         {
-            sql++;
-            int i = 0;
-            while (*sql != '\'' && *sql != '\0')
-            {
-                token.token[i++] = *sql;
-                sql++;
-            }
-            if (*sql == '\'')
-            {
-                token.token[i] = '\0';
-                token.type = TOKEN_STRING;
-                sql++;
-                tokens[token_count++] = token;
-            }
+            return -1;
         }
+        sql += length;
     }
-    *out_count = token_count;
-    return tokens;
 }
 
-int parse_insert(Token *tokens, int token_count, int *iterator)
+Token *tokenize(const char *sql, int *out_count)
+{
+    TokenVector vector = {NULL, 0, 0};
+    if (tokenize_into(sql, &vector) != 0)
+    {
+        free_token_vector(&vector);
+        return NULL;
+    }
+    *out_count = vector.count;
+    return vector.tokens;
+}
+
+void free_token_vector(TokenVector *vector)
+{
+    free(vector->tokens);
+    vector->tokens = NULL;
+    vector->count = 0;
+    vector->capacity = 0;
+}
+
+int token_equals(const Token *token, const char *str)
+{
+    return strncmp(token->start, str, token->length) == 0 && str[token->length] == '\0';
+}
+
+char *token_strdup(const Token *token)
+{
+    return strndup(token->start, token->length);
+}
+
+void token_copy(const Token *token, char *buffer, int size)
+{
+    int length = token->length < size - 1 ? token->length : size - 1;
+    memcpy(buffer, token->start, length);
+    buffer[length] = '\0';
+}
+
+int token_to_int(const Token *token)
+{
+    int sign = 1;
+    int i = 0;
+    int value = 0;
+    if (token->length > 0 && token->start[0] == '-')
+    {
+        sign = -1;
+        i++;
+    }
+    for (; i < token->length && isdigit((unsigned char)token->start[i]); i++)
+    {
+        value = value * 10 + (token->start[i] - '0');
+    }
+    return sign * value;
+}
+
+int parse_insert_query(Token *tokens, int token_count, int *iterator, InsertQuery *query)
 {
     if (!is_db_loaded())
     {
@@ -436,14 +456,15 @@ int parse_insert(Token *tokens, int token_count, int *iterator)
         return -1;
     }
 
-    Table *target_table = get_table(tokens[*iterator].token);
-    (*iterator)++;
-
-    if (target_table == NULL)
+    char table_name[MAX_TOKEN_LENGTH];
+    token_copy(&tokens[*iterator], table_name, sizeof(table_name));
+    query->table = get_table(table_name);
+    if (query->table == NULL)
     {
-        printf("Error: Table %s does not exist\n", tokens[*iterator].token);
+        printf("Error: Table %s does not exist\n", table_name);
         return -1;
     }
+    (*iterator)++;
 
     // check for VALUES
     if (tokens[(*iterator)++].type != TOKEN_VALUES)
@@ -459,19 +480,8 @@ int parse_insert(Token *tokens, int token_count, int *iterator)
         return -1;
     }
 
-    // get values
-    void *values[target_table->columns_count];
-    int *int_values = malloc(sizeof(int) * target_table->columns_count);
-    char **string_values = malloc(sizeof(char *) * target_table->columns_count);
-    if (!int_values || !string_values)
-    {
-        printf("Error: Memory allocation failed\n");
-        free(int_values);
-        free(string_values);
-        return -1;
-    }
-
-    for (int i = 0; i < target_table->columns_count; i++)
+    // get values, placeholders are type checked when they are bound
+    for (int i = 0; i < query->table->columns_count; i++)
     {
         if (token_count <= *iterator)
         {
@@ -483,123 +493,255 @@ int parse_insert(Token *tokens, int token_count, int *iterator)
             if (tokens[(*iterator)++].type != TOKEN_COMMA)
             {
                 printf("Error: Expected comma\n");
-                free(int_values);
-                free(string_values);
                 return -1;
             }
         }
-        switch (target_table->columns[i].type)
+        if (tokens[*iterator].type != TOKEN_PARAMETER)
         {
-        case INT:
-            if (tokens[*iterator].type != TOKEN_NUMBER)
+            switch (query->table->columns[i].type)
             {
-                printf("Error: Expected number for column %s\n", target_table->columns[i].name);
-                free(int_values);
-                free(string_values);
-                return -1;
-            }
-            int_values[i] = atoi(tokens[(*iterator)++].token);
-            values[i] = &int_values[i];
-            break;
+            case INT:
+                if (tokens[*iterator].type != TOKEN_NUMBER)
+                {
+                    printf("Error: Expected number for column %s\n", query->table->columns[i].name);
+                    return -1;
+                }
+                break;
 
-        case STRING:
-            if (tokens[*iterator].type != TOKEN_STRING)
-            {
-                printf("Error: Expected string for column %s\n", target_table->columns[i].name);
-                free(int_values);
-                free(string_values);
-                return -1;
-            }
-            string_values[i] = strdup(tokens[(*iterator)++].token);
-            if (!string_values[i])
-            {
-                printf("Error: Memory allocation failed\n");
-                free(int_values);
-                free(string_values);
-                return -1;
+            case STRING:
+            case VARCHAR:
+                if (tokens[*iterator].type != TOKEN_STRING)
+                {
+                    printf("Error: Expected string for column %s\n", query->table->columns[i].name);
+                    return -1;
+                }
+                break;
             }
-            values[i] = string_values[i];
-            break;
         }
+        query->values[i] = &tokens[(*iterator)++];
     }
 
     // Check for the closing parenthesis
     if (tokens[(*iterator)++].type != TOKEN_CLOSE_PARENTHESIS)
     {
         printf("Error: Expected closing parenthesis\n");
-        free(int_values);
-        free(string_values);
         return -1;
     }
     // Check for the semicolon
     if (tokens[(*iterator)++].type != TOKEN_SEMICOLON)
     {
         printf("Error: Expected semicolon\n");
-        free(int_values);
-        free(string_values);
         return -1;
     }
+    return 0;
+}
+
+int run_insert_query(const InsertQuery *query, const Token parameters[])
+{
+    void *values[MAX_COLUMN_COUNT];
+    int int_values[MAX_COLUMN_COUNT];
+    char strings[query->table->row_size_in_bytes]; // NUL-terminated copies, each string column fits in its row slot
+    int string_offset = 0;
+
+    for (int i = 0; i < query->table->columns_count; i++)
+    {
+        const Token *value = query->values[i];
+        if (value->type == TOKEN_PARAMETER)
+        {
+            if (parameters == NULL)
+            {
+                printf("Error: Parameter placeholders are only allowed in prepared statements\n");
+                return -1;
+            }
+            value = &parameters[value->parameter];
+        }
+        switch (query->table->columns[i].type)
+        {
+        case INT:
+            if (value->type != TOKEN_NUMBER)
+            {
+                printf("Error: Expected number for column %s\n", query->table->columns[i].name);
+                return -1;
+            }
+            int_values[i] = token_to_int(value);
+            values[i] = &int_values[i];
+            break;
+
+        case STRING:
+        case VARCHAR:
+            if (value->type != TOKEN_STRING)
+            {
+                printf("Error: Expected string for column %s\n", query->table->columns[i].name);
+                return -1;
+            }
+            token_copy(value, &strings[string_offset], query->table->columns[i].lenght + 1);
+            values[i] = &strings[string_offset];
+            string_offset += query->table->columns[i].lenght + 1;
+            break;
+        }
+    }
+
     // Insert the record into the table
-    if (insert_record_array(target_table, values) != 0)
+    if (insert_record_array(query->table, values) != 0)
     {
         printf("Error: Failed to insert record into table\n");
-        free(int_values);
-        free(string_values);
         return -1;
     }
+    return 0;
+}
 
-    for (int i = 0; i < target_table->columns_count; i++)
+int parse_insert(Token *tokens, int token_count, int *iterator)
+{
+    InsertQuery query;
+    if (parse_insert_query(tokens, token_count, iterator, &query) != 0)
     {
-        if (target_table->columns[i].type == STRING && string_values[i])
-        {
-            free(string_values[i]);
-        }
+        return -1;
     }
-    free(int_values);
-    free(string_values);
+    return run_insert_query(&query, NULL);
+}
 
-    return 0;
+// Count the rows of an index-only count plan from the row count of the table or a probe of its primary key index
+static int execute_index_only_count(QueryPlan *plan, Table *tables[], char *alias[], int *match_count)
+{
+    Table *table = tables[0];
+    plan->analyze = get_explain_mode() == EXPLAIN_ANALYZE;
+    memset(plan->stats, 0, sizeof(plan->stats));
+    double start = get_time_ms();
+    long count = table->record_size;
+    if (plan->access[0].method == ACCESS_HASH_LOOKUP)
+    {
+        // The key expression references no columns, there is no row to evaluate it on
+        char *rows[1] = {NULL};
+        Key key;
+        memset(&key, 0, sizeof(Key));
+        key.int_key = evaluate_expression(plan->access[0].key, tables, alias, rows, 1);
+        plan->stats[0].index_probes++;
+        count = find_right_entry_in_bucket(table->hash, key, hash_int_key(table, key.int_key)) ? 1 : 0;
+    }
+    plan->stats[0].loops = 1;
+    plan->stats[0].rows_out = count;
+    int result = add_counted_rows(plan->aggregate, count);
+    *match_count = (int)count;
+    plan->stats[0].time_ms = get_time_ms() - start;
+    plan->total_time_ms = plan->stats[0].time_ms;
+    plan->match_count = *match_count;
+    if (plan->analyze)
+    {
+        print_query_plan(plan, tables, alias);
+    }
+    return result;
 }
 
-int parse_where(Token *tokens, int token_count, int *iterator, Table *tables[], char *alias[], int table_count, long return_positions[][table_count], int *match_count)
+int execute_query_plan(QueryPlan *plan, Table *tables[], char *alias[], int table_count, long return_positions[][table_count], int *match_count)
 {
-    FILE *files[table_count];
+    ExplainMode mode = get_explain_mode();
+    if (mode == EXPLAIN_PLAN)
+    {
+        print_query_plan(plan, tables, alias);
+        return 0;
+    }
+    if (is_index_only_count(plan))
+    {
+        return execute_index_only_count(plan, tables, alias, match_count);
+    }
+
+    // Columnar tables only read the columns the WHERE expression references, compressed tables leave the
+    // columns it only compares on dictionary codes undecoded
+    TableStorage storages[table_count];
     char *rows[table_count];
     for (int i = 0; i < table_count; i++)
     {
-        files[i] = open_file(tables[i]->table_name, "bin", "rb");
         rows[i] = calloc(tables[i]->row_size_in_bytes, sizeof(char));
+        if (!rows[i] || open_table_storage(&storages[i], tables[i], "rb", plan->used_columns[i]) != 0)
+        {
+            printf("Error: Could not prepare table %s for scanning\n", tables[i]->table_name);
+            free(rows[i]);
+            for (int j = 0; j < i; j++)
+            {
+                close_table_storage(&storages[j]);
+                free(rows[j]);
+            }
+            return -1;
+        }
+    }
+
+    resolve_conjunct_literals(plan, tables);
+    plan->analyze = mode == EXPLAIN_ANALYZE;
+    memset(plan->stats, 0, sizeof(plan->stats));
+    double start = get_time_ms();
+    nested_loop_join(plan, tables, alias, storages, table_count, rows, 0, return_positions, match_count /*, columns, column_alias, column_count*/);
+    plan->total_time_ms = get_time_ms() - start;
+    plan->match_count = *match_count;
+    if (plan->analyze)
+    {
+        print_query_plan(plan, tables, alias);
+    }
+
+    for (int i = 0; i < table_count; i++)
+    {
+        free(rows[i]);
+        close_table_storage(&storages[i]);
+    }
+    return 0;
+}
+
+int execute_where_expression(Expression *expr, Table *tables[], char *alias[], int table_count, PositionList *matches, int *match_count)
+{
+    QueryPlan plan;
+    if (build_query_plan(&plan, expr, tables, alias, table_count) != 0)
+    {
+        return -1;
+    }
+    plan.matches = matches;
+    if (execute_query_plan(&plan, tables, alias, table_count, NULL, match_count) != 0)
+    {
+        return -1;
     }
+    if (matches->failed)
+    {
+        printf("Error: Memory allocation failed\n");
+        return -1;
+    }
+    return 0;
+}
 
+int parse_where(Token *tokens, int token_count, int *iterator, Table *tables[], char *alias[], int table_count, PositionList *matches, int *match_count)
+{
+    int result = 0;
     Expression *expr = parse_expression(tokens, iterator, token_count);
     if (tokens[*iterator].type == TOKEN_SEMICOLON)
     {
-        nested_loop_join(expr, tables, alias, files, table_count, rows, 0, return_positions, match_count /*, columns, column_alias, column_count*/);
-        if (match_count == 0)
-        {
-            printf("No matching records found\n");
-            return -1;
-        }
-        else
-        {
-            for (int i = 0; i < table_count; i++)
-            {
-                free(rows[i]);
-                fclose(files[i]);
-            }
-            return 0;
-        }
+        result = execute_where_expression(expr, tables, alias, table_count, matches, match_count);
     }
     else
     {
         printf("Error: Expected semicolon after WHERE clause\n");
-        for (int i = 0; i < table_count; i++)
-        {
-            free(rows[i]);
-            fclose(files[i]);
-        }
-        return -1;
+        result = -1;
     }
+
+    free_expression(expr);
+    return result;
+}
+
+// Whether GROUP BY, ORDER BY, LIMIT or OFFSET starts at tokens[i]. They are not keywords, so tables and columns
+// can still be named after them
+static int at_clause(const Token *tokens, int i, const char *clause)
+{
+    if (tokens[i].type != TOKEN_IDENTIFIER || !token_equals(&tokens[i], clause))
+    {
+        return 0;
+    }
+    if (strcmp(clause, "LIMIT") == 0 || strcmp(clause, "OFFSET") == 0)
+    {
+        return tokens[i + 1].type == TOKEN_NUMBER;
+    }
+    return tokens[i + 1].type == TOKEN_IDENTIFIER && token_equals(&tokens[i + 1], "BY");
+}
+
+static int at_any_clause(const Token *tokens, int i)
+{
+    return at_clause(tokens, i, "GROUP") || at_clause(tokens, i, "ORDER") || at_clause(tokens, i, "LIMIT") ||
+           at_clause(tokens, i, "OFFSET");
 }
 
 int parse_join(Token *tokens, int token_count, int *iterator, Table *tables[], char *alias[], int *table_count, int *total_record_size)
@@ -633,11 +775,13 @@ int parse_join(Token *tokens, int token_count, int *iterator, Table *tables[], c
             }
             return -1;
         }
-        tables[*table_count] = get_table(tokens[*iterator].token);
+        char table_name[MAX_TOKEN_LENGTH];
+        token_copy(&tokens[*iterator], table_name, sizeof(table_name));
+        tables[*table_count] = get_table(table_name);
 
         if (tables[*table_count] == NULL)
         {
-            printf("Error: Table %s does not exist\n", tokens[*iterator].token);
+            printf("Error: Table %s does not exist\n", table_name);
             for (int i = 0; i < *table_count; i++)
             {
                 free(alias[i]);
@@ -646,9 +790,9 @@ int parse_join(Token *tokens, int token_count, int *iterator, Table *tables[], c
         }
         *total_record_size *= tables[*table_count]->record_size;
         (*iterator)++;
-        if (tokens[*iterator].type == TOKEN_IDENTIFIER)
+        if (tokens[*iterator].type == TOKEN_IDENTIFIER && !at_any_clause(tokens, *iterator))
         {
-            alias[*table_count] = strdup(tokens[*iterator].token);
+            alias[*table_count] = token_strdup(&tokens[*iterator]);
             (*iterator)++;
         }
         else
@@ -662,7 +806,8 @@ int parse_join(Token *tokens, int token_count, int *iterator, Table *tables[], c
             (*iterator)++;
             continue;
         }
-        else if (tokens[*iterator].type == TOKEN_WHERE || tokens[*iterator].type == TOKEN_EOF || tokens[*iterator].type == TOKEN_SEMICOLON)
+        else if (tokens[*iterator].type == TOKEN_WHERE || tokens[*iterator].type == TOKEN_EOF || tokens[*iterator].type == TOKEN_SEMICOLON ||
+                 at_any_clause(tokens, *iterator))
         {
             break;
         }
@@ -694,21 +839,160 @@ int parse_join(Token *tokens, int token_count, int *iterator, Table *tables[], c
     return 0;
 }
 
-int parse_select(Token *tokens, int token_count, int *iterator)
+void free_select_query(SelectQuery *query)
+{
+    for (int i = 0; i < query->column_count; i++)
+    {
+        free(query->column_names[i]);
+        free(query->column_alias[i]);
+    }
+    for (int i = 0; i < query->aggregate_count; i++)
+    {
+        if (query->aggregates[i].argument)
+        {
+            free_expression(query->aggregates[i].argument);
+        }
+    }
+    for (int i = 0; i < query->group_count; i++)
+    {
+        free(query->group_names[i]);
+        free(query->group_alias[i]);
+    }
+    for (int i = 0; i < query->order_count; i++)
+    {
+        free(query->order_names[i]);
+        free(query->order_alias[i]);
+    }
+    for (int i = 0; i < query->table_count; i++)
+    {
+        free(query->alias[i]);
+    }
+    if (query->where)
+    {
+        free_expression(query->where);
+    }
+    query->column_count = 0;
+    query->aggregate_count = 0;
+    query->group_count = 0;
+    query->order_count = 0;
+    query->table_count = 0;
+    query->where = NULL;
+}
+
+// Parse COUNT(*) or a function over an INT expression, the iterator is at the function name
+static int parse_aggregate(Token *tokens, int token_count, int *iterator, Aggregate *aggregate)
+{
+    aggregate->function = parse_aggregate_function(tokens[*iterator].start, tokens[*iterator].length);
+    aggregate->argument = NULL;
+    (*iterator) += 2; // skip (
+    if (aggregate->function == AGGREGATE_COUNT && tokens[*iterator].type == TOKEN_STAR)
+    {
+        (*iterator)++;
+    }
+    else
+    {
+        aggregate->argument = parse_expression(tokens, iterator, token_count);
+        if (aggregate->argument == NULL)
+        {
+            printf("Error: Invalid argument of %s\n", aggregate_function_name(aggregate->function));
+            return -1;
+        }
+    }
+    if (tokens[*iterator].type != TOKEN_CLOSE_PARENTHESIS)
+    {
+        printf("Error: Expected closing parenthesis after argument of %s\n", aggregate_function_name(aggregate->function));
+        if (aggregate->argument)
+        {
+            free_expression(aggregate->argument);
+            aggregate->argument = NULL;
+        }
+        return -1;
+    }
+    (*iterator)++;
+    return 0;
+}
+
+// Parse the column list of GROUP BY, the iterator is after BY
+static int parse_group_by(Token *tokens, int *iterator, SelectQuery *query)
+{
+    while (1)
+    {
+        if (tokens[*iterator].type != TOKEN_IDENTIFIER)
+        {
+            printf("Error: Expected column name in GROUP BY\n");
+            return -1;
+        }
+        if (query->group_count == MAX_COLUMN_COUNT)
+        {
+            printf("Error: Exceeded max number of GROUP BY columns: %d\n", MAX_COLUMN_COUNT);
+            return -1;
+        }
+        query->group_alias[query->group_count] = token_strdup(&tokens[*iterator]);
+        if (tokens[*iterator + 1].type == TOKEN_DOT && tokens[*iterator + 2].type == TOKEN_IDENTIFIER)
+        {
+            (*iterator) += 2;
+        }
+        query->group_names[query->group_count] = token_strdup(&tokens[*iterator]);
+        query->group_count++;
+        (*iterator)++;
+        if (tokens[*iterator].type != TOKEN_COMMA)
+        {
+            return 0;
+        }
+        (*iterator)++;
+    }
+}
+
+// Parse the column list of ORDER BY, each column optionally followed by ASC or DESC, the iterator is after BY
+static int parse_order_by(Token *tokens, int *iterator, SelectQuery *query)
+{
+    while (1)
+    {
+        if (tokens[*iterator].type != TOKEN_IDENTIFIER)
+        {
+            printf("Error: Expected column name in ORDER BY\n");
+            return -1;
+        }
+        if (query->order_count == MAX_COLUMN_COUNT)
+        {
+            printf("Error: Exceeded max number of ORDER BY columns: %d\n", MAX_COLUMN_COUNT);
+            return -1;
+        }
+        query->order_alias[query->order_count] = token_strdup(&tokens[*iterator]);
+        if (tokens[*iterator + 1].type == TOKEN_DOT && tokens[*iterator + 2].type == TOKEN_IDENTIFIER)
+        {
+            (*iterator) += 2;
+        }
+        query->order_names[query->order_count] = token_strdup(&tokens[*iterator]);
+        (*iterator)++;
+        if (tokens[*iterator].type == TOKEN_IDENTIFIER &&
+            (token_equals(&tokens[*iterator], "ASC") || token_equals(&tokens[*iterator], "DESC")))
+        {
+            query->order_descending[query->order_count] = token_equals(&tokens[*iterator], "DESC");
+            (*iterator)++;
+        }
+        query->order_count++;
+        if (tokens[*iterator].type != TOKEN_COMMA)
+        {
+            return 0;
+        }
+        (*iterator)++;
+    }
+}
+
+int parse_select_query(Token *tokens, int token_count, int *iterator, SelectQuery *query)
 {
+    memset(query, 0, sizeof(SelectQuery));
+    query->limit = -1;
     if (!is_db_loaded())
     {
         printf("Error: No database is loaded, please load a database first\n");
         return -1;
     }
-    int all = 0;
-    char *column_names[MAX_COLUMN_COUNT];
-    char *column_alias[MAX_COLUMN_COUNT];
-    int column_count = 0;
     // Check for columns
     if (tokens[(*iterator)].type == TOKEN_STAR)
     {
-        all = 1;
+        query->all = 1;
         (*iterator)++;
     }
     else if (tokens[*iterator].type == TOKEN_IDENTIFIER)
@@ -716,69 +1000,64 @@ int parse_select(Token *tokens, int token_count, int *iterator)
 
         while (1)
         {
-            if (tokens[*iterator].type == TOKEN_IDENTIFIER)
+            if (tokens[*iterator].type != TOKEN_IDENTIFIER)
             {
-                if (tokens[*iterator + 1].type == TOKEN_DOT)
-                {
-                    if (tokens[*iterator + 2].type != TOKEN_IDENTIFIER)
-                    {
-                        printf("Error: Invalid syntax on select\n");
-                    }
-                    else
-                    {
-                        column_alias[column_count] = strdup(tokens[*iterator].token);
-                        (*iterator) += 2; // skip .
-                        column_names[column_count] = strdup(tokens[*iterator].token);
-                        (*iterator)++;
-                    }
-                }
-                else
-                {
-                    column_alias[column_count] = strdup(tokens[*iterator].token);
-                    column_names[column_count] = strdup(tokens[*iterator].token);
-                    (*iterator)++;
-                }
-                column_count++;
-                if (tokens[*iterator].type == TOKEN_COMMA)
-                {
-                    (*iterator)++;
-                    continue;
-                }
-                else if (tokens[*iterator].type == TOKEN_FROM)
+                printf("Error: Expected column name\n");
+                free_select_query(query);
+                return -1;
+            }
+            if (query->column_count == MAX_COLUMN_COUNT)
+            {
+                printf("Error: Exceeded max number of selected columns: %d\n", MAX_COLUMN_COUNT);
+                free_select_query(query);
+                return -1;
+            }
+            query->item_aggregate[query->column_count] = -1;
+            if (tokens[*iterator + 1].type == TOKEN_OPEN_PARENTHESIS &&
+                parse_aggregate_function(tokens[*iterator].start, tokens[*iterator].length) >= 0)
+            {
+                if (parse_aggregate(tokens, token_count, iterator, &query->aggregates[query->aggregate_count]) != 0)
                 {
-                    break;
+                    free_select_query(query);
+                    return -1;
                 }
-                else
+                query->item_aggregate[query->column_count] = query->aggregate_count++;
+            }
+            else if (tokens[*iterator + 1].type == TOKEN_DOT)
+            {
+                if (tokens[*iterator + 2].type != TOKEN_IDENTIFIER)
                 {
-                    printf("Error: Expected FROM or comma after column name\n");
-                    for (int i = 0; i < column_count; i++)
-                    {
-                        free(column_names[i]);
-                        free(column_alias[i]);
-                    }
+                    printf("Error: Invalid syntax on select\n");
+                    free_select_query(query);
                     return -1;
                 }
+                query->column_alias[query->column_count] = token_strdup(&tokens[*iterator]);
+                (*iterator) += 2; // skip .
+                query->column_names[query->column_count] = token_strdup(&tokens[*iterator]);
+                (*iterator)++;
             }
             else
             {
-                printf("Error: Expected column name\n");
-                for (int i = 0; i < column_count; i++)
-                {
-                    free(column_names[i]);
-                    free(column_alias[i]);
-                }
-                return -1;
+                query->column_alias[query->column_count] = token_strdup(&tokens[*iterator]);
+                query->column_names[query->column_count] = token_strdup(&tokens[*iterator]);
+                (*iterator)++;
             }
-        }
-        if (column_count == 0)
-        {
-            printf("Error: No columns specified\n If you want to select all columns, use '*'\n");
-            for (int i = 0; i < column_count; i++)
+            query->column_count++;
+            if (tokens[*iterator].type == TOKEN_COMMA)
             {
-                free(column_names[i]);
-                free(column_alias[i]);
+                (*iterator)++;
+                continue;
+            }
+            else if (tokens[*iterator].type == TOKEN_FROM)
+            {
+                break;
+            }
+            else
+            {
+                printf("Error: Expected FROM or comma after column name\n");
+                free_select_query(query);
+                return -1;
             }
-            return -1;
         }
     }
     else
@@ -790,154 +1069,344 @@ int parse_select(Token *tokens, int token_count, int *iterator)
     if (tokens[*iterator].type != TOKEN_FROM)
     {
         printf("Error: Expected FROM keyword\n");
-        for (int i = 0; i < column_count; i++)
-        {
-            free(column_names[i]);
-            free(column_alias[i]);
-        }
+        free_select_query(query);
         return -1;
     }
     (*iterator)++;
 
     // Check for tables
-    Table *tables[MAX_JOIN_COUNT];
-    char *alias[MAX_JOIN_COUNT];
-    int table_count = 0;
     int total_record_size = 1;
-
-    if (parse_join(tokens, token_count, iterator, tables, alias, &table_count, &total_record_size) != 0)
+    if (parse_join(tokens, token_count, iterator, query->tables, query->alias, &query->table_count, &total_record_size) != 0)
     {
-        for (int i = 0; i < column_count; i++)
-        {
-            free(column_names[i]);
-            free(column_alias[i]);
-        }
+        query->table_count = 0; // parse_join already freed the aliases
+        free_select_query(query);
         return -1;
     }
 
-    Column *columns[column_count];
-    for (int i = 0; i < column_count; i++)
+    for (int i = 0; i < query->column_count; i++)
     {
+        if (query->item_aggregate[i] >= 0)
+        {
+            continue;
+        }
         int check = 0;
-        for (int j = 0; j < table_count; j++)
+        for (int j = 0; j < query->table_count; j++)
         {
-            if (check_column_exists_by_name(tables[j], column_names[i]))
+            if (check_column_exists_by_name(query->tables[j], query->column_names[i]))
             {
-                columns[i] = get_column(tables[j], column_names[i]);
                 check++;
-                if (check > 1)
-                {
-                    if (strcmp(column_alias[i], column_names[i]) == 0)
-                    {
-                        printf("Error: Column %s exists in more than one table, give specifications\n", column_names[i]);
-                        for (int i = 0; i < column_count; i++)
-                        {
-                            free(column_names[i]);
-                            free(column_alias[i]);
-                            free(columns[i]);
-                        }
-                        for (int i = 0; i < table_count; i++)
-                        {
-                            free(alias[i]);
-                        }
-                        return -1;
-                    }
-                }
             }
         }
+        if (check > 1 && strcmp(query->column_alias[i], query->column_names[i]) == 0)
+        {
+            printf("Error: Column %s exists in more than one table, give specifications\n", query->column_names[i]);
+            free_select_query(query);
+            return -1;
+        }
         if (!check)
         {
-            printf("Error: Column %s does not exist in given tables\n", column_names[i]);
-            for (int i = 0; i < column_count; i++)
-            {
-                free(column_names[i]);
-                free(column_alias[i]);
-                free(columns[i]);
-            }
-            for (int i = 0; i < table_count; i++)
-            {
-                free(alias[i]);
-            }
+            printf("Error: Column %s does not exist in given tables\n", query->column_names[i]);
+            free_select_query(query);
             return -1;
         }
     }
 
-    long return_positions[total_record_size][table_count];
-    int match_count = 0;
-
-    // // Check for WHERE keyword
+    // Check for WHERE keyword
     if (tokens[*iterator].type == TOKEN_WHERE)
     {
         (*iterator)++;
-        parse_where(tokens, token_count, iterator, tables, alias, table_count, return_positions, &match_count);
-        if (match_count == 0)
+        query->where = parse_expression(tokens, iterator, token_count);
+        if (query->where == NULL)
         {
-            printf("No matching records found\n");
-            for (int i = 0; i < column_count; i++)
-            {
-                free(column_names[i]);
-                free(column_alias[i]);
-            }
-            for (int i = 0; i < table_count; i++)
-            {
-                free(alias[i]);
-            }
-            return 0;
+            printf("Error: Invalid expression in WHERE clause\n");
+            free_select_query(query);
+            return -1;
         }
-        // print positions
-        for (int i = 0; i < match_count; i++)
+    }
+    if (at_clause(tokens, *iterator, "GROUP"))
+    {
+        (*iterator) += 2;
+        if (parse_group_by(tokens, iterator, query) != 0)
         {
-            for (int j = 0; j < table_count; j++)
-            {
-                printf("%ld, ", return_positions[i][j]);
-            }
-            printf("\n");
+            free_select_query(query);
+            return -1;
         }
-        for (int i = 0; i < column_count; i++)
+    }
+    if (at_clause(tokens, *iterator, "ORDER"))
+    {
+        (*iterator) += 2;
+        if (parse_order_by(tokens, iterator, query) != 0)
         {
-            free(column_names[i]);
-            free(column_alias[i]);
+            free_select_query(query);
+            return -1;
         }
-        for (int i = 0; i < table_count; i++)
+    }
+    if (at_clause(tokens, *iterator, "LIMIT"))
+    {
+        query->limit = token_to_int(&tokens[*iterator + 1]);
+        if (query->limit < 0)
         {
-            free(alias[i]);
+            printf("Error: LIMIT must not be negative\n");
+            free_select_query(query);
+            return -1;
+        }
+        (*iterator) += 2;
+    }
+    if (at_clause(tokens, *iterator, "OFFSET"))
+    {
+        query->offset = token_to_int(&tokens[*iterator + 1]);
+        if (query->offset < 0)
+        {
+            printf("Error: OFFSET must not be negative\n");
+            free_select_query(query);
+            return -1;
         }
-        return 0; // TODO: when printing functions are ready this will be deleted
+        (*iterator) += 2;
+    }
+    if (query->order_count > 0 && (query->aggregate_count > 0 || query->group_count > 0))
+    {
+        printf("Error: ORDER BY is not supported with aggregates\n");
+        free_select_query(query);
+        return -1;
+    }
+    // check semicolon
+    if (tokens[*iterator].type != TOKEN_SEMICOLON)
+    {
+        printf(query->where ? "Error: Expected semicolon after WHERE clause\n" : "Error: Expected WHERE or semicolon\n");
+        free_select_query(query);
+        return -1;
+    }
+    return 0;
+}
 
-        if (all == 0)
+// Fold the matching rows into groups and print one line per group
+static int execute_aggregate_select(SelectQuery *query, QueryPlan *plan, FILE *out)
+{
+    GroupTable groups;
+    if (init_group_table(&groups, query) != 0)
+    {
+        free_group_table(&groups);
+        return -1;
+    }
+    QueryPlan local_plan;
+    if (!plan)
+    {
+        if (build_query_plan(&local_plan, query->where, query->tables, query->alias, query->table_count) != 0)
         {
+            free_group_table(&groups);
+            return -1;
         }
-        else
+        plan = &local_plan;
+    }
+    mark_group_columns(&groups, plan);
+    plan->aggregate = &groups;
+    int match_count = 0;
+    int result = execute_query_plan(plan, query->tables, query->alias, query->table_count, NULL, &match_count);
+    plan->aggregate = NULL;
+    if (groups.failed)
+    {
+        printf("Error: Could not allocate memory for the groups\n");
+        result = -1;
+    }
+    if (result == 0 && get_explain_mode() == EXPLAIN_NONE)
+    {
+        const char *names[MAX_COLUMN_COUNT];
+        WireType types[MAX_COLUMN_COUNT];
+        ResultWriter writer;
+        describe_groups(&groups, names, types);
+        result = begin_result(&writer, out, query->column_count, names, types);
+        if (result == 0)
         {
-            // print_all_tables_with_where(expr, tables, alias, table_count);
+            print_groups(&groups, &writer);
         }
+        result = end_result(&writer) != 0 ? -1 : result;
     }
+    free_group_table(&groups);
+    return result;
+}
 
-    // check semicolon
-    else if (tokens[*iterator].type == TOKEN_SEMICOLON)
+// Start a result set of joined row positions, one INT64 column per table named by its alias
+static int begin_position_result(ResultWriter *writer, const SelectQuery *query, FILE *out)
+{
+    const char *names[MAX_JOIN_COUNT];
+    WireType types[MAX_JOIN_COUNT];
+    for (int i = 0; i < query->table_count; i++)
     {
-        if (all == 0)
-        {
+        names[i] = query->alias[i];
+        types[i] = WIRE_INT64;
+    }
+    return begin_result(writer, out, query->table_count, names, types);
+}
 
-            // print_joined_tables_without_where(tables, alias, files, table_count, columns, column_alias, column_count);
+// Hand the matching rows to a sorter and print their positions in ORDER BY order
+static int execute_sorted_select(SelectQuery *query, QueryPlan *plan, FILE *out)
+{
+    Sorter sorter;
+    if (init_sorter(&sorter, query) != 0)
+    {
+        free_sorter(&sorter);
+        return -1;
+    }
+    QueryPlan local_plan;
+    if (!plan)
+    {
+        if (build_query_plan(&local_plan, query->where, query->tables, query->alias, query->table_count) != 0)
+        {
+            free_sorter(&sorter);
+            return -1;
         }
-        else
+        plan = &local_plan;
+    }
+    mark_sort_columns(&sorter, plan);
+    plan->sorter = &sorter;
+    int match_count = 0;
+    int result = execute_query_plan(plan, query->tables, query->alias, query->table_count, NULL, &match_count);
+    plan->sorter = NULL;
+    if (sorter.failed)
+    {
+        printf("Error: Could not sort the matching rows\n");
+        result = -1;
+    }
+    if (result == 0 && get_explain_mode() == EXPLAIN_NONE)
+    {
+        ResultWriter writer;
+        result = begin_position_result(&writer, query, out);
+        if (result == 0)
         {
-
-            // print_all_tables_without_where(tables, alias, table_count);
+            result = print_sorted(&sorter, &writer);
         }
-        for (int i = 0; i < column_count; i++)
+        result = end_result(&writer) != 0 ? -1 : result;
+    }
+    free_sorter(&sorter);
+    return result;
+}
+
+// Run the query and print its result rows to out, errors and plans still go to stdout
+static int execute_select(SelectQuery *query, QueryPlan *plan, FILE *out)
+{
+    if (query->aggregate_count > 0 || query->group_count > 0)
+    {
+        return execute_aggregate_select(query, plan, out);
+    }
+    if (query->order_count > 0)
+    {
+        return execute_sorted_select(query, plan, out);
+    }
+    int table_count = query->table_count;
+
+    // With a LIMIT the join stops after the rows the result needs. The matches go to a list that grows with
+    // them, a matrix sized for every combination of rows does not fit on the stack once tables are joined.
+    long row_limit = query->limit >= 0 ? query->limit + query->offset : -1;
+    PositionList matches = {NULL, 0, 0, 0};
+    QueryPlan local_plan;
+    if (!plan)
+    {
+        if (build_query_plan(&local_plan, query->where, query->tables, query->alias, table_count) != 0)
         {
-            free(column_names[i]);
-            free(column_alias[i]);
+            return -1;
         }
-        for (int i = 0; i < table_count; i++)
+        plan = &local_plan;
+    }
+    plan->row_limit = row_limit;
+    plan->matches = &matches;
+    int match_count = 0;
+    int result = execute_query_plan(plan, query->tables, query->alias, table_count, NULL, &match_count);
+    plan->row_limit = -1;
+    plan->matches = NULL;
+    if (result == 0 && matches.failed)
+    {
+        printf("Error: Memory allocation failed\n");
+        result = -1;
+    }
+    if (result != 0 || get_explain_mode() != EXPLAIN_NONE)
+    {
+        free(matches.positions);
+        return result; // Only the plan is reported
+    }
+
+    // print positions, TODO: print the selected columns when printing functions are ready
+    ResultWriter writer;
+    if (begin_position_result(&writer, query, out) != 0)
+    {
+        end_result(&writer);
+        free(matches.positions);
+        return -1;
+    }
+    for (long i = query->offset; i < matches.count; i++)
+    {
+        for (int j = 0; j < table_count; j++)
         {
-            free(alias[i]);
+            write_int64(&writer, matches.positions[i * table_count + j]);
         }
-        return 0;
+        end_row(&writer);
     }
-    return -1;
+    free(matches.positions);
+    return end_result(&writer);
+}
+
+int run_select_query(SelectQuery *query, QueryPlan *plan)
+{
+    return execute_select(query, plan, get_result_stream());
+}
+
+// Run the query with its result rows collected in memory, print them and cache them under key
+static int run_and_cache_select(SelectQuery *query, const char *key, size_t key_length)
+{
+    char *output = NULL;
+    size_t output_length = 0;
+    FILE *out = open_memstream(&output, &output_length);
+    if (!out)
+    {
+        perror("Failed to open result buffer");
+        return run_select_query(query, NULL);
+    }
+    int result = execute_select(query, NULL, out);
+    fclose(out);
+    fwrite(output, 1, output_length, get_result_stream());
+    if (result == 0)
+    {
+        cache_result(key, key_length, query->tables, query->table_count, output, output_length);
+    }
+    free(output);
+    return result;
+}
+
+int parse_select(Token *tokens, int token_count, int *iterator)
+{
+    int start = *iterator - 1; // the SELECT keyword
+    SelectQuery query;
+    if (parse_select_query(tokens, token_count, iterator, &query) != 0)
+    {
+        return -1;
+    }
+    if (get_explain_mode() != EXPLAIN_NONE)
+    {
+        int result = run_select_query(&query, NULL);
+        free_select_query(&query);
+        return result;
+    }
+
+    // A statement seen before is answered from the result cache while its tables are unchanged
+    size_t key_length;
+    char *key = build_result_cache_key(&tokens[start], *iterator - start, &key_length);
+    if (!key)
+    {
+        int result = run_select_query(&query, NULL);
+        free_select_query(&query);
+        return result;
+    }
+    const ResultCacheEntry *cached = find_cached_result(key, key_length, query.tables, query.table_count);
+    int result = 0;
+    if (cached)
+    {
+        fwrite(cached->output, 1, cached->output_length, get_result_stream());
+    }
+    else
+    {
+        result = run_and_cache_select(&query, key, key_length);
+    }
+    free_select_query(&query);
+    return result;
 }
 
 int parse_create(Token *tokens, int token_count, int *iterator)
@@ -955,7 +1424,7 @@ int parse_create(Token *tokens, int token_count, int *iterator)
             printf("Error: Expected table name after CREATE TABLE\n");
             return -1;
         }
-        char *table_name = strdup(tokens[*iterator].token);
+        char *table_name = token_strdup(&tokens[*iterator]);
         (*iterator)++;
 
         // check if table name already exists
@@ -994,7 +1463,7 @@ int parse_create(Token *tokens, int token_count, int *iterator)
 
             if (tokens[*iterator].type == TOKEN_IDENTIFIER)
             {
-                strcpy(columns[column_count].name, tokens[*iterator].token);
+                token_copy(&tokens[*iterator], columns[column_count].name, MAX_NAME_LEN);
                 (*iterator)++;
                 if (tokens[*iterator].type == TOKEN_INT)
                 {
@@ -1002,9 +1471,9 @@ int parse_create(Token *tokens, int token_count, int *iterator)
                     columns[column_count].lenght = 0;
                     (*iterator)++;
                 }
-                else if (tokens[*iterator].type == TOKEN_CHAR)
+                else if (tokens[*iterator].type == TOKEN_CHAR || token_equals(&tokens[*iterator], "varchar"))
                 {
-                    columns[column_count].type = STRING;
+                    columns[column_count].type = tokens[*iterator].type == TOKEN_CHAR ? STRING : VARCHAR;
                     (*iterator)++;
                     if (tokens[*iterator].type != TOKEN_OPEN_PARENTHESIS || tokens[*(iterator) + 1].type != TOKEN_NUMBER)
                     {
@@ -1015,7 +1484,7 @@ int parse_create(Token *tokens, int token_count, int *iterator)
                     else
                     {
                         (*iterator)++;
-                        columns[column_count].lenght = atoi(tokens[*iterator].token);
+                        columns[column_count].lenght = token_to_int(&tokens[*iterator]);
                         if (columns[column_count].lenght <= 0)
                         {
                             printf("Error: Invalid string lenght\n");
@@ -1034,7 +1503,7 @@ int parse_create(Token *tokens, int token_count, int *iterator)
                 }
                 else
                 {
-                    printf("Error: Unknown column type %s\n", tokens[*iterator].token);
+                    printf("Error: Unknown column type %.*s\n", tokens[*iterator].length, tokens[*iterator].start);
                     free(table_name);
                     return -1;
                 }
@@ -1051,7 +1520,7 @@ int parse_create(Token *tokens, int token_count, int *iterator)
                 }
                 for (int i = 0; i < column_count; i++)
                 {
-                    if (strcmp(columns[i].name, tokens[*iterator].token) == 0)
+                    if (token_equals(&tokens[*iterator], columns[i].name))
                     {
                         strcpy(primary_key.name, columns[i].name);
                         primary_key.type = columns[i].type;
@@ -1083,6 +1552,35 @@ int parse_create(Token *tokens, int token_count, int *iterator)
             return -1;
         }
         (*iterator)++;
+
+        // Optional ENGINE = ROW | COLUMNAR | COMPRESSED
+        StorageEngine engine = ENGINE_ROW;
+        if (tokens[*iterator].type == TOKEN_IDENTIFIER && token_equals(&tokens[*iterator], "ENGINE"))
+        {
+            (*iterator)++;
+            if (tokens[*iterator].type != TOKEN_EQ)
+            {
+                printf("Error: Expected '=' after ENGINE\n");
+                free(table_name);
+                return -1;
+            }
+            (*iterator)++;
+            if (token_equals(&tokens[*iterator], "COLUMNAR"))
+            {
+                engine = ENGINE_COLUMNAR;
+            }
+            else if (token_equals(&tokens[*iterator], "COMPRESSED"))
+            {
+                engine = ENGINE_COMPRESSED;
+            }
+            else if (!token_equals(&tokens[*iterator], "ROW"))
+            {
+                printf("Error: Unknown engine, expected ROW, COLUMNAR or COMPRESSED\n");
+                free(table_name);
+                return -1;
+            }
+            (*iterator)++;
+        }
         if (tokens[*iterator].type != TOKEN_SEMICOLON)
         {
             printf("Error: Expected semicolon at the end of CREATE TABLE statement\n");
@@ -1091,7 +1589,7 @@ int parse_create(Token *tokens, int token_count, int *iterator)
         }
         (*iterator)++;
         // Create the table
-        Table *new_table = create_table(table_name, columns, column_count, primary_key);
+        Table *new_table = create_table(table_name, columns, column_count, primary_key, engine);
         if (new_table == NULL)
         {
             printf("Error: Failed to create table\n");
@@ -1122,7 +1620,7 @@ int parse_create(Token *tokens, int token_count, int *iterator)
             printf("Error: Expected database name after CREATE DATABASE\n");
             return -1;
         }
-        char *db_name = strdup(tokens[*iterator].token);
+        char *db_name = token_strdup(&tokens[*iterator]);
         (*iterator)++;
         if (tokens[*iterator].type != TOKEN_SEMICOLON)
         {
@@ -1169,7 +1667,7 @@ int parse_delete(Token *tokens, int token_count, int *iterator)
         printf("Error: Expected table name after FROM\n");
         return -1;
     }
-    char *table_name = strdup(tokens[*iterator].token);
+    char *table_name = token_strdup(&tokens[*iterator]);
     (*iterator)++;
     if (check_table_exist(table_name) == 0)
     {
@@ -1180,56 +1678,29 @@ int parse_delete(Token *tokens, int token_count, int *iterator)
     Table *target_table = get_table(table_name);
     if (target_table == NULL)
     {
-        printf("Error: Table %s does not exist\n", table_name);
-        free(table_name);
-        return -1;
-    }
-    if (tokens[*iterator].type == TOKEN_FROM)
-    {
-        (*iterator)++;
-        Table *tables[MAX_JOIN_COUNT];
-        char *alias[MAX_JOIN_COUNT];
-        int table_count = 0;
-        int total_record_size = 1;
-        int match_count = 0;
-
-        if (parse_join(tokens, token_count, iterator, tables, alias, &table_count, &total_record_size) != 0)
-        {
-            free(table_name);
-            return -1;
-        }
-        long positions[MAX_JOIN_COUNT][table_count];
-
-        // Check for WHERE keyword
-        if (tokens[*iterator].type != TOKEN_WHERE)
-        {
-            printf("Error: Expected WHERE keyword after table name\n");
-            free(table_name);
-            return -1;
-        }
-        (*iterator)++;
-        if (parse_where(tokens, token_count, iterator, tables, alias, table_count, positions, &match_count) != 0)
-        {
-            free(table_name);
-            return -1;
-        }
-        if (match_count == 0)
-        {
-            printf("No matching records found\n");
-            free(table_name);
-            return 0;
-        }
+        printf("Error: Table %s does not exist\n", table_name);
+        free(table_name);
+        return -1;
+    }
+    if (tokens[*iterator].type == TOKEN_FROM)
+    {
+        (*iterator)++;
+        Table *tables[MAX_JOIN_COUNT];
+        char *alias[MAX_JOIN_COUNT];
+        int table_count = 0;
+        int total_record_size = 1;
+        int match_count = 0;
+        // The matches go to a list that grows with them, a matrix sized for every combination of rows does not
+        // fit on the stack once tables are joined
+        PositionList matches = {NULL, 0, 0, 0};
 
-        // semicolon check
-        if (tokens[*iterator].type != TOKEN_SEMICOLON)
+        if (parse_join(tokens, token_count, iterator, tables, alias, &table_count, &total_record_size) != 0)
         {
-            printf("Error: Expected semicolon after WHERE clause\n");
             free(table_name);
             return -1;
         }
-        (*iterator)++;
 
-        int target_index;
+        int target_index = -1;
         for (int i = 0; i < table_count; i++)
         {
             if (target_table == tables[i])
@@ -1237,24 +1708,55 @@ int parse_delete(Token *tokens, int token_count, int *iterator)
                 target_index = i;
             }
         }
-
-        for (int i = 0; i < match_count; i++)
+        int result = 0;
+        if (target_index == -1)
+        {
+            printf("Error: Table %s is not part of the FROM clause\n", table_name);
+            result = -1;
+        }
+        else if (tokens[*iterator].type != TOKEN_WHERE)
+        {
+            printf("Error: Expected WHERE keyword after table name\n");
+            result = -1;
+        }
+        else
         {
-            long position = positions[i][target_index];
-            if (isfree(target_table, position))
+            (*iterator)++;
+            if (parse_where(tokens, token_count, iterator, tables, alias, table_count, &matches, &match_count) != 0)
             {
-                // printf("Record at position %ld is already deleted\n", position);
-                continue;
+                result = -1;
             }
-            if (delete_record_by_row_position(target_table, position) != 0)
+            else if (match_count == 0)
             {
-                printf("Error: Failed to delete record at position %ld\n", position);
-                free(table_name);
-                return -1;
+                printf("No matching records found\n");
+            }
+            else
+            {
+                // A row of the target can match several joined rows, delete_records drops the duplicates
+                long *targets = malloc(sizeof(long) * match_count);
+                if (!targets)
+                {
+                    printf("Error: Memory allocation failed\n");
+                    result = -1;
+                }
+                else
+                {
+                    for (int i = 0; i < match_count; i++)
+                    {
+                        targets[i] = matches.positions[(long)i * table_count + target_index];
+                    }
+                    result = delete_records(target_table, targets, match_count) < 0 ? -1 : 0;
+                    free(targets);
+                }
             }
         }
+        free(matches.positions);
         free(table_name);
-        return 0;
+        for (int i = 0; i < table_count; i++)
+        {
+            free(alias[i]);
+        }
+        return result;
     }
     else if (tokens[*iterator].type != TOKEN_WHERE)
     {
@@ -1269,45 +1771,27 @@ int parse_delete(Token *tokens, int token_count, int *iterator)
     tables[0] = target_table;
     alias[0] = strdup(target_table->table_name);
     int table_count = 1;
-    long positions[target_table->record_size][1];
+    PositionList matches = {NULL, 0, 0, 0};
     int match_count = 0;
 
-    if (parse_where(tokens, token_count, iterator, tables, alias, table_count, positions, &match_count) != 0)
+    int result = 0;
+    if (parse_where(tokens, token_count, iterator, tables, alias, table_count, &matches, &match_count) != 0)
     {
-        free(table_name);
-        return -1;
+        result = -1;
     }
-
-    if (match_count == 0)
+    else if (match_count == 0)
     {
         printf("No matching records found\n");
-        free(table_name);
-        return 0;
     }
-
-    // semicolon check
-    if (tokens[*iterator].type != TOKEN_SEMICOLON)
-    {
-        printf("Error: Expected semicolon after WHERE clause\n");
-        free(table_name);
-        return -1;
-    }
-    (*iterator)++;
-
-    // Delete the records
-    for (int i = 0; i < match_count; i++)
+    else
     {
-        long position = positions[i][0];
-        if (delete_record_by_row_position(target_table, position) != 0)
-        {
-            printf("Error: Failed to delete record at position %ld\n", position);
-            free(table_name);
-            return -1;
-        }
+        // A single table is matched, so the list holds one position per row
+        result = delete_records(target_table, matches.positions, match_count) < 0 ? -1 : 0;
     }
+    free(matches.positions);
     free(table_name);
     free(alias[0]);
-    return 0;
+    return result;
 }
 
 int parse_update(Token *tokens, int token_count, int *iterator)
@@ -1327,7 +1811,7 @@ int parse_update(Token *tokens, int token_count, int *iterator)
         printf("Error: Expected table name after UPDATE\n");
         return -1;
     }
-    char *table_name = strdup(tokens[*iterator].token);
+    char *table_name = token_strdup(&tokens[*iterator]);
     (*iterator)++;
     if (check_table_exist(table_name) == 0)
     {
@@ -1352,11 +1836,12 @@ int parse_update(Token *tokens, int token_count, int *iterator)
     char *column_names[MAX_COLUMN_COUNT];
     int column_count = 0;
     char *values[MAX_COLUMN_COUNT];
+    TokenType value_types[MAX_COLUMN_COUNT];
     while (1)
     {
         if (tokens[*iterator].type == TOKEN_IDENTIFIER)
         {
-            column_names[column_count] = strdup(tokens[*iterator].token);
+            column_names[column_count] = token_strdup(&tokens[*iterator]);
             (*iterator)++;
             if (column_count >= MAX_COLUMN_COUNT)
             {
@@ -1397,7 +1882,8 @@ int parse_update(Token *tokens, int token_count, int *iterator)
                 return -1;
             }
             (*iterator)++;
-            values[column_count] = strdup(tokens[*iterator - 1].token);
+            values[column_count] = token_strdup(&tokens[*iterator - 1]);
+            value_types[column_count] = tokens[*iterator - 1].type;
             column_count++;
             if (tokens[*iterator].type == TOKEN_COMMA)
             {
@@ -1444,12 +1930,14 @@ int parse_update(Token *tokens, int token_count, int *iterator)
         alias[0] = strdup(target_table->table_name);
         int table_count = 1;
         int match_count = 0;
+        PositionList matches = {NULL, 0, 0, 0};
 
-        long positions[target_table->record_size][table_count];
-
-        if (parse_where(tokens, token_count, iterator, tables, alias, table_count, positions, &match_count) != 0)
+        int where_result = parse_where(tokens, token_count, iterator, tables, alias, table_count, &matches, &match_count);
+        free(alias[0]); // Only the WHERE clause refers to the alias
+        if (where_result != 0)
         {
             printf("Error: Failed to parse WHERE clause\n");
+            free(matches.positions);
             free(table_name);
             for (int i = 0; i < column_count; i++)
             {
@@ -1461,6 +1949,7 @@ int parse_update(Token *tokens, int token_count, int *iterator)
         if (match_count == 0)
         {
             printf("No matching records found\n");
+            free(matches.positions);
             free(table_name);
             for (int i = 0; i < column_count; i++)
             {
@@ -1474,6 +1963,7 @@ int parse_update(Token *tokens, int token_count, int *iterator)
         if (tokens[*iterator].type != TOKEN_SEMICOLON)
         {
             printf("Error: Expected semicolon after WHERE clause\n");
+            free(matches.positions);
             free(table_name);
             for (int i = 0; i < column_count; i++)
             {
@@ -1483,22 +1973,41 @@ int parse_update(Token *tokens, int token_count, int *iterator)
             return -1;
         }
         (*iterator)++;
-        Column *columns[column_count];
+
+        int column_indexes[column_count];
+        int int_values[column_count];
+        void *new_values[column_count];
         for (int j = 0; j < column_count; j++)
         {
-            int check = 0;
-            for (int k = 0; k < target_table->columns_count; k++)
+            column_indexes[j] = get_column_index(target_table, column_names[j]);
+            int valid = 1;
+            if (column_indexes[j] < 0)
+            {
+                printf("Error: Column %s does not exist in table %s\n", column_names[j], target_table->table_name);
+                valid = 0;
+            }
+            else if (target_table->columns[column_indexes[j]].type == INT)
             {
-                if (strcmp(target_table->columns[k].name, column_names[j]) == 0)
+                if (value_types[j] != TOKEN_NUMBER)
                 {
-                    columns[j] = &target_table->columns[k];
-                    check++;
-                    break;
+                    printf("Error: Expected number for column %s\n", column_names[j]);
+                    valid = 0;
                 }
+                int_values[j] = atoi(values[j]);
+                new_values[j] = &int_values[j];
             }
-            if (check == 0)
+            else
             {
-                printf("Error: Column %s does not exist in table %s\n", column_names[j], target_table->table_name);
+                if (value_types[j] != TOKEN_STRING)
+                {
+                    printf("Error: Expected string for column %s\n", column_names[j]);
+                    valid = 0;
+                }
+                new_values[j] = values[j];
+            }
+            if (!valid)
+            {
+                free(matches.positions);
                 free(table_name);
                 for (int i = 0; i < column_count; i++)
                 {
@@ -1508,61 +2017,17 @@ int parse_update(Token *tokens, int token_count, int *iterator)
                 return -1;
             }
         }
-        FILE *file = open_file(target_table->table_name, "bin", "rb+");
-        if (file == NULL)
-        {
-            printf("Error: Failed to open table file %s\n", target_table->table_name);
-            free(table_name);
-            for (int i = 0; i < column_count; i++)
-            {
-                free(column_names[i]);
-                free(values[i]);
-            }
-            return -1;
-        }
-        for (int i = 0; i < match_count; i++)
-        {
-            long position = positions[i][0];
-            if (isfree(target_table, position))
-            {
-                // printf("Record at position %ld is already deleted\n", position);
-                continue;
-            }
-            for (int j = 0; j < column_count; j++)
-            {
-                fseek(file, position + calculate_offset(target_table, *columns[j]), SEEK_SET);
-                if (columns[j]->type == INT)
-                {
-                    int value = atoi(values[j]);
-                    fwrite(&value, sizeof(int), 1, file);
-                }
-                else if (columns[j]->type == STRING)
-                {
-                    char *value = values[j];
-                    fwrite(value, sizeof(char), columns[j]->lenght, file);
-                }
-                else
-                {
-                    printf("Error: Unknown column type %d\n", columns[j]->type);
-                    fclose(file);
-                    free(table_name);
-                    for (int i = 0; i < column_count; i++)
-                    {
-                        free(column_names[i]);
-                        free(values[i]);
-                    }
-                    return -1;
-                }
-            }
-        }
-        fclose(file);
+
+        // A single table is matched, so the list holds one position per row
+        int updated = update_records(target_table, matches.positions, match_count, column_indexes, new_values, column_count);
+        free(matches.positions);
         free(table_name);
         for (int i = 0; i < column_count; i++)
         {
             free(column_names[i]);
             free(values[i]);
         }
-        return 0;
+        return updated < 0 ? -1 : 0;
     }
     else
     {
@@ -1611,9 +2076,59 @@ int parse_show(Token *tokens, int token_count, int *iterator)
         list_tables();
         return 0;
     }
+    else if (tokens[*iterator].type == TOKEN_TABLE && tokens[*iterator + 1].type == TOKEN_IDENTIFIER &&
+             token_equals(&tokens[*iterator + 1], "STATUS"))
+    {
+        if (!is_db_loaded())
+        {
+            printf("Error: No database is loaded, please load a database first\n");
+            return -1;
+        }
+        (*iterator) += 2;
+        if (tokens[*iterator].type != TOKEN_SEMICOLON)
+        {
+            printf("Error: Expected semicolon\n");
+            return -1;
+        }
+        (*iterator)++;
+        return list_table_status();
+    }
     return -1;
 }
 
+int parse_set(Token *tokens, int token_count, int *iterator)
+{
+    if (*iterator + 2 >= token_count || tokens[*iterator].type != TOKEN_IDENTIFIER ||
+        !token_equals(&tokens[*iterator], "PROTOCOL") || tokens[*iterator + 1].type != TOKEN_IDENTIFIER)
+    {
+        printf("Error: Expected PROTOCOL TEXT or PROTOCOL BINARY after SET\n");
+        return -1;
+    }
+    Protocol protocol;
+    if (token_equals(&tokens[*iterator + 1], "TEXT"))
+    {
+        protocol = PROTOCOL_TEXT;
+    }
+    else if (token_equals(&tokens[*iterator + 1], "BINARY"))
+    {
+        protocol = PROTOCOL_BINARY;
+    }
+    else
+    {
+        printf("Error: Unknown protocol, expected TEXT or BINARY\n");
+        return -1;
+    }
+    (*iterator) += 2;
+    if (tokens[*iterator].type != TOKEN_SEMICOLON)
+    {
+        printf("Error: Expected semicolon\n");
+        return -1;
+    }
+    (*iterator)++;
+    set_protocol(protocol);
+    return 0;
+}
+
 int parse_load(Token *tokens, int token_count, int *iterator)
 {
     if (is_db_loaded())
@@ -1637,7 +2152,7 @@ int parse_load(Token *tokens, int token_count, int *iterator)
         printf("Error: Expected database name after LOAD DATABASE\n");
         return -1;
     }
-    char *db_name = strdup(tokens[*iterator].token);
+    char *db_name = token_strdup(&tokens[*iterator]);
     (*iterator)++;
     if (tokens[*iterator].type != TOKEN_SEMICOLON)
     {
@@ -1677,7 +2192,7 @@ int parse_drop(Token *tokens, int token_count, int *iterator)
             printf("Error: Expected table name after DROP TABLE\n");
             return -1;
         }
-        char *table_name = strdup(tokens[*iterator].token);
+        char *table_name = token_strdup(&tokens[*iterator]);
         (*iterator)++;
         if (check_table_exist(table_name) == 0)
         {
@@ -1718,7 +2233,7 @@ int parse_drop(Token *tokens, int token_count, int *iterator)
             printf("Error: Expected database name after DROP DATABASE\n");
             return -1;
         }
-        char *db_name = strdup(tokens[*iterator].token);
+        char *db_name = token_strdup(&tokens[*iterator]);
         (*iterator)++;
         if (tokens[*iterator].type != TOKEN_SEMICOLON)
         {
@@ -1742,9 +2257,152 @@ int parse_drop(Token *tokens, int token_count, int *iterator)
     }
 }
 
-int parser(Token *tokens, int token_count)
+int parse_explain(Token *tokens, int token_count, int *iterator)
+{
+    ExplainMode mode = EXPLAIN_PLAN;
+    if (tokens[*iterator].type == TOKEN_ANALYZE)
+    {
+        mode = EXPLAIN_ANALYZE;
+        (*iterator)++;
+    }
+    if (tokens[*iterator].type != TOKEN_SELECT)
+    {
+        printf("Error: EXPLAIN is only supported for SELECT statements\n");
+        return -1;
+    }
+    (*iterator)++;
+
+    set_explain_mode(mode);
+    int result = parse_select(tokens, token_count, iterator);
+    set_explain_mode(EXPLAIN_NONE);
+    return result;
+}
+
+int parse_prepare(Token *tokens, int token_count, int *iterator)
+{
+    if (tokens[*iterator].type != TOKEN_IDENTIFIER)
+    {
+        printf("Error: Expected statement name after PREPARE\n");
+        return -1;
+    }
+    char name[MAX_TOKEN_LENGTH];
+    token_copy(&tokens[*iterator], name, sizeof(name));
+    (*iterator)++;
+    if (tokens[*iterator].type != TOKEN_IDENTIFIER || !token_equals(&tokens[*iterator], "AS"))
+    {
+        printf("Error: Expected AS after statement name\n");
+        return -1;
+    }
+    (*iterator)++;
+
+    // The prepared statement is the rest of the line
+    int end = *iterator;
+    while (end < token_count && tokens[end].type != TOKEN_EOF)
+    {
+        end++;
+    }
+    PreparedStatement *stmt = prepare_tokens(&tokens[*iterator], end - *iterator);
+    *iterator = end;
+    if (stmt == NULL)
+    {
+        return -1;
+    }
+    if (register_prepared_statement(name, stmt) != 0)
+    {
+        free_prepared_statement(stmt);
+        return -1;
+    }
+    return 0;
+}
+
+int parse_execute(Token *tokens, int token_count, int *iterator)
+{
+    if (tokens[*iterator].type != TOKEN_IDENTIFIER)
+    {
+        printf("Error: Expected statement name after EXECUTE\n");
+        return -1;
+    }
+    char name[MAX_TOKEN_LENGTH];
+    token_copy(&tokens[*iterator], name, sizeof(name));
+    PreparedStatement *stmt = get_prepared_statement(name);
+    if (stmt == NULL)
+    {
+        printf("Error: Prepared statement %s does not exist\n", name);
+        return -1;
+    }
+    (*iterator)++;
+
+    int value_count = 0;
+    if (tokens[*iterator].type == TOKEN_OPEN_PARENTHESIS)
+    {
+        (*iterator)++;
+        while (tokens[*iterator].type != TOKEN_CLOSE_PARENTHESIS)
+        {
+            if (value_count > 0)
+            {
+                if (tokens[(*iterator)++].type != TOKEN_COMMA)
+                {
+                    printf("Error: Expected comma\n");
+                    return -1;
+                }
+            }
+            if (*iterator + 1 >= token_count)
+            {
+                printf("Error: Unexpected end of tokens\n");
+                return -1;
+            }
+            if (tokens[*iterator].type == TOKEN_SUB && tokens[*iterator + 1].type == TOKEN_NUMBER)
+            {
+                (*iterator)++;
+                if (bind_parameter_int(stmt, value_count, -token_to_int(&tokens[*iterator])) != 0)
+                {
+                    return -1;
+                }
+            }
+            else if (tokens[*iterator].type == TOKEN_NUMBER || tokens[*iterator].type == TOKEN_STRING)
+            {
+                if (bind_parameter_token(stmt, value_count, &tokens[*iterator]) != 0)
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                printf("Error: Expected number or string as parameter value\n");
+                return -1;
+            }
+            (*iterator)++;
+            value_count++;
+        }
+        (*iterator)++;
+    }
+    if (value_count != stmt->parameter_count)
+    {
+        printf("Error: Prepared statement %s expects %d parameters, got %d\n", stmt->name, stmt->parameter_count, value_count);
+        return -1;
+    }
+    if (tokens[(*iterator)++].type != TOKEN_SEMICOLON)
+    {
+        printf("Error: Expected semicolon\n");
+        return -1;
+    }
+    return execute_prepared_statement(stmt);
+}
+
+static int parse_statements(Token *tokens, int token_count)
 {
     int iterator = 0;
+    if (tokens[0].type != TOKEN_PREPARE)
+    {
+        for (int i = 0; i < token_count; i++)
+        {
+            if (tokens[i].type == TOKEN_PARAMETER)
+            {
+                printf("Error: Parameter placeholders are only allowed in prepared statements\n");
+                return -1;
+            }
+        }
+    }
     while (iterator < token_count)
     {
         switch (tokens[iterator].type)
@@ -1801,7 +2459,7 @@ int parser(Token *tokens, int token_count)
             iterator++;
             if (parse_delete(tokens, token_count, &iterator) == -1)
             {
-                printf("Error: Failed to parse DROP statement\n");
+                printf("Error: Failed to parse DELETE statement\n");
                 return -1;
             }
             break;
@@ -1809,7 +2467,39 @@ int parser(Token *tokens, int token_count)
             iterator++;
             if (parse_update(tokens, token_count, &iterator) == -1)
             {
-                printf("Error: Failed to parse DROP statement\n");
+                printf("Error: Failed to parse UPDATE statement\n");
+                return -1;
+            }
+            break;
+        case TOKEN_PREPARE:
+            iterator++;
+            if (parse_prepare(tokens, token_count, &iterator) == -1)
+            {
+                printf("Error: Failed to parse PREPARE statement\n");
+                return -1;
+            }
+            break;
+        case TOKEN_EXECUTE:
+            iterator++;
+            if (parse_execute(tokens, token_count, &iterator) == -1)
+            {
+                printf("Error: Failed to parse EXECUTE statement\n");
+                return -1;
+            }
+            break;
+        case TOKEN_SET:
+            iterator++;
+            if (parse_set(tokens, token_count, &iterator) == -1)
+            {
+                printf("Error: Failed to parse SET statement\n");
+                return -1;
+            }
+            break;
+        case TOKEN_EXPLAIN:
+            iterator++;
+            if (parse_explain(tokens, token_count, &iterator) == -1)
+            {
+                printf("Error: Failed to parse EXPLAIN statement\n");
                 return -1;
             }
             break;
@@ -1822,4 +2512,15 @@ int parser(Token *tokens, int token_count)
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+
+int parser(Token *tokens, int token_count)
+{
+    // temporaries of the statement live in the query arena; a mark instead of a reset keeps an EXECUTE, which
+    // parses its prepared statement from inside this call, from releasing the caller's memory
+    Arena *arena = get_query_arena();
+    ArenaMark mark = arena_mark(arena);
+    int result = parse_statements(tokens, token_count);
+    arena_release(arena, mark);
+    return result;
+}
@@ -0,0 +1,138 @@
+#include "statistics.h"
+#include "table.h"
+#include "file_io.h"
+#include "storage.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+void init_table_stats(TableStats *stats)
+{
+    memset(stats, 0, sizeof(TableStats));
+}
+
+static void hll_add(ColumnStats *stats, uint32_t hash)
+{
+    int index = hash >> (32 - HLL_REGISTER_BITS);
+    uint32_t rest = hash << HLL_REGISTER_BITS;
+    unsigned char rank = 1;
+    while (rank <= 32 - HLL_REGISTER_BITS && (rest & 0x80000000U) == 0)
+    {
+        rank++;
+        rest <<= 1;
+    }
+    if (rank > stats->hll[index])
+    {
+        stats->hll[index] = rank;
+    }
+}
+
+void update_column_stats(Table *table, int column_index, const void *value)
+{
+    ColumnStats *stats = &table->stats.columns[column_index];
+    switch (table->columns[column_index].type)
+    {
+    case INT:
+    {
+        int val = *(const int *)value;
+        if (!stats->has_values || val < stats->min)
+            stats->min = val;
+        if (!stats->has_values || val > stats->max)
+            stats->max = val;
+        hll_add(stats, word_hash_int(val)); // sequential keys spread over the registers
+        break;
+    }
+    case STRING:
+    case VARCHAR:
+        hll_add(stats, word_hash_str((const char *)value));
+        break;
+    }
+    stats->has_values = 1;
+}
+
+void update_table_stats_from_row(Table *table, const char *row)
+{
+    int offset = 0;
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        switch (table->columns[i].type)
+        {
+        case INT:
+        {
+            int val;
+            memcpy(&val, row + offset, sizeof(int));
+            update_column_stats(table, i, &val);
+            offset += sizeof(int);
+            break;
+        }
+        case STRING:
+        case VARCHAR:
+        {
+            char str[table->columns[i].lenght + 1];
+            memcpy(str, row + offset, table->columns[i].lenght);
+            str[table->columns[i].lenght] = '\0';
+            update_column_stats(table, i, str);
+            offset += table->columns[i].lenght + 1;
+            break;
+        }
+        }
+    }
+}
+
+int rebuild_table_stats(Table *table)
+{
+    init_table_stats(&table->stats);
+
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb", NULL) != 0)
+    {
+        return -1;
+    }
+
+    char *row = (char *)malloc(table->row_size_in_bytes);
+    if (!row)
+    {
+        perror("Failed to allocate memory for row");
+        close_table_storage(&storage);
+        return -1;
+    }
+
+    while (read_next_row(&storage, row))
+    {
+        if (!isfree(table, storage.current_pos))
+        {
+            update_table_stats_from_row(table, row);
+        }
+    }
+
+    free(row);
+    close_table_storage(&storage);
+    return 0;
+}
+
+double estimate_distinct_count(const ColumnStats *stats)
+{
+    if (!stats->has_values)
+    {
+        return 1.0;
+    }
+
+    double m = HLL_REGISTER_COUNT;
+    double sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTER_COUNT; i++)
+    {
+        sum += ldexp(1.0, -stats->hll[i]);
+        if (stats->hll[i] == 0)
+        {
+            zeros++;
+        }
+    }
+
+    double estimate = 0.709 * m * m / sum; // alpha for 64 registers
+    if (estimate <= 2.5 * m && zeros > 0)
+    {
+        estimate = m * log(m / zeros); // linear counting for small cardinalities
+    }
+    return estimate < 1.0 ? 1.0 : estimate;
+}
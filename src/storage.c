@@ -0,0 +1,1013 @@
+#include "storage.h"
+#include "file_io.h"
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static int column_width(const Column *column)
+{
+    return column->type == INT ? (int)sizeof(int) : column->lenght + 1;
+}
+
+static FILE *open_column_file(const Table *table, int column_index, const char *mode)
+{
+    char filename[MAX_NAME_LEN * 3 + 16];
+    snprintf(filename, sizeof(filename), "%s/bins/%s.%s.col", get_root(), table->table_name, table->columns[column_index].name);
+    FILE *file = fopen(filename, mode);
+    if (!file)
+    {
+        perror("Failed to open column file");
+        return NULL;
+    }
+    return file;
+}
+
+static int is_encoded(const TableStorage *storage, int column_index)
+{
+    return storage->table->encodings && storage->table->encodings[column_index].type != ENCODING_PLAIN;
+}
+
+// VARCHAR columns wider than a slot, unless a dictionary already stores their values
+static int column_has_slot(const Table *table, int column_index)
+{
+    const Column *column = &table->columns[column_index];
+    return column->type == VARCHAR && column->lenght + 1 > VARCHAR_SLOT_SIZE &&
+           (!table->encodings || table->encodings[column_index].type == ENCODING_PLAIN);
+}
+
+static int table_has_heap(const Table *table)
+{
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (column_has_slot(table, i))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static FILE *open_heap_file(const Table *table, const char *mode)
+{
+    char filename[MAX_NAME_LEN * 2 + 16];
+    snprintf(filename, sizeof(filename), "%s/bins/%s.heap", get_root(), table->table_name);
+    FILE *file = fopen(filename, mode);
+    if (!file)
+    {
+        perror("Failed to open heap file");
+    }
+    return file;
+}
+
+static int reserve_scratch(TableStorage *storage, size_t needed)
+{
+    if (needed <= storage->scratch_size)
+    {
+        return 0;
+    }
+    char *scratch = realloc(storage->scratch, needed);
+    if (!scratch)
+    {
+        perror("Failed to allocate memory for stored values");
+        return -1;
+    }
+    storage->scratch = scratch;
+    storage->scratch_size = needed;
+    return 0;
+}
+
+/*
+ * A slot starts with its kind. Inline slots hold the NUL-terminated value after it, heap slots the length of the
+ * value, its offset in the .heap file and the bytes reserved there, which a shorter value keeps for the next one.
+ * Zeroed slots are empty inline values.
+ */
+#define SLOT_INLINE 0
+#define SLOT_HEAP 1
+#define SLOT_LENGTH_OFFSET 4
+#define SLOT_HEAP_OFFSET 8
+#define SLOT_CAPACITY_OFFSET 16
+
+static int read_slot_value(TableStorage *storage, int column_index, const unsigned char *slot, char *value)
+{
+    int width = storage->column_widths[column_index];
+    memset(value, 0, width);
+    if (slot[0] == SLOT_INLINE)
+    {
+        memcpy(value, slot + 1, VARCHAR_SLOT_SIZE - 1);
+        return 0;
+    }
+    int length;
+    long offset;
+    memcpy(&length, slot + SLOT_LENGTH_OFFSET, sizeof(int));
+    memcpy(&offset, slot + SLOT_HEAP_OFFSET, sizeof(long));
+    if (length < 0 || length >= width || fseek(storage->heap, offset, SEEK_SET) != 0 ||
+        fread(value, 1, length, storage->heap) != (size_t)length)
+    {
+        perror("Failed to read value from heap file");
+        return -1;
+    }
+    return 0;
+}
+
+// The slot currently stored for a row, read around the stdio buffers which were flushed by the last write
+static int read_stored_slot(TableStorage *storage, int column_index, long row_index, unsigned char *slot)
+{
+    FILE *file = storage->file ? storage->file : storage->column_files[column_index];
+    long offset = storage->file ? row_index * storage->stored_row_size + storage->stored_offsets[column_index]
+                                : row_index * VARCHAR_SLOT_SIZE;
+    return pread(fileno(file), slot, VARCHAR_SLOT_SIZE, offset) == VARCHAR_SLOT_SIZE ? 0 : -1;
+}
+
+static int write_stored_slot(TableStorage *storage, int column_index, long row_index, const unsigned char *slot)
+{
+    FILE *file = storage->file ? storage->file : storage->column_files[column_index];
+    long offset = storage->file ? row_index * storage->stored_row_size + storage->stored_offsets[column_index]
+                                : row_index * VARCHAR_SLOT_SIZE;
+    return pwrite(fileno(file), slot, VARCHAR_SLOT_SIZE, offset) == VARCHAR_SLOT_SIZE ? 0 : -1;
+}
+
+// Build the slot of a value. A long value that fits the heap space reserved for the one the row already holds
+// overwrites it in place, only longer values are appended to the heap. The space of deleted rows and of
+// values that outgrew theirs is reclaimed by compact_heap.
+static int write_slot_value(TableStorage *storage, int column_index, const char *value, long row_index, unsigned char *slot)
+{
+    int length = strnlen(value, storage->table->columns[column_index].lenght);
+    memset(slot, 0, VARCHAR_SLOT_SIZE);
+    if (length <= VARCHAR_INLINE_LENGTH)
+    {
+        slot[0] = SLOT_INLINE;
+        memcpy(slot + 1, value, length);
+        return 0;
+    }
+
+    unsigned char current[VARCHAR_SLOT_SIZE];
+    int capacity = length;
+    long offset;
+    int in_place = 0;
+    if (read_stored_slot(storage, column_index, row_index, current) == 0 && current[0] == SLOT_HEAP)
+    {
+        int current_length;
+        int current_capacity;
+        memcpy(&current_length, current + SLOT_LENGTH_OFFSET, sizeof(int));
+        memcpy(&current_capacity, current + SLOT_CAPACITY_OFFSET, sizeof(int));
+        memcpy(&offset, current + SLOT_HEAP_OFFSET, sizeof(long));
+        current_capacity = current_capacity > current_length ? current_capacity : current_length;
+        if (length <= current_capacity)
+        {
+            in_place = 1;
+            capacity = current_capacity;
+        }
+    }
+
+    if ((in_place ? fseek(storage->heap, offset, SEEK_SET) != 0
+                  : fseek(storage->heap, 0, SEEK_END) != 0 || (offset = ftell(storage->heap)) < 0) ||
+        fwrite(value, 1, length, storage->heap) != (size_t)length)
+    {
+        perror("Failed to write value to heap file");
+        return -1;
+    }
+    slot[0] = SLOT_HEAP;
+    memcpy(slot + SLOT_LENGTH_OFFSET, &length, sizeof(int));
+    memcpy(slot + SLOT_HEAP_OFFSET, &offset, sizeof(long));
+    memcpy(slot + SLOT_CAPACITY_OFFSET, &capacity, sizeof(int));
+    return 0;
+}
+
+// Walk the heap values of the first row_count rows in row order. With a file they are copied to it, without one
+// their slots are pointed at where the copy put them.
+static int relocate_heap_values(TableStorage *storage, long row_count, FILE *compacted, char *value, int widest)
+{
+    const Table *table = storage->table;
+    long next = 0;
+    for (long row = 0; row < row_count; row++)
+    {
+        for (int i = 0; i < table->columns_count; i++)
+        {
+            unsigned char slot[VARCHAR_SLOT_SIZE];
+            if (!column_has_slot(table, i) || read_stored_slot(storage, i, row, slot) != 0 || slot[0] != SLOT_HEAP)
+            {
+                continue;
+            }
+            int length;
+            long offset;
+            memcpy(&length, slot + SLOT_LENGTH_OFFSET, sizeof(int));
+            memcpy(&offset, slot + SLOT_HEAP_OFFSET, sizeof(long));
+            if (length < 0 || length > widest)
+            {
+                return -1;
+            }
+            if (compacted)
+            {
+                if (fseek(storage->heap, offset, SEEK_SET) != 0 || fread(value, 1, length, storage->heap) != (size_t)length ||
+                    fwrite(value, 1, length, compacted) != (size_t)length)
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                memcpy(slot + SLOT_HEAP_OFFSET, &next, sizeof(long));
+                memcpy(slot + SLOT_CAPACITY_OFFSET, &length, sizeof(int));
+                if (write_stored_slot(storage, i, row, slot) != 0)
+                {
+                    return -1;
+                }
+            }
+            next += length;
+        }
+    }
+    return 0;
+}
+
+// Rewrite the heap with only the values of the first row_count rows once it is more than twice the size those
+// rows could reference, dropping the space values outgrew, the values of deleted rows and unused reservations.
+// The values are copied before any slot changes, a failed copy leaves the table as it was.
+static int compact_heap(TableStorage *storage, long row_count)
+{
+    const Table *table = storage->table;
+    long reachable = 0;
+    int widest = 1;
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (column_has_slot(table, i))
+        {
+            reachable += row_count * table->columns[i].lenght;
+            widest = table->columns[i].lenght > widest ? table->columns[i].lenght : widest;
+        }
+    }
+    struct stat info;
+    if (fflush(storage->heap) != 0 || fstat(fileno(storage->heap), &info) != 0)
+    {
+        perror("Failed to check heap file");
+        return -1;
+    }
+    if (info.st_size <= 2 * reachable)
+    {
+        return 0;
+    }
+
+    char filename[MAX_NAME_LEN * 2 + 16];
+    char compacted_name[MAX_NAME_LEN * 2 + 20];
+    snprintf(filename, sizeof(filename), "%s/bins/%s.heap", get_root(), table->table_name);
+    snprintf(compacted_name, sizeof(compacted_name), "%s.tmp", filename);
+    FILE *compacted = fopen(compacted_name, "wb+");
+    char *value = malloc(widest);
+    if (!compacted || !value || relocate_heap_values(storage, row_count, compacted, value, widest) != 0 ||
+        fflush(compacted) != 0 || rename(compacted_name, filename) != 0)
+    {
+        perror("Failed to compact heap file");
+        if (compacted)
+        {
+            fclose(compacted);
+            remove(compacted_name);
+        }
+        free(value);
+        return -1;
+    }
+    free(value);
+    fclose(storage->heap);
+    storage->heap = compacted;
+    if (relocate_heap_values(storage, row_count, NULL, NULL, widest) != 0)
+    {
+        perror("Failed to update heap slots");
+        return -1;
+    }
+    return 0;
+}
+
+// Stored values are little endian unsigned integers of 1, 2 or 4 bytes
+static uint32_t load_stored(const unsigned char *bytes, int width)
+{
+    uint32_t value = 0;
+    for (int i = width - 1; i >= 0; i--)
+    {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+static void store_stored(unsigned char *bytes, int width, uint32_t value)
+{
+    for (int i = 0; i < width; i++)
+    {
+        bytes[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+static int fits_width(int width, long long value)
+{
+    return width == 4 ? value >= 0 && value <= UINT32_MAX : value >= 0 && value < 1LL << (8 * width);
+}
+
+static void decode_value(TableStorage *storage, int column_index, const unsigned char *stored, char *value)
+{
+    const ColumnEncoding *encoding = &storage->table->encodings[column_index];
+    uint32_t encoded = load_stored(stored, storage->stored_widths[column_index]);
+    if (encoding->type == ENCODING_FRAME_OF_REFERENCE)
+    {
+        int decoded = (int)(encoded + (uint32_t)encoding->base);
+        memcpy(value, &decoded, sizeof(int));
+        return;
+    }
+    storage->codes[column_index] = encoded;
+    if (!storage->decode[column_index])
+    {
+        return;
+    }
+    // Free rows hold code 0 even while the dictionary is empty
+    if (encoded < (uint32_t)encoding->dictionary.count)
+    {
+        memcpy(value, dictionary_value(&encoding->dictionary, encoded), storage->column_widths[column_index]);
+    }
+    else
+    {
+        memset(value, 0, storage->column_widths[column_index]);
+    }
+}
+
+// Read every stored value of a column as an unsigned integer, the caller frees the values
+static uint32_t *load_column(TableStorage *storage, int column_index, long *count)
+{
+    FILE *file = storage->column_files[column_index];
+    int width = storage->stored_widths[column_index];
+    fflush(file);
+    if (fseek(file, 0, SEEK_END) != 0)
+    {
+        return NULL;
+    }
+    *count = ftell(file) / width;
+    unsigned char *stored = malloc((size_t)*count * width + 1);
+    uint32_t *values = malloc((size_t)*count * sizeof(uint32_t) + 1);
+    if (!stored || !values || fseek(file, 0, SEEK_SET) != 0 || fread(stored, width, *count, file) != (size_t)*count)
+    {
+        perror("Failed to read column values");
+        free(stored);
+        free(values);
+        return NULL;
+    }
+    for (long i = 0; i < *count; i++)
+    {
+        values[i] = load_stored(stored + i * width, width);
+    }
+    free(stored);
+    return values;
+}
+
+// Store a column again with a new width and base. Values are given relative to the old base
+static int rewrite_column(TableStorage *storage, int column_index, const uint32_t *values, long count, int width, int base)
+{
+    ColumnEncoding *encoding = &storage->table->encodings[column_index];
+    FILE *file = storage->column_files[column_index];
+    unsigned char *stored = malloc((size_t)count * width + 1);
+    if (!stored)
+    {
+        perror("Failed to allocate memory for column values");
+        return -1;
+    }
+    uint32_t shift = (uint32_t)encoding->base - (uint32_t)base;
+    for (long i = 0; i < count; i++)
+    {
+        store_stored(stored + i * width, width, values[i] + shift);
+    }
+    int result = fseek(file, 0, SEEK_SET) == 0 && fwrite(stored, width, count, file) == (size_t)count ? 0 : -1;
+    free(stored);
+    fflush(file);
+    if (result != 0)
+    {
+        perror("Failed to rewrite column values");
+        return -1;
+    }
+    encoding->width = width;
+    encoding->base = base;
+    storage->stored_widths[column_index] = width;
+    storage->file_pos = -1;
+    return store_table_metadata(storage->table);
+}
+
+// Pick the narrowest width holding the stored values and a new value, centring them in it so values
+// arriving on either side fit without another rewrite
+static int refit_frame_of_reference(TableStorage *storage, int column_index, int value)
+{
+    const ColumnEncoding *encoding = &storage->table->encodings[column_index];
+    long count;
+    uint32_t *values = load_column(storage, column_index, &count);
+    if (!values)
+    {
+        return -1;
+    }
+    long long min = value;
+    long long max = value;
+    for (long i = 0; i < count; i++)
+    {
+        int decoded = (int)(values[i] + (uint32_t)encoding->base);
+        min = decoded < min ? decoded : min;
+        max = decoded > max ? decoded : max;
+    }
+    int width = max - min < 1 << 8 ? 1 : max - min < 1 << 16 ? 2 : 4;
+    width = width < encoding->width ? encoding->width : width;
+    long long base = min;
+    if (width < 4)
+    {
+        base = min - ((1LL << (8 * width)) - 1 - (max - min)) / 2;
+        base = base < INT_MIN ? INT_MIN : base;
+    }
+    int result = rewrite_column(storage, column_index, values, count, width, (int)base);
+    free(values);
+    return result;
+}
+
+static int widen_dictionary_codes(TableStorage *storage, int column_index)
+{
+    long count;
+    uint32_t *values = load_column(storage, column_index, &count);
+    if (!values)
+    {
+        return -1;
+    }
+    int result = rewrite_column(storage, column_index, values, count, storage->stored_widths[column_index] * 2, 0);
+    free(values);
+    return result;
+}
+
+// Encode a value of the row image. Returns 1 when the column had to be rewritten to make the value fit,
+// the file position is lost then
+static int encode_value(TableStorage *storage, int column_index, const char *value, unsigned char *stored)
+{
+    const Table *table = storage->table;
+    ColumnEncoding *encoding = &table->encodings[column_index];
+    int rewritten = 0;
+    uint32_t encoded;
+    if (encoding->type == ENCODING_FRAME_OF_REFERENCE)
+    {
+        int decoded;
+        memcpy(&decoded, value, sizeof(int));
+        if (!fits_width(encoding->width, (long long)decoded - encoding->base))
+        {
+            if (refit_frame_of_reference(storage, column_index, decoded) != 0)
+            {
+                return -1;
+            }
+            rewritten = 1;
+        }
+        encoded = (uint32_t)decoded - (uint32_t)encoding->base;
+    }
+    else
+    {
+        int added;
+        int code = dictionary_add(&encoding->dictionary, value, &added);
+        if (code < 0 || (added && append_dictionary_value(table, column_index, code) != 0))
+        {
+            printf("Failed to add value to the dictionary of column %s\n", table->columns[column_index].name);
+            return -1;
+        }
+        while (!fits_width(encoding->width, code))
+        {
+            if (widen_dictionary_codes(storage, column_index) != 0)
+            {
+                return -1;
+            }
+            rewritten = 1;
+        }
+        encoded = code;
+    }
+    store_stored(stored, encoding->width, encoded);
+    return rewritten;
+}
+
+int create_table_storage(const Table *table)
+{
+    if (table_has_heap(table))
+    {
+        FILE *heap = open_heap_file(table, "wb+");
+        if (!heap)
+        {
+            return -1;
+        }
+        fclose(heap);
+    }
+    if (table->engine == ENGINE_ROW)
+    {
+        return create_bin_file(table);
+    }
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        FILE *file = open_column_file(table, i, "wb+");
+        if (!file)
+        {
+            return -1;
+        }
+        fclose(file);
+    }
+    return table->encodings ? create_dictionary_files(table) : 0;
+}
+
+static long file_bytes(const char *filename)
+{
+    struct stat info;
+    if (stat(filename, &info) != 0)
+    {
+        perror("Failed to check data file");
+        return -1;
+    }
+    return (long)info.st_size;
+}
+
+long table_storage_bytes(const Table *table)
+{
+    char filename[MAX_NAME_LEN * 3 + 16];
+    long total = 0;
+    long bytes;
+    if (table_has_heap(table))
+    {
+        snprintf(filename, sizeof(filename), "%s/bins/%s.heap", get_root(), table->table_name);
+        if ((bytes = file_bytes(filename)) < 0)
+        {
+            return -1;
+        }
+        total += bytes;
+    }
+    if (table->engine == ENGINE_ROW)
+    {
+        snprintf(filename, sizeof(filename), "%s/bins/%s.bin", get_root(), table->table_name);
+        bytes = file_bytes(filename);
+        return bytes < 0 ? -1 : total + bytes;
+    }
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        snprintf(filename, sizeof(filename), "%s/bins/%s.%s.col", get_root(), table->table_name, table->columns[i].name);
+        if ((bytes = file_bytes(filename)) < 0)
+        {
+            return -1;
+        }
+        total += bytes;
+    }
+    return total;
+}
+
+int remove_table_storage(const Table *table)
+{
+    char filename[MAX_NAME_LEN * 3 + 16];
+    if (table_has_heap(table))
+    {
+        snprintf(filename, sizeof(filename), "%s/bins/%s.heap", get_root(), table->table_name);
+        if (remove(filename) != 0)
+        {
+            perror("Failed to delete heap file");
+            return -1;
+        }
+    }
+    if (table->engine == ENGINE_ROW)
+    {
+        snprintf(filename, sizeof(filename), "%s/bins/%s.bin", get_root(), table->table_name);
+        if (remove(filename) != 0)
+        {
+            perror("Failed to delete binary file");
+            return -1;
+        }
+        return 0;
+    }
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        snprintf(filename, sizeof(filename), "%s/bins/%s.%s.col", get_root(), table->table_name, table->columns[i].name);
+        if (remove(filename) != 0)
+        {
+            perror("Failed to delete column file");
+            return -1;
+        }
+    }
+    return table->encodings ? remove_dictionary_files(table) : 0;
+}
+
+int open_table_storage(TableStorage *storage, const Table *table, const char *mode, const int used_columns[])
+{
+    memset(storage, 0, sizeof(TableStorage));
+    storage->table = table;
+    storage->file_pos = -1;
+
+    // Rows written back must be complete, only read-only storages skip decoding unused columns
+    int writing = strchr(mode, '+') != NULL;
+    int offset = 0;
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        storage->column_offsets[i] = offset;
+        storage->column_widths[i] = column_width(&table->columns[i]);
+        storage->stored_widths[i] = is_encoded(storage, i)       ? table->encodings[i].width
+                                    : column_has_slot(table, i) ? VARCHAR_SLOT_SIZE
+                                                                : storage->column_widths[i];
+        storage->stored_offsets[i] = storage->stored_row_size;
+        storage->stored_row_size += storage->stored_widths[i];
+        storage->decode[i] = writing || !used_columns || used_columns[i] == COLUMN_VALUES;
+        offset += storage->column_widths[i];
+    }
+    if (table_has_heap(table))
+    {
+        storage->heap = open_heap_file(table, mode);
+        if (!storage->heap)
+        {
+            return -1;
+        }
+    }
+
+    if (table->engine == ENGINE_ROW)
+    {
+        storage->file = open_file(table->table_name, "bin", mode);
+        storage->bytes_per_row = storage->stored_row_size;
+        if (!storage->file)
+        {
+            close_table_storage(storage);
+            return -1;
+        }
+        return 0;
+    }
+
+    // Without any used column the first one is still read, its values tell where the table ends
+    int any_used = used_columns == NULL;
+    for (int i = 0; i < table->columns_count && !any_used; i++)
+    {
+        any_used = used_columns[i];
+    }
+
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (any_used ? used_columns && !used_columns[i] : i > 0)
+        {
+            continue;
+        }
+        storage->column_files[i] = open_column_file(table, i, mode);
+        if (!storage->column_files[i])
+        {
+            close_table_storage(storage);
+            return -1;
+        }
+        storage->bytes_per_row += storage->stored_widths[i];
+    }
+    return 0;
+}
+
+void close_table_storage(TableStorage *storage)
+{
+    if (storage->file)
+    {
+        fclose(storage->file);
+    }
+    if (storage->heap)
+    {
+        fclose(storage->heap);
+    }
+    for (int i = 0; i < MAX_COLUMN_COUNT; i++)
+    {
+        if (storage->column_files[i])
+        {
+            fclose(storage->column_files[i]);
+        }
+    }
+    free(storage->scratch);
+    memset(storage, 0, sizeof(TableStorage));
+}
+
+// Turn the stored value of a column into its row image value
+static int load_value(TableStorage *storage, int column_index, const unsigned char *stored, char *value)
+{
+    if (is_encoded(storage, column_index))
+    {
+        decode_value(storage, column_index, stored, value);
+        return 0;
+    }
+    if (column_has_slot(storage->table, column_index))
+    {
+        return storage->decode[column_index] ? read_slot_value(storage, column_index, stored, value) : 0;
+    }
+    memcpy(value, stored, storage->column_widths[column_index]);
+    return 0;
+}
+
+int read_table_rows(TableStorage *storage, long pos, char *rows, int row_count)
+{
+    const Table *table = storage->table;
+    int row_size = table->row_size_in_bytes;
+    long row_index = pos / row_size;
+    storage->current_pos = pos;
+
+    if (table->engine == ENGINE_ROW)
+    {
+        if (pos != storage->file_pos && fseek(storage->file, row_index * storage->stored_row_size, SEEK_SET) != 0)
+        {
+            storage->file_pos = -1;
+            return -1;
+        }
+        if (!storage->heap)
+        {
+            // Without slots a stored row is the row image
+            int read = fread(rows, row_size, row_count, storage->file);
+            storage->file_pos = pos + (long)read * row_size;
+            return read;
+        }
+        if (reserve_scratch(storage, (size_t)storage->stored_row_size * row_count) != 0)
+        {
+            storage->file_pos = -1;
+            return -1;
+        }
+        int read = fread(storage->scratch, storage->stored_row_size, row_count, storage->file);
+        storage->file_pos = pos + (long)read * row_size;
+        for (int r = 0; r < read; r++)
+        {
+            const unsigned char *stored = (unsigned char *)storage->scratch + (size_t)r * storage->stored_row_size;
+            for (int i = 0; i < table->columns_count; i++)
+            {
+                if (load_value(storage, i, stored + storage->stored_offsets[i], rows + (size_t)r * row_size + storage->column_offsets[i]) != 0)
+                {
+                    return -1;
+                }
+            }
+        }
+        return read;
+    }
+
+    // Columns are stored one after the other, read the values of every opened column and spread them over the rows
+    int read = row_count;
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        FILE *file = storage->column_files[i];
+        if (!file)
+        {
+            continue;
+        }
+        int width = storage->stored_widths[i];
+        int plain = width == storage->column_widths[i] && !is_encoded(storage, i);
+        if (pos != storage->file_pos && fseek(file, row_index * width, SEEK_SET) != 0)
+        {
+            storage->file_pos = -1;
+            return -1;
+        }
+        if (row_count == 1 && plain)
+        {
+            read = fread(rows + storage->column_offsets[i], width, 1, file) == 1 ? read : 0;
+            continue;
+        }
+        if (row_count == 1)
+        {
+            unsigned char stored[VARCHAR_SLOT_SIZE];
+            if (fread(stored, width, 1, file) != 1)
+            {
+                read = 0;
+                continue;
+            }
+            if (load_value(storage, i, stored, rows + storage->column_offsets[i]) != 0)
+            {
+                storage->file_pos = -1;
+                return -1;
+            }
+            continue;
+        }
+        if (reserve_scratch(storage, (size_t)width * row_count) != 0)
+        {
+            storage->file_pos = -1;
+            return -1;
+        }
+        int values = fread(storage->scratch, width, row_count, file);
+        if (values < read)
+        {
+            read = values;
+        }
+        for (int r = 0; r < values; r++)
+        {
+            if (load_value(storage, i, (unsigned char *)storage->scratch + (size_t)r * width,
+                           rows + (size_t)r * row_size + storage->column_offsets[i]) != 0)
+            {
+                storage->file_pos = -1;
+                return -1;
+            }
+        }
+    }
+    // The files only stay in step when every column returned the same number of values
+    storage->file_pos = read == row_count ? pos + (long)read * row_size : -1;
+    return read;
+}
+
+int write_table_rows(TableStorage *storage, long pos, const char *rows, int row_count)
+{
+    const Table *table = storage->table;
+    int row_size = table->row_size_in_bytes;
+    storage->file_pos = -1;
+
+    long row_index = pos / row_size;
+    if (table->engine == ENGINE_ROW)
+    {
+        const char *stored_rows = rows;
+        if (storage->heap)
+        {
+            // Build the stored rows first, the slots they replace are still on disk
+            if (reserve_scratch(storage, (size_t)storage->stored_row_size * row_count) != 0)
+            {
+                return -1;
+            }
+            for (int r = 0; r < row_count; r++)
+            {
+                unsigned char *stored = (unsigned char *)storage->scratch + (size_t)r * storage->stored_row_size;
+                for (int i = 0; i < table->columns_count; i++)
+                {
+                    const char *value = rows + (size_t)r * row_size + storage->column_offsets[i];
+                    if (!column_has_slot(table, i))
+                    {
+                        memcpy(stored + storage->stored_offsets[i], value, storage->column_widths[i]);
+                    }
+                    else if (write_slot_value(storage, i, value, row_index + r, stored + storage->stored_offsets[i]) != 0)
+                    {
+                        return -1;
+                    }
+                }
+            }
+            stored_rows = storage->scratch;
+            fflush(storage->heap);
+        }
+        if (fseek(storage->file, row_index * storage->stored_row_size, SEEK_SET) != 0 ||
+            fwrite(stored_rows, storage->stored_row_size, row_count, storage->file) != (size_t)row_count)
+        {
+            perror("Failed to write rows");
+            return -1;
+        }
+        fflush(storage->file);
+        return 0;
+    }
+
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        FILE *file = storage->column_files[i];
+        if (!file)
+        {
+            continue;
+        }
+        int width = storage->stored_widths[i];
+        if (fseek(file, row_index * width, SEEK_SET) != 0)
+        {
+            perror("Failed to write column values");
+            return -1;
+        }
+        for (int r = 0; r < row_count; r++)
+        {
+            const char *value = rows + (size_t)r * row_size + storage->column_offsets[i];
+            if (column_has_slot(table, i))
+            {
+                unsigned char slot[VARCHAR_SLOT_SIZE];
+                if (write_slot_value(storage, i, value, row_index + r, slot) != 0 || fwrite(slot, width, 1, file) != 1)
+                {
+                    perror("Failed to write column values");
+                    return -1;
+                }
+                continue;
+            }
+            if (!is_encoded(storage, i))
+            {
+                if (fwrite(value, width, 1, file) != 1)
+                {
+                    perror("Failed to write column values");
+                    return -1;
+                }
+                continue;
+            }
+            unsigned char stored[sizeof(uint32_t)];
+            int rewritten = encode_value(storage, i, value, stored);
+            if (rewritten < 0)
+            {
+                return -1;
+            }
+            width = storage->stored_widths[i];
+            if ((rewritten && fseek(file, (row_index + r) * width, SEEK_SET) != 0) || fwrite(stored, width, 1, file) != 1)
+            {
+                perror("Failed to write column values");
+                return -1;
+            }
+        }
+        fflush(file);
+    }
+    if (storage->heap)
+    {
+        fflush(storage->heap);
+    }
+    return 0;
+}
+
+int clear_table_rows(TableStorage *storage, long pos, int row_count)
+{
+    static const char zeros[4096];
+    const Table *table = storage->table;
+    storage->file_pos = -1;
+
+    FILE *files[MAX_COLUMN_COUNT];
+    long sizes[MAX_COLUMN_COUNT];
+    int file_count = 0;
+    if (table->engine == ENGINE_ROW)
+    {
+        files[file_count] = storage->file;
+        sizes[file_count++] = storage->stored_row_size;
+    }
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (storage->column_files[i])
+        {
+            files[file_count] = storage->column_files[i];
+            sizes[file_count++] = storage->stored_widths[i];
+        }
+    }
+
+    long row_index = pos / table->row_size_in_bytes;
+    for (int f = 0; f < file_count; f++)
+    {
+        if (fseek(files[f], row_index * sizes[f], SEEK_SET) != 0)
+        {
+            perror("Failed to clear rows");
+            return -1;
+        }
+        for (long left = sizes[f] * row_count; left > 0; left -= (long)sizeof(zeros))
+        {
+            size_t chunk = left < (long)sizeof(zeros) ? (size_t)left : sizeof(zeros);
+            if (fwrite(zeros, 1, chunk, files[f]) != chunk)
+            {
+                perror("Failed to clear rows");
+                return -1;
+            }
+        }
+        fflush(files[f]);
+    }
+    return 0;
+}
+
+void rewind_table_storage(TableStorage *storage)
+{
+    storage->scan_pos = 0;
+}
+
+void seek_table_storage(TableStorage *storage, long pos)
+{
+    storage->scan_pos = pos;
+}
+
+int read_next_row(TableStorage *storage, char *row)
+{
+    if (read_table_rows(storage, storage->scan_pos, row, 1) != 1)
+    {
+        return 0;
+    }
+    storage->scan_pos += storage->table->row_size_in_bytes;
+    return 1;
+}
+
+long table_storage_end(TableStorage *storage)
+{
+    const Table *table = storage->table;
+    storage->file_pos = -1;
+    if (table->engine == ENGINE_ROW)
+    {
+        if (fseek(storage->file, 0, SEEK_END) != 0)
+        {
+            return -1;
+        }
+        return ftell(storage->file) / storage->stored_row_size * table->row_size_in_bytes;
+    }
+
+    // Every column file holds one value per row, any opened one tells the row count
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (storage->column_files[i])
+        {
+            if (fseek(storage->column_files[i], 0, SEEK_END) != 0)
+            {
+                return -1;
+            }
+            return ftell(storage->column_files[i]) / storage->stored_widths[i] * table->row_size_in_bytes;
+        }
+    }
+    return -1;
+}
+
+int truncate_table_storage(TableStorage *storage, long end)
+{
+    const Table *table = storage->table;
+    storage->file_pos = -1;
+    long row_count = end / table->row_size_in_bytes;
+    if (table->engine == ENGINE_ROW)
+    {
+        fflush(storage->file);
+        if (ftruncate(fileno(storage->file), row_count * storage->stored_row_size) != 0)
+        {
+            return -1;
+        }
+        return storage->heap ? compact_heap(storage, row_count) : 0;
+    }
+
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (!storage->column_files[i])
+        {
+            return -1;
+        }
+        fflush(storage->column_files[i]);
+        if (ftruncate(fileno(storage->column_files[i]), row_count * storage->stored_widths[i]) != 0)
+        {
+            return -1;
+        }
+    }
+    return storage->heap ? compact_heap(storage, row_count) : 0;
+}
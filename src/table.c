@@ -1,7 +1,9 @@
 #include "table.h"
 #include "file_io.h"
+#include "storage.h"
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 int calculate_row_size_in_bytes(const Column *columns, const int columns_count)
 {
@@ -15,6 +17,7 @@ int calculate_row_size_in_bytes(const Column *columns, const int columns_count)
             break;
 
         case STRING:
+        case VARCHAR:
             size += columns[i].lenght + 1; // +1 for null terminator
             break;
         }
@@ -24,10 +27,10 @@ int calculate_row_size_in_bytes(const Column *columns, const int columns_count)
 
 int create_initial_files_for_table(Table *table)
 {
-    // Create binary file for data to be stored
-    if (create_bin_file(table) != 0)
+    // Create the data files, one .bin file or a .col file per column
+    if (create_table_storage(table) != 0)
     {
-        perror("Failed to create binary file");
+        perror("Failed to create data files");
         return -1;
     }
 
@@ -45,10 +48,32 @@ int create_initial_files_for_table(Table *table)
         return -1;
     }
 
+    // Create the empty zone map file
+    if (flush_zone_map(table) != 0)
+    {
+        return -1;
+    }
+
+    // Create the empty bloom filter file next to the hashmap
+    if (flush_bloom_filter(table) != 0)
+    {
+        return -1;
+    }
+
     return 0;
 }
 
-Table *create_table(const char *table_name, const Column *columns, const int columns_count, const Column primary_key)
+uint32_t hash_int_key(const Table *table, int key)
+{
+    return get_hash_functions(table->key_hash)->hash_int(key);
+}
+
+uint32_t hash_str_key(const Table *table, const char *key)
+{
+    return get_hash_functions(table->key_hash)->hash_str(key);
+}
+
+Table *create_table(const char *table_name, const Column *columns, const int columns_count, const Column primary_key, const StorageEngine engine)
 {
     Table *table = (Table *)malloc(sizeof(Table));
     if (!table)
@@ -72,6 +97,10 @@ Table *create_table(const char *table_name, const Column *columns, const int col
     table->record_size = 0;
     table->columns_count = columns_count;
     table->primary_key = primary_key;
+    table->engine = engine;
+    table->encodings = NULL;
+    table->key_hash = HASH_WORD;
+    table->version = 0;
     table->free_spaces_count = 0;
     for (int i = 0; i < MAX_FREE_SPACES; i++)
     {
@@ -85,6 +114,18 @@ Table *create_table(const char *table_name, const Column *columns, const int col
         return NULL;
     }
     table->row_size_in_bytes = calculate_row_size_in_bytes(columns, columns_count);
+    if (engine == ENGINE_COMPRESSED)
+    {
+        table->encodings = create_column_encodings(table);
+        if (!table->encodings)
+        {
+            free_hashtable(table->hash);
+            free(table);
+            return NULL;
+        }
+    }
+    init_table_stats(&table->stats);
+    init_zone_map(&table->zones);
     create_initial_files_for_table(table);
     add_table_to_tables(table_name);
 
@@ -109,6 +150,11 @@ Table *create_temp_table(const char *table_name, const Column *columns, const in
     }
     table->record_size = 0;
     table->columns_count = columns_count;
+    table->engine = ENGINE_ROW;
+    table->encodings = NULL;
+    table->key_hash = HASH_WORD;
+    table->version = 0;
+    init_zone_map(&table->zones);
     table->free_spaces_count = 0;
     for (int i = 0; i < MAX_FREE_SPACES; i++)
     {
@@ -122,8 +168,9 @@ Table *create_temp_table(const char *table_name, const Column *columns, const in
         return NULL;
     }
     table->row_size_in_bytes = calculate_row_size_in_bytes(columns, columns_count);
+    init_table_stats(&table->stats);
 
-    create_bin_file(table);
+    create_table_storage(table);
 
     return table;
 }
@@ -133,111 +180,107 @@ int insert_record(Table *table, ...)
     va_list args;
     va_start(args, table);
 
-    FILE *file = open_file(table->table_name, "bin", "ab");
-    if (!file)
+    void *values[MAX_COLUMN_COUNT];
+    int int_values[MAX_COLUMN_COUNT];
+    for (int i = 0; i < table->columns_count; i++)
     {
-        return -1;
+        switch (table->columns[i].type)
+        {
+        case INT:
+            int_values[i] = va_arg(args, int);
+            values[i] = &int_values[i];
+            break;
+        case STRING:
+        case VARCHAR:
+            values[i] = va_arg(args, char *);
+            break;
+        }
     }
+    va_end(args);
 
-    Key key;
-    uint32_t hash;
-    long pos;
-    if (table->free_spaces_count > 0)
+    return insert_record_array(table, values);
+}
+
+// Compare the stored key bytes of every candidate, the char_key of STRING entries does not outlive the insert
+static HashEntry *find_entry_by_stored_key(const Table *table, TableStorage *storage, const char *key, uint32_t hash_value, int key_offset)
+{
+    if (!bloom_may_contain(&table->hash->bloom, hash_value))
     {
-        // Use the first free space
-        pos = table->free_spaces[table->free_spaces_count - 1];
-        table->free_spaces[table->free_spaces_count - 1] = -1; // Mark as used
-        table->free_spaces_count--;
-        if (update_table_metadata_free_spaces(table) != 0)
+        return NULL; // Most absent keys stop here without reading a row
+    }
+    int key_size = table->primary_key.type == INT ? (int)sizeof(int) : table->primary_key.lenght + 1;
+    char stored[table->row_size_in_bytes];
+    for (HashEntry *he = table->hash->buckets[hash_value % table->hash->size]; he; he = he->next)
+    {
+        if (he->hash == hash_value && read_table_rows(storage, he->file_pos, stored, 1) == 1 &&
+            memcmp(stored + key_offset, key, key_size) == 0)
         {
-            printf("Failed to update free spaces in metadata file\n");
-            fclose(file);
-            va_end(args);
-            return -1;
+            return he;
         }
-        fseek(file, pos, SEEK_SET);
     }
-    else
+    return NULL;
+}
+
+int insert_record_array(Table *table, void **values)
+{
+    table->version++; // cached results of the table are stale even if the insert fails halfway
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb+", NULL) != 0)
     {
-        // Append to the end of the file
-        pos = ftell(file);
+        return -1;
     }
 
-    // Write each column value based on its type
+    // Encode the row image, strings are zero-padded to their column length
+    char row[table->row_size_in_bytes];
+    memset(row, 0, sizeof(row));
+    Key key;
+    uint32_t hash;
+    int offset = 0;
     for (int i = 0; i < table->columns_count; i++)
     {
         switch (table->columns[i].type)
         {
         case INT:
         {
-            int val = va_arg(args, int);
-            fwrite(&val, sizeof(int), 1, file);
+            int val = *((int *)values[i]);
+            memcpy(row + offset, &val, sizeof(int));
+            offset += sizeof(int);
             if (cmpcolumns(table->columns[i], table->primary_key) == 0)
             {
                 key.int_key = val;
-                hash = fnv1a_hash_int(val);
+                hash = hash_int_key(table, val);
             }
             break;
         }
         case STRING:
+        case VARCHAR:
         {
-            char *str = va_arg(args, char *);
-            if (write_string_to_file(file, str, table->columns[i].lenght) != 0)
-            {
-                printf("Failed to write string to file\n");
-                fclose(file);
-                va_end(args);
-                return -1;
-            }
+            char *str = (char *)values[i];
+            strncpy(row + offset, str, table->columns[i].lenght);
+            offset += table->columns[i].lenght + 1;
             if (strcmp(table->columns[i].name, table->primary_key.name) == 0)
             {
                 key.char_key = str;
-                hash = fnv1a_hash_str(str);
+                hash = hash_str_key(table, str);
             }
             break;
         }
         }
     }
 
-    HashEntry *he = create_hash_entry(table->hash, key, hash, pos);
-    table->record_size++;
-
-    // Update the record size in the metadata file
-    if (update_table_metadata_record_size(table) != 0)
-    {
-        perror("Failed to update record size in metadata file");
-        free(he);
-        fclose(file);
-        va_end(args);
-        return -1;
-    }
-
-    // Update the hash table file
-    if (insert_to_hashmap_file(table, he) != 0)
+    // The bloom filter answers for most new keys, only likely duplicates read stored rows
+    int key_offset = calculate_offset(table, table->primary_key);
+    if (find_entry_by_stored_key(table, &storage, row + key_offset, hash, key_offset))
     {
-        perror("Failed to insert to hashmap file");
-        free(he);
-        fclose(file);
-        va_end(args);
+        printf("Error: Duplicate primary key, %s already exists\n", table->primary_key.name);
+        close_table_storage(&storage);
         return -1;
     }
-
-    va_end(args);
-    fflush(file);
-    fclose(file);
-    return 0;
-}
-
-int insert_record_array(Table *table, void **values)
-{
-    FILE *file = open_file(table->table_name, "bin", "ab");
-    if (!file)
+    for (int i = 0; i < table->columns_count; i++)
     {
-        return -1;
+        update_column_stats(table, i, values[i]);
     }
 
-    Key key;
-    uint32_t hash;
     long pos;
     if (table->free_spaces_count > 0)
     {
@@ -245,53 +288,29 @@ int insert_record_array(Table *table, void **values)
         pos = table->free_spaces[table->free_spaces_count - 1];
         table->free_spaces[table->free_spaces_count - 1] = -1; // Mark as used
         table->free_spaces_count--;
-        if (update_table_metadata_free_spaces(table) != 0)
+        if (update_table_metadata_free_spaces_count(table) != 0)
         {
-            printf("Failed to update free spaces in metadata file\n");
-            fclose(file);
+            printf("Failed to update free spaces count in metadata file\n");
+            close_table_storage(&storage);
             return -1;
         }
-        fseek(file, pos, SEEK_SET);
     }
     else
     {
-        // Append to the end of the file
-        pos = ftell(file);
+        // Append to the end of the table
+        pos = table_storage_end(&storage);
     }
-
-    // Write each column value based on its type
-    for (int i = 0; i < table->columns_count; i++)
+    if (pos < 0 || write_table_rows(&storage, pos, row, 1) != 0)
     {
-        switch (table->columns[i].type)
-        {
-        case INT:
-        {
-            int val = *((int *)values[i]);
-            fwrite(&val, sizeof(int), 1, file);
-            if (cmpcolumns(table->columns[i], table->primary_key) == 0)
-            {
-                key.int_key = val;
-                hash = fnv1a_hash_int(val);
-            }
-            break;
-        }
-        case STRING:
-        {
-            char *str = (char *)values[i];
-            if (write_string_to_file(file, str, table->columns[i].lenght) != 0)
-            {
-                printf("Failed to write string to file\n");
-                fclose(file);
-                return -1;
-            }
-            if (strcmp(table->columns[i].name, table->primary_key.name) == 0)
-            {
-                key.char_key = str;
-                hash = fnv1a_hash_str(str);
-            }
-            break;
-        }
-        }
+        printf("Failed to write record\n");
+        close_table_storage(&storage);
+        return -1;
+    }
+    close_table_storage(&storage);
+    if (zone_map_add_row(table, pos, row) != 0 || flush_zone_map(table) != 0)
+    {
+        printf("Failed to update zone map\n");
+        return -1;
     }
 
     HashEntry *he = create_hash_entry(table->hash, key, hash, pos);
@@ -301,8 +320,7 @@ int insert_record_array(Table *table, void **values)
     if (update_table_metadata_record_size(table) != 0)
     {
         perror("Failed to update record size in metadata file");
-        free(he);
-        fclose(file);
+        delete_hash_entry(table->hash, he);
         return -1;
     }
 
@@ -310,12 +328,14 @@ int insert_record_array(Table *table, void **values)
     if (insert_to_hashmap_file(table, he) != 0)
     {
         perror("Failed to insert to hashmap file");
-        free(he);
-        fclose(file);
+        delete_hash_entry(table->hash, he);
+        return -1;
+    }
+    if (flush_bloom_filter(table) != 0)
+    {
         return -1;
     }
 
-    fclose(file);
     return 0;
 }
 
@@ -324,59 +344,37 @@ char *search_record_by_key(const Table *table, ...)
     va_list args;
     va_start(args, table);
 
-    FILE *file = open_file(table->table_name, "bin", "rb");
-    if (!file)
-    {
-        return NULL;
-    }
-
     long pos = find_record_position(table, args);
+    va_end(args);
     if (pos == -1)
     {
         printf("Failed to locate record\n");
-        fclose(file);
-        va_end(args);
-        return NULL;
-    }
-
-    if (pos == -2)
-    {
-        printf("Invalid data type\n");
-        fclose(file);
-        va_end(args);
-        return NULL;
-    }
-
-    if (pos == -3)
-    {
-        printf("Hash entry could not be created\n");
-        fclose(file);
-        va_end(args);
         return NULL;
     }
 
     // Read data
-    fseek(file, pos, SEEK_SET);
     char *buffer = (char *)malloc(table->row_size_in_bytes);
     if (buffer == NULL)
     {
         perror("Memory allocation failed");
-        fclose(file);
         return NULL;
     }
 
-    int bytes_read = fread(buffer, 1, table->row_size_in_bytes, file);
-    if (bytes_read != table->row_size_in_bytes)
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb", NULL) != 0)
+    {
+        free(buffer);
+        return NULL;
+    }
+    if (read_table_rows(&storage, pos, buffer, 1) != 1)
     {
         perror("Error reading file");
         free(buffer);
-        fclose(file);
+        close_table_storage(&storage);
         return NULL;
     }
 
-    fflush(file);
-    fclose(file);
-    va_end(args);
+    close_table_storage(&storage);
     return buffer;
 }
 
@@ -397,6 +395,7 @@ void print_row_readable(const Table *table, const char *data)
             break;
 
         case STRING:
+        case VARCHAR:
             chardata = malloc((table->columns[i].lenght + 1) * sizeof(char));
             memcpy(chardata, data, table->columns[i].lenght + 1);
             printf("%s\n", chardata);
@@ -426,17 +425,7 @@ int check_column_exists_by_name(const Table *table, const char *column_name)
     {
         if (strcmp(table->columns[i].name, column_name) == 0)
         {
-            Column *col = (Column *)malloc(sizeof(Column));
-            if (!col)
-            {
-                perror("Failed to allocate memory for column");
-                return 0;
-            }
-            strncpy(col->name, table->columns[i].name, MAX_NAME_LEN);
-            col->type = table->columns[i].type;
-            col->lenght = table->columns[i].lenght;
-            free(col); // Free the allocated memory
-            return 1;  // Column exists
+            return 1; // Column exists
         }
     }
     return 0; // Column does not exist
@@ -463,6 +452,18 @@ Column *get_column(const Table *table, const char *column_name)
     return NULL; // Column not found
 }
 
+int get_column_index(const Table *table, const char *column_name)
+{
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (strcmp(table->columns[i].name, column_name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1; // Column not found
+}
+
 int cmpcolumns(const Column a, const Column b)
 {
     if (a.type == b.type && a.lenght == b.lenght && strcmp(a.name, b.name) == 0)
@@ -486,12 +487,12 @@ HashEntry *find_record_from_args(const Table *table, va_list args)
     if (table->primary_key.type == INT)
     {
         key.int_key = va_arg(args, int);
-        hash = fnv1a_hash_int(key.int_key);
+        hash = hash_int_key(table, key.int_key);
     }
-    else if (table->primary_key.type == STRING)
+    else if (table->primary_key.type != INT)
     {
         key.char_key = va_arg(args, char *);
-        hash = fnv1a_hash_str(key.char_key);
+        hash = hash_str_key(table, key.char_key);
     }
     else
     {
@@ -536,6 +537,8 @@ int calculate_offset(const Table *table, const Column column)
                 break;
 
             case STRING:
+
+            case VARCHAR:
                 offset += table->columns[i].lenght + 1; // +1 for null terminator
                 break;
             }
@@ -544,7 +547,7 @@ int calculate_offset(const Table *table, const Column column)
     return -1; // Column not found
 }
 
-int update_record(const Table *table, const Column column, ...)
+int update_record(Table *table, const Column column, ...)
 {
 
     if (!check_column_exists(table, column))
@@ -552,21 +555,15 @@ int update_record(const Table *table, const Column column, ...)
         printf("Column does not exist\n");
         return -1;
     }
+    table->version++;
 
     va_list args;
     va_start(args, column);
 
-    FILE *file = open_file(table->table_name, "bin", "rb+");
-    if (!file)
-    {
-        return -1;
-    }
-
     long pos = find_record_position(table, args);
     if (pos < 0)
     {
         printf("Record not found\n");
-        fclose(file);
         va_end(args);
         return -1;
     }
@@ -575,41 +572,55 @@ int update_record(const Table *table, const Column column, ...)
     if (offset < 0)
     {
         printf("Column not found\n");
-        fclose(file);
         va_end(args);
         return -1;
     }
-    fseek(file, pos + offset, SEEK_SET);
+
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb+", NULL) != 0)
+    {
+        va_end(args);
+        return -1;
+    }
+    char row[table->row_size_in_bytes];
+    if (read_table_rows(&storage, pos, row, 1) != 1)
+    {
+        printf("Error reading record at position %ld\n", pos);
+        close_table_storage(&storage);
+        va_end(args);
+        return -1;
+    }
 
     switch (column.type)
     {
     case INT:
     {
         int val = va_arg(args, int);
-        fwrite(&val, sizeof(int), 1, file);
+        memcpy(row + offset, &val, sizeof(int));
         break;
     }
     case STRING:
+    case VARCHAR:
     {
         char *str = va_arg(args, char *);
-        if (write_string_to_file(file, str, column.lenght) != 0)
-        {
-            printf("Failed to write string to file\n");
-            fclose(file);
-            va_end(args);
-            return -1;
-        }
+        memset(row + offset, 0, column.lenght + 1);
+        strncpy(row + offset, str, column.lenght);
         break;
     }
     }
 
-    fflush(file);
-    fclose(file);
+    int result = write_table_rows(&storage, pos, row, 1);
+    close_table_storage(&storage);
     va_end(args);
-    return 0;
+    if (result == 0)
+    {
+        zone_map_update_row(table, pos, row, NULL);
+        result = flush_zone_map(table);
+    }
+    return result;
 }
 
-int isfree(Table *table, long pos)
+int isfree(const Table *table, long pos)
 {
     if (table->free_spaces_count == 0)
     {
@@ -627,261 +638,552 @@ int isfree(Table *table, long pos)
 
 int delete_record(Table *table, ...)
 {
-    // TODO: delete from hashmap
     va_list args;
     va_start(args, table);
-
-    FILE *file = open_file(table->table_name, "bin", "rb+");
-    if (!file)
-    {
-        return -1;
-    }
-
     HashEntry *he = find_record_from_args(table, args);
+    va_end(args);
     if (he == NULL)
     {
         printf("Record not found\n");
-        fclose(file);
-        va_end(args);
         return -1;
     }
-    if (delete_record_from_file(table, he->file_pos) != 0)
+
+    long pos = he->file_pos;
+    return delete_records(table, &pos, 1) == 1 ? 0 : -1;
+}
+
+void *get_primary_key_from_row_data(Table *table, char *row)
+{
+    if (table->primary_key.type == INT)
     {
-        printf("Failed to delete record from file\n");
-        fclose(file);
-        va_end(args);
-        return -1;
+        int *key = malloc(sizeof(int));
+        if (!key)
+        {
+            perror("Memory allocation failed");
+            return NULL;
+        }
+        *key = *(int *)(row + calculate_offset(table, table->primary_key));
+        return key;
     }
+    else if (table->primary_key.type != INT)
+    {
+        char *key = malloc(table->primary_key.lenght + 1);
+        if (!key)
+        {
+            perror("Memory allocation failed");
+            return NULL;
+        }
+        strncpy(key, row + calculate_offset(table, table->primary_key), table->primary_key.lenght);
+        key[table->primary_key.lenght] = '\0'; // Null-terminate the string
+        return key;
+    }
+    return NULL; // Invalid primary key type
+}
+
+int delete_record_by_row_position(Table *table, long pos)
+{
+    return delete_records(table, &pos, 1) == 1 ? 0 : -1;
+}
 
-    table->record_size--;
-    table->free_spaces[table->free_spaces_count] = he->file_pos;
-    table->free_spaces_count++;
-    if (update_table_metadata_free_spaces(table) != 0)
+int free_table(Table *table)
+{
+    if (!table)
     {
-        printf("Failed to update free spaces in metadata file\n");
-        fclose(file);
-        va_end(args);
         return -1;
     }
-    if (update_table_metadata_record_size(table) != 0)
+    free_column_encodings(table->encodings, table->columns_count);
+    free_zone_map(&table->zones);
+    free(table);
+    return 0;
+}
+
+int drop_table(Table *table)
+{
+    if (!table)
     {
-        printf("Failed to update record size in metadata file\n");
-        fclose(file);
-        va_end(args);
         return -1;
     }
-    if (update_table_metadata_free_spaces_count(table) != 0)
+
+    // Delete the data files
+    if (remove_table_storage(table) != 0)
     {
-        printf("Failed to update free spaces count in metadata file\n");
-        fclose(file);
-        va_end(args);
         return -1;
     }
+    char file[MAX_NAME_LEN * 2 + 25];
 
-    // Update the hash table file
+    // Delete the metadata file
+    snprintf(file, sizeof(file), "%s/metadatas/%s.metadata", get_root(), table->table_name);
+    if (remove(file) != 0)
+    {
+        perror("Failed to delete metadata file");
+        return -1;
+    }
 
-    if (delete_entry_from_hashmap_file(table, he) != 0)
+    // Delete the zone map file
+    if (remove_zone_map(table) != 0)
     {
-        printf("Failed to delete entry from hashmap file\n");
-        fclose(file);
-        va_end(args);
         return -1;
     }
 
-    if (delete_hash_entry(table->hash, he) != 0)
+    // Delete the hashmap file
+    snprintf(file, sizeof(file), "%s/hashmaps/%s.hashmap", get_root(), table->table_name);
+    if (remove(file) != 0)
     {
-        printf("Failed to delete hash entry\n");
-        fclose(file);
-        va_end(args);
+        perror("Failed to delete hashmap file");
         return -1;
     }
+    if (remove_bloom_filter(table) != 0)
+    {
+        return -1;
+    }
+
+    free_hashtable(table->hash);
 
-    if (update_hashmap_file_entries(table) != 0)
+    if (remove_table_from_tables(table->table_name) != 0)
     {
-        printf("Failed to update hashmap file entries\n");
-        fclose(file);
-        va_end(args);
+        printf("Failed to remove table from tables\n");
         return -1;
     }
-    if (update_hashmap_file_free_spaces_count(table) != 0)
+    if (remove_table_from_globals(table->table_name) != 0)
     {
-        printf("Failed to update hashmap file free spaces count\n");
-        fclose(file);
-        va_end(args);
+        printf("Failed to remove table from globals\n");
         return -1;
     }
-    if (update_hashmap_file_free_spaces(table) != 0)
+    if (update_table_count_on_file() != 0)
     {
-        printf("Failed to update hashmap file free spaces\n");
-        fclose(file);
-        va_end(args);
+        printf("Failed to update table count on file\n");
         return -1;
     }
 
-    fflush(file);
-    fclose(file);
-    va_end(args);
     return 0;
 }
-void *get_primary_key_from_row_data(Table *table, char *row)
+static int compare_positions(const void *a, const void *b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t hash_primary_key(const Table *table, const char *row, int key_offset)
 {
     if (table->primary_key.type == INT)
     {
-        int *key = malloc(sizeof(int));
-        if (!key)
+        int key;
+        memcpy(&key, row + key_offset, sizeof(int));
+        return hash_int_key(table, key);
+    }
+    return hash_str_key(table, row + key_offset);
+}
+
+int update_records(Table *table, long positions[], int position_count, const int column_indexes[], void *values[], int column_count)
+{
+    table->version++;
+    // Encode every new value once at its place in a row image
+    int offsets[MAX_COLUMN_COUNT];
+    int widths[MAX_COLUMN_COUNT];
+    int used_columns[MAX_COLUMN_COUNT] = {0};
+    char encoded[table->row_size_in_bytes];
+    memset(encoded, 0, sizeof(encoded));
+    for (int j = 0; j < column_count; j++)
+    {
+        const Column *column = &table->columns[column_indexes[j]];
+        offsets[j] = calculate_offset(table, *column);
+        used_columns[column_indexes[j]] = COLUMN_VALUES;
+        switch (column->type)
         {
-            perror("Memory allocation failed");
-            return NULL;
+        case INT:
+            widths[j] = sizeof(int);
+            memcpy(encoded + offsets[j], values[j], sizeof(int));
+            break;
+        case STRING:
+        case VARCHAR:
+            widths[j] = column->lenght + 1;
+            strncpy(encoded + offsets[j], (const char *)values[j], column->lenght);
+            break;
         }
-        *key = *(int *)(row + calculate_offset(table, table->primary_key));
-        return key;
     }
-    else if (table->primary_key.type == STRING)
+
+    // Sort the targets, drop duplicates and rows that are already free
+    qsort(positions, position_count, sizeof(long), compare_positions);
+    int count = 0;
+    for (int i = 0; i < position_count; i++)
     {
-        char *key = malloc(table->primary_key.lenght + 1);
-        if (!key)
+        if ((count > 0 && positions[i] == positions[count - 1]) || isfree(table, positions[i]))
         {
-            perror("Memory allocation failed");
-            return NULL;
+            continue;
         }
-        strncpy(key, row + calculate_offset(table, table->primary_key), table->primary_key.lenght);
-        key[table->primary_key.lenght] = '\0'; // Null-terminate the string
-        return key;
+        positions[count++] = positions[i];
     }
-    return NULL; // Invalid primary key type
-}
 
-int delete_record_by_row_position(Table *table, long pos)
-{
-    char *row_data = (char *)malloc(table->row_size_in_bytes);
-    FILE *file = open_file(table->table_name, "bin", "rb+");
-    if (!file)
+    int key_column = -1;
+    for (int j = 0; j < column_count; j++)
+    {
+        if (strcmp(table->columns[column_indexes[j]].name, table->primary_key.name) == 0)
+        {
+            key_column = j;
+        }
+    }
+    if (key_column >= 0 && count > 1)
     {
+        printf("Error: Duplicate primary key, %d records would get the same %s\n", count, table->primary_key.name);
         return -1;
     }
 
-    fseek(file, pos, SEEK_SET);
-    int bytes_read = fread(row_data, 1, table->row_size_in_bytes, file);
-    if (bytes_read != table->row_size_in_bytes)
+    // Columnar tables only read and write the columns being set
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb+", used_columns) != 0)
     {
-        printf("Error reading file at position %ld\n", pos);
-        free(row_data);
-        fclose(file);
         return -1;
     }
-    switch (table->primary_key.type)
+
+    // A new key must not belong to another record, its entry is moved to the new bucket when the row is patched
+    FILE *hash_file = NULL;
+    Key new_key = {0};
+    uint32_t new_hash = 0;
+    if (key_column >= 0 && count == 1)
     {
-    case INT:
-        int *intkey = (int *)get_primary_key_from_row_data(table, row_data);
-        if (!intkey)
+        new_hash = hash_primary_key(table, encoded, offsets[key_column]);
+        HashEntry *existing = find_entry_by_stored_key(table, &storage, encoded + offsets[key_column], new_hash, offsets[key_column]);
+        if (existing && existing->file_pos != positions[0])
         {
-            printf("Failed to get primary key from row data\n");
-            free(row_data);
-            fclose(file);
+            printf("Error: Duplicate primary key, %s already exists\n", table->primary_key.name);
+            close_table_storage(&storage);
             return -1;
         }
-        if (delete_record(table, *intkey) != 0)
+        if (existing)
         {
-            printf("Failed to delete record\n");
-            free(intkey);
-            free(row_data);
-            fclose(file);
-            return -1;
+            key_column = -1; // The key does not change
+        }
+        else
+        {
+            hash_file = open_file(table->table_name, "hashmap", "rb+");
+            if (!hash_file)
+            {
+                close_table_storage(&storage);
+                return -1;
+            }
+            if (table->primary_key.type == INT)
+            {
+                memcpy(&new_key.int_key, encoded + offsets[key_column], sizeof(int));
+            }
         }
-        free(intkey);
-        free(row_data);
-        fflush(file);
-        fclose(file);
+    }
 
-        return 0;
-        break;
+    int rows_per_buffer = WRITE_BUFFER_SIZE / table->row_size_in_bytes;
+    if (rows_per_buffer < 1)
+    {
+        rows_per_buffer = 1;
+    }
+    char *buffer = malloc((size_t)rows_per_buffer * table->row_size_in_bytes);
+    int result = buffer ? 0 : -1;
+    if (!buffer)
+    {
+        perror("Failed to allocate memory for update buffer");
+    }
 
-    case STRING:
-        char *key = (char *)get_primary_key_from_row_data(table, row_data);
-        if (!key)
+    int updated = 0;
+    int i = 0;
+    while (result == 0 && i < count)
+    {
+        // Load the rows starting at the next target, patch every target among them and write the dirty range back
+        long window_start = positions[i];
+        int loaded = read_table_rows(&storage, window_start, buffer, rows_per_buffer);
+        if (loaded < 1)
         {
-            printf("Failed to get primary key from row data\n");
-            free(row_data);
-            fclose(file);
-            return -1;
-            if (delete_record(table, key) != 0)
+            perror("Failed to read rows for update");
+            result = -1;
+            break;
+        }
+        long window_end = window_start + (long)loaded * table->row_size_in_bytes;
+
+        long dirty_start = positions[i];
+        long dirty_end = dirty_start;
+        for (; i < count && positions[i] < window_end; i++)
+        {
+            char *row = buffer + (positions[i] - window_start);
+            if (hash_file)
             {
-                printf("Failed to delete record\n");
-                free(key);
-                free(row_data);
-                fclose(file);
-                return -1;
+                HashEntry *he = find_entry_by_position(table->hash, hash_primary_key(table, row, offsets[key_column]), positions[i]);
+                if (he)
+                {
+                    size_t slot_size = sizeof(HashEntry) - sizeof(struct HashEntry *);
+                    move_hash_entry(table->hash, he, table->primary_key.type == INT ? new_key : he->key, new_hash);
+                    if (pwrite(fileno(hash_file), he, slot_size, he->hash_entry_pos) != (ssize_t)slot_size)
+                    {
+                        perror("Failed to update hashmap entry");
+                        result = -1;
+                        break;
+                    }
+                }
+            }
+            for (int j = 0; j < column_count; j++)
+            {
+                memcpy(row + offsets[j], encoded + offsets[j], widths[j]);
             }
-            free(key);
-            free(row_data);
-            fflush(file);
-            fclose(file);
-            return 0;
+            zone_map_update_row(table, positions[i], row, used_columns);
+            dirty_end = positions[i] + table->row_size_in_bytes;
+            updated++;
         }
-        break;
+
+        if (result == 0 && write_table_rows(&storage, dirty_start, buffer + (dirty_start - window_start),
+                                            (dirty_end - dirty_start) / table->row_size_in_bytes) != 0)
+        {
+            perror("Failed to write updated rows");
+            result = -1;
+        }
+    }
+
+    free(buffer);
+    if (hash_file)
+    {
+        fclose(hash_file);
     }
-    return -1; // Invalid primary key type or error
+    close_table_storage(&storage);
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    if (updated > 0)
+    {
+        for (int j = 0; j < column_count; j++)
+        {
+            update_column_stats(table, column_indexes[j], values[j]);
+        }
+        if (flush_zone_map(table) != 0)
+        {
+            printf("Failed to update zone map file\n");
+            return -1;
+        }
+        if (key_column >= 0 && flush_bloom_filter(table) != 0)
+        {
+            return -1;
+        }
+    }
+    return updated;
 }
 
-int free_table(Table *table)
+static int contains_position(const long positions[], int from, int to, long pos)
 {
-    if (!table)
+    while (from < to)
     {
-        return -1;
+        int middle = from + (to - from) / 2;
+        if (positions[middle] == pos)
+        {
+            return 1;
+        }
+        if (positions[middle] < pos)
+        {
+            from = middle + 1;
+        }
+        else
+        {
+            to = middle;
+        }
     }
-    free(table);
     return 0;
 }
 
-int drop_table(Table *table)
+static int remove_free_space(Table *table, long pos)
 {
-    if (!table)
+    for (int i = 0; i < table->free_spaces_count; i++)
     {
-        return -1;
+        if (table->free_spaces[i] == pos)
+        {
+            table->free_spaces[i] = table->free_spaces[--table->free_spaces_count];
+            table->free_spaces[table->free_spaces_count] = -1;
+            return 1;
+        }
     }
+    return 0;
+}
 
-    // Delete the binary file
-    char file[MAX_NAME_LEN * 2 + 25];
-    snprintf(file, sizeof(file), "%s/bins/%s.bin", get_root(), table->table_name);
-    if (remove(file) != 0)
+// Drop deleted rows at the end of the file, deleted_from..deleted_to is the sorted range of deleted rows not handled yet
+static long trim_deleted_tail(Table *table, const long deleted[], int deleted_from, int deleted_to, long file_end)
+{
+    while (file_end >= table->row_size_in_bytes)
     {
-        perror("Failed to delete binary file");
+        long last = file_end - table->row_size_in_bytes;
+        if (!contains_position(deleted, deleted_from, deleted_to, last) && !remove_free_space(table, last))
+        {
+            break;
+        }
+        file_end = last;
+    }
+    return file_end;
+}
+
+static int move_row(Table *table, TableStorage *storage, int hash_fd, long from, long to, int key_offset)
+{
+    char row[table->row_size_in_bytes];
+    if (read_table_rows(storage, from, row, 1) != 1 || write_table_rows(storage, to, row, 1) != 0 ||
+        zone_map_add_row(table, to, row) != 0)
+    {
+        perror("Failed to move row");
         return -1;
     }
+    zone_map_remove_row(table, from);
+    HashEntry *he = find_entry_by_position(table->hash, hash_primary_key(table, row, key_offset), from);
+    if (he)
+    {
+        he->file_pos = to;
+        size_t slot_size = sizeof(HashEntry) - sizeof(struct HashEntry *);
+        if (pwrite(hash_fd, he, slot_size, he->hash_entry_pos) != (ssize_t)slot_size)
+        {
+            perror("Failed to update hashmap entry of moved row");
+            return -1;
+        }
+    }
+    return 0;
+}
 
-    // Delete the metadata file
-    snprintf(file, sizeof(file), "%s/metadatas/%s.metadata", get_root(), table->table_name);
-    if (remove(file) != 0)
+int delete_records(Table *table, long positions[], int position_count)
+{
+    // Sort the targets, drop duplicates and rows that are already free
+    qsort(positions, position_count, sizeof(long), compare_positions);
+    int count = 0;
+    for (int i = 0; i < position_count; i++)
     {
-        perror("Failed to delete metadata file");
+        if ((count > 0 && positions[i] == positions[count - 1]) || isfree(table, positions[i]))
+        {
+            continue;
+        }
+        positions[count++] = positions[i];
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+    table->version++;
+
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb+", NULL) != 0)
+    {
+        return -1;
+    }
+    FILE *hash_file = open_file(table->table_name, "hashmap", "rb+");
+    if (!hash_file)
+    {
+        close_table_storage(&storage);
         return -1;
     }
+    int hash_fd = fileno(hash_file);
+    int key_offset = calculate_offset(table, table->primary_key);
+    char empty_slot[sizeof(HashEntry) - sizeof(struct HashEntry *)];
+    memset(empty_slot, 0, sizeof(empty_slot));
 
-    // Delete the hashmap file
-    snprintf(file, sizeof(file), "%s/hashmaps/%s.hashmap", get_root(), table->table_name);
-    if (remove(file) != 0)
+    int rows_per_buffer = WRITE_BUFFER_SIZE / table->row_size_in_bytes;
+    if (rows_per_buffer < 1)
     {
-        perror("Failed to delete hashmap file");
+        rows_per_buffer = 1;
+    }
+    char *buffer = malloc((size_t)rows_per_buffer * table->row_size_in_bytes);
+    int result = buffer ? 0 : -1;
+    if (!buffer)
+    {
+        perror("Failed to allocate memory for delete buffer");
+    }
+
+    int i = 0;
+    while (result == 0 && i < count)
+    {
+        // Load the rows starting at the next target, take every target among them out of the index
+        // by its position and clear each run of consecutive targets
+        long window_start = positions[i];
+        int loaded = read_table_rows(&storage, window_start, buffer, rows_per_buffer);
+        if (loaded < 1)
+        {
+            perror("Failed to read rows for delete");
+            result = -1;
+            break;
+        }
+        long window_end = window_start + (long)loaded * table->row_size_in_bytes;
+
+        long run_start = positions[i];
+        long run_end = run_start;
+        for (; i < count && positions[i] < window_end; i++)
+        {
+            char *row = buffer + (positions[i] - window_start);
+            HashEntry *he = find_entry_by_position(table->hash, hash_primary_key(table, row, key_offset), positions[i]);
+            if (he)
+            {
+                if (pwrite(hash_fd, empty_slot, sizeof(empty_slot), he->hash_entry_pos) != (ssize_t)sizeof(empty_slot))
+                {
+                    perror("Failed to delete entry from hashmap file");
+                    result = -1;
+                    break;
+                }
+                delete_hash_entry(table->hash, he);
+            }
+            zone_map_remove_row(table, positions[i]);
+            if (positions[i] != run_end)
+            {
+                if (clear_table_rows(&storage, run_start, (run_end - run_start) / table->row_size_in_bytes) != 0)
+                {
+                    result = -1;
+                    break;
+                }
+                run_start = positions[i];
+            }
+            run_end = positions[i] + table->row_size_in_bytes;
+        }
+
+        if (result == 0 && clear_table_rows(&storage, run_start, (run_end - run_start) / table->row_size_in_bytes) != 0)
+        {
+            perror("Failed to write deleted rows");
+            result = -1;
+        }
+    }
+    free(buffer);
+    if (result != 0)
+    {
+        fclose(hash_file);
+        close_table_storage(&storage);
         return -1;
     }
+    table->record_size -= count;
 
-    free_hashtable(table->hash);
+    // Give the space back: deleted rows at the end of the table are cut off, the others go to the free list.
+    // Once the free list is full the last row is moved into the hole, a zeroed row outside the list would be read as live
+    long file_end = trim_deleted_tail(table, positions, 0, count, table_storage_end(&storage));
+    for (i = 0; i < count && positions[i] < file_end; i++)
+    {
+        if (table->free_spaces_count < MAX_FREE_SPACES)
+        {
+            table->free_spaces[table->free_spaces_count++] = positions[i];
+            continue;
+        }
+        if (move_row(table, &storage, hash_fd, file_end - table->row_size_in_bytes, positions[i], key_offset) != 0)
+        {
+            fclose(hash_file);
+            close_table_storage(&storage);
+            return -1;
+        }
+        file_end = trim_deleted_tail(table, positions, i + 1, count, file_end - table->row_size_in_bytes);
+    }
+    if (truncate_table_storage(&storage, file_end) != 0)
+    {
+        perror("Failed to truncate data files");
+    }
+    zone_map_truncate(table, file_end);
+    fclose(hash_file);
+    close_table_storage(&storage);
 
-    if (remove_table_from_tables(table->table_name) != 0)
+    // Persist the metadata and the hashmap header once for the whole statement
+    if (store_table_metadata(table) != 0)
     {
-        printf("Failed to remove table from tables\n");
+        printf("Failed to update metadata file\n");
         return -1;
     }
-    if (remove_table_from_globals(table->table_name) != 0)
+    if (store_hashmap_header(table) != 0)
     {
-        printf("Failed to remove table from globals\n");
+        printf("Failed to update hashmap file header\n");
         return -1;
     }
-    if (update_table_count_on_file() != 0)
+    if (flush_zone_map(table) != 0)
     {
-        printf("Failed to update table count on file\n");
+        printf("Failed to update zone map file\n");
         return -1;
     }
-
-    return 0;
-}
\ No newline at end of file
+    return count;
+}
@@ -0,0 +1,494 @@
+#include "wire.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_HEADER_SIZE 5 // kind byte and payload length
+
+static Protocol protocol = PROTOCOL_TEXT;
+static FILE *result_stream = NULL;
+
+void set_protocol(Protocol value)
+{
+    protocol = value;
+}
+
+Protocol get_protocol()
+{
+    return protocol;
+}
+
+void set_result_stream(FILE *stream)
+{
+    result_stream = stream;
+}
+
+FILE *get_result_stream()
+{
+    return result_stream ? result_stream : stdout;
+}
+
+static void put_u16(char *at, uint16_t value)
+{
+    at[0] = (char)(value & 0xff);
+    at[1] = (char)(value >> 8);
+}
+
+static void put_u32(char *at, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        at[i] = (char)((value >> (8 * i)) & 0xff);
+    }
+}
+
+static void put_u64(char *at, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        at[i] = (char)((value >> (8 * i)) & 0xff);
+    }
+}
+
+static uint16_t get_u16(const char *at)
+{
+    const unsigned char *bytes = (const unsigned char *)at;
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static uint32_t get_u32(const char *at)
+{
+    const unsigned char *bytes = (const unsigned char *)at;
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--)
+    {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+static uint64_t get_u64(const char *at)
+{
+    const unsigned char *bytes = (const unsigned char *)at;
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+int write_frame(FILE *out, char kind, const void *payload, uint32_t length)
+{
+    char header[FRAME_HEADER_SIZE];
+    header[0] = kind;
+    put_u32(header + 1, length);
+    if (fwrite(header, 1, sizeof(header), out) != sizeof(header) ||
+        (length > 0 && fwrite(payload, 1, length, out) != length))
+    {
+        perror("Failed to write frame");
+        return -1;
+    }
+    return 0;
+}
+
+// Make room for size more bytes in the batch
+static char *reserve(ResultWriter *writer, size_t size)
+{
+    if (writer->failed)
+    {
+        return NULL;
+    }
+    if (writer->batch_length + size > writer->batch_capacity)
+    {
+        size_t capacity = writer->batch_capacity ? writer->batch_capacity : WIRE_BATCH_BYTES;
+        while (capacity < writer->batch_length + size)
+        {
+            capacity *= 2;
+        }
+        char *grown = realloc(writer->batch, capacity);
+        if (!grown)
+        {
+            perror("Failed to allocate memory for result batch");
+            writer->failed = 1;
+            return NULL;
+        }
+        writer->batch = grown;
+        writer->batch_capacity = capacity;
+    }
+    char *at = writer->batch + writer->batch_length;
+    writer->batch_length += size;
+    return at;
+}
+
+// Send the rows collected so far as one batch frame, the header was reserved when the batch started
+static void flush_batch(ResultWriter *writer)
+{
+    if (writer->batch_rows == 0 || writer->failed)
+    {
+        return;
+    }
+    writer->batch[0] = FRAME_BATCH;
+    put_u32(writer->batch + 1, (uint32_t)(writer->batch_length - FRAME_HEADER_SIZE));
+    put_u32(writer->batch + FRAME_HEADER_SIZE, writer->batch_rows);
+    if (fwrite(writer->batch, 1, writer->batch_length, writer->out) != writer->batch_length)
+    {
+        perror("Failed to write result batch");
+        writer->failed = 1;
+    }
+    writer->batch_length = 0;
+    writer->batch_rows = 0;
+}
+
+int begin_result(ResultWriter *writer, FILE *out, int column_count, const char *names[], const WireType types[])
+{
+    memset(writer, 0, sizeof(ResultWriter));
+    writer->out = out;
+    writer->protocol = protocol;
+    writer->column_count = column_count;
+    memcpy(writer->types, types, column_count * sizeof(WireType));
+    if (protocol == PROTOCOL_TEXT)
+    {
+        return 0;
+    }
+
+    size_t length = 2;
+    for (int i = 0; i < column_count; i++)
+    {
+        size_t name_length = strlen(names[i]);
+        length += 2 + (name_length < 255 ? name_length : 255);
+    }
+    char schema[length];
+    char *at = schema;
+    put_u16(at, (uint16_t)column_count);
+    at += 2;
+    for (int i = 0; i < column_count; i++)
+    {
+        size_t name_length = strlen(names[i]);
+        name_length = name_length < 255 ? name_length : 255;
+        *at++ = (char)types[i];
+        *at++ = (char)name_length;
+        memcpy(at, names[i], name_length);
+        at += name_length;
+    }
+    if (write_frame(out, FRAME_SCHEMA, schema, (uint32_t)length) != 0)
+    {
+        writer->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// Binary rows start with their null bitmap, a new batch with its frame header and row count
+static char *value_space(ResultWriter *writer, size_t size)
+{
+    if (writer->failed)
+    {
+        return NULL;
+    }
+    if (writer->column == 0)
+    {
+        if (writer->batch_length == 0 && !reserve(writer, FRAME_HEADER_SIZE + 4))
+        {
+            return NULL;
+        }
+        size_t bitmap = (writer->column_count + 7) / 8;
+        char *at = reserve(writer, bitmap);
+        if (!at)
+        {
+            return NULL;
+        }
+        memset(at, 0, bitmap);
+        writer->row_start = at - writer->batch;
+    }
+    writer->column++;
+    return size > 0 ? reserve(writer, size) : writer->batch + writer->batch_length;
+}
+
+void write_int32(ResultWriter *writer, int value)
+{
+    if (writer->protocol == PROTOCOL_TEXT)
+    {
+        fprintf(writer->out, "%d, ", value);
+        return;
+    }
+    char *at = value_space(writer, 4);
+    if (at)
+    {
+        put_u32(at, (uint32_t)value);
+    }
+}
+
+void write_int64(ResultWriter *writer, long long value)
+{
+    if (writer->protocol == PROTOCOL_TEXT)
+    {
+        fprintf(writer->out, "%lld, ", value);
+        return;
+    }
+    char *at = value_space(writer, 8);
+    if (at)
+    {
+        put_u64(at, (uint64_t)value);
+    }
+}
+
+void write_double(ResultWriter *writer, double value)
+{
+    if (writer->protocol == PROTOCOL_TEXT)
+    {
+        fprintf(writer->out, "%.2f, ", value);
+        return;
+    }
+    char *at = value_space(writer, 8);
+    if (at)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        put_u64(at, bits);
+    }
+}
+
+void write_text(ResultWriter *writer, const char *value)
+{
+    if (writer->protocol == PROTOCOL_TEXT)
+    {
+        fprintf(writer->out, "%s, ", value);
+        return;
+    }
+    size_t length = strlen(value);
+    length = length < UINT16_MAX ? length : UINT16_MAX;
+    char *at = value_space(writer, 2 + length);
+    if (at)
+    {
+        put_u16(at, (uint16_t)length);
+        memcpy(at + 2, value, length);
+    }
+}
+
+void write_null(ResultWriter *writer)
+{
+    if (writer->protocol == PROTOCOL_TEXT)
+    {
+        fprintf(writer->out, "NULL, ");
+        return;
+    }
+    int column = writer->column;
+    if (value_space(writer, 0))
+    {
+        writer->batch[writer->row_start + column / 8] |= (char)(1 << (column % 8));
+    }
+}
+
+void end_row(ResultWriter *writer)
+{
+    writer->row_count++;
+    if (writer->protocol == PROTOCOL_TEXT)
+    {
+        fprintf(writer->out, "\n");
+        return;
+    }
+    writer->column = 0;
+    writer->batch_rows++;
+    if (writer->batch_length >= WIRE_BATCH_BYTES)
+    {
+        flush_batch(writer);
+    }
+}
+
+int end_result(ResultWriter *writer)
+{
+    if (writer->protocol == PROTOCOL_TEXT)
+    {
+        if (writer->row_count == 0)
+        {
+            fprintf(writer->out, "No matching records found\n");
+        }
+        return 0;
+    }
+    flush_batch(writer);
+    free(writer->batch);
+    writer->batch = NULL;
+    writer->batch_capacity = 0;
+    return writer->failed ? -1 : 0;
+}
+
+// Take the next frame of a response, 0 at its end
+static int read_frame(ResultReader *reader, char *kind, const char **payload, uint32_t *length)
+{
+    if (reader->pos + FRAME_HEADER_SIZE > reader->length)
+    {
+        return 0;
+    }
+    *kind = reader->data[reader->pos];
+    *length = get_u32(reader->data + reader->pos + 1);
+    if (reader->pos + FRAME_HEADER_SIZE + *length > reader->length)
+    {
+        return -1;
+    }
+    *payload = reader->data + reader->pos + FRAME_HEADER_SIZE;
+    reader->pos += FRAME_HEADER_SIZE + *length;
+    return 1;
+}
+
+int open_result(ResultReader *reader, const char *data, size_t length)
+{
+    memset(reader, 0, sizeof(ResultReader));
+    reader->data = data;
+    reader->length = length;
+    char kind;
+    const char *payload;
+    uint32_t payload_length;
+    int found;
+    while ((found = read_frame(reader, &kind, &payload, &payload_length)) == 1 && kind != FRAME_SCHEMA)
+    {
+    }
+    if (found != 1)
+    {
+        return found;
+    }
+
+    if (payload_length < 2 || get_u16(payload) > WIRE_MAX_COLUMNS)
+    {
+        return -1;
+    }
+    reader->column_count = get_u16(payload);
+    size_t at = 2;
+    for (int i = 0; i < reader->column_count; i++)
+    {
+        if (at + 2 > payload_length || at + 2 + (unsigned char)payload[at + 1] > payload_length)
+        {
+            return -1;
+        }
+        int name_length = (unsigned char)payload[at + 1];
+        reader->types[i] = (WireType)payload[at];
+        memcpy(reader->names[i], payload + at + 2, name_length);
+        reader->names[i][name_length] = '\0';
+        at += 2 + name_length;
+    }
+    return 1;
+}
+
+// Copy a TEXT value behind the ones of the current row, null-terminated
+static int keep_text(ResultReader *reader, size_t *used, const char *value, size_t length)
+{
+    if (*used + length + 1 > reader->text_capacity)
+    {
+        size_t capacity = reader->text_capacity ? reader->text_capacity : 256;
+        while (capacity < *used + length + 1)
+        {
+            capacity *= 2;
+        }
+        char *grown = realloc(reader->text, capacity);
+        if (!grown)
+        {
+            perror("Failed to allocate memory for result text");
+            return -1;
+        }
+        reader->text = grown;
+        reader->text_capacity = capacity;
+    }
+    memcpy(reader->text + *used, value, length);
+    reader->text[*used + length] = '\0';
+    *used += length + 1;
+    return 0;
+}
+
+int next_result_row(ResultReader *reader)
+{
+    while (reader->rows_left == 0)
+    {
+        char kind;
+        const char *payload;
+        uint32_t payload_length;
+        int found = read_frame(reader, &kind, &payload, &payload_length);
+        if (found != 1 || kind != FRAME_BATCH)
+        {
+            return found < 0 ? -1 : 0; // the batches of a result set end at the next frame of another kind
+        }
+        if (payload_length < 4)
+        {
+            return -1;
+        }
+        reader->batch = payload;
+        reader->batch_length = payload_length;
+        reader->batch_pos = 4;
+        reader->rows_left = get_u32(payload);
+    }
+
+    const char *batch = reader->batch;
+    size_t at = reader->batch_pos;
+    size_t bitmap = (reader->column_count + 7) / 8;
+    size_t text_used = 0;
+    if (at + bitmap > reader->batch_length)
+    {
+        return -1;
+    }
+    const unsigned char *nulls = (const unsigned char *)batch + at;
+    at += bitmap;
+    for (int i = 0; i < reader->column_count; i++)
+    {
+        reader->nulls[i] = nulls[i / 8] >> (i % 8) & 1;
+        reader->ints[i] = 0;
+        reader->doubles[i] = 0.0;
+        if (reader->nulls[i])
+        {
+            continue;
+        }
+        size_t size = reader->types[i] == WIRE_INT32 ? 4 : reader->types[i] == WIRE_TEXT ? 2 : 8;
+        if (at + size > reader->batch_length)
+        {
+            return -1;
+        }
+        switch (reader->types[i])
+        {
+        case WIRE_INT32:
+            reader->ints[i] = (int32_t)get_u32(batch + at);
+            reader->doubles[i] = (double)reader->ints[i];
+            break;
+        case WIRE_INT64:
+            reader->ints[i] = (long long)get_u64(batch + at);
+            reader->doubles[i] = (double)reader->ints[i];
+            break;
+        case WIRE_DOUBLE:
+        {
+            uint64_t bits = get_u64(batch + at);
+            memcpy(&reader->doubles[i], &bits, sizeof(double));
+            reader->ints[i] = (long long)reader->doubles[i];
+            break;
+        }
+        case WIRE_TEXT:
+        {
+            size_t length = get_u16(batch + at);
+            if (at + 2 + length > reader->batch_length)
+            {
+                return -1;
+            }
+            reader->texts[i] = text_used;
+            if (keep_text(reader, &text_used, batch + at + 2, length) != 0)
+            {
+                return -1;
+            }
+            size += length;
+            break;
+        }
+        default:
+            return -1;
+        }
+        at += size;
+    }
+    reader->batch_pos = at;
+    reader->rows_left--;
+    return 1;
+}
+
+const char *result_text(const ResultReader *reader, int column)
+{
+    return reader->text + reader->texts[column];
+}
+
+void close_result(ResultReader *reader)
+{
+    free(reader->text);
+    reader->text = NULL;
+    reader->text_capacity = 0;
+}
@@ -0,0 +1,304 @@
+#include "zonemap.h"
+#include "table.h"
+#include "storage.h"
+#include "file_io.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void zone_map_path(const Table *table, char *filename, size_t size)
+{
+    snprintf(filename, size, "%s/metadatas/%s.zonemap", get_root(), table->table_name);
+}
+
+// A block on disk: its live row count followed by the min and max of every column
+static size_t block_record_size(const Table *table)
+{
+    return sizeof(int) * (1 + 2 * table->columns_count);
+}
+
+static int *block_bounds(const Table *table, int block)
+{
+    return table->zones.bounds + (size_t)block * table->columns_count * 2;
+}
+
+static void mark_dirty(ZoneMap *zones, int block)
+{
+    if (zones->dirty_from < 0 || block < zones->dirty_from)
+    {
+        zones->dirty_from = block;
+    }
+    if (block + 1 > zones->dirty_to)
+    {
+        zones->dirty_to = block + 1;
+    }
+}
+
+static int reserve_blocks(Table *table, int block_count)
+{
+    ZoneMap *zones = &table->zones;
+    if (block_count > zones->capacity)
+    {
+        int capacity = zones->capacity ? zones->capacity : 16;
+        while (capacity < block_count)
+        {
+            capacity *= 2;
+        }
+        int *live_rows = realloc(zones->live_rows, capacity * sizeof(int));
+        if (!live_rows)
+        {
+            perror("Failed to allocate memory for zone map");
+            return -1;
+        }
+        zones->live_rows = live_rows;
+        int *bounds = realloc(zones->bounds, (size_t)capacity * table->columns_count * 2 * sizeof(int));
+        if (!bounds)
+        {
+            perror("Failed to allocate memory for zone map");
+            return -1;
+        }
+        zones->bounds = bounds;
+        zones->capacity = capacity;
+    }
+    for (int block = zones->block_count; block < block_count; block++)
+    {
+        zones->live_rows[block] = 0;
+        memset(block_bounds(table, block), 0, table->columns_count * 2 * sizeof(int));
+    }
+    if (block_count > zones->block_count)
+    {
+        zones->block_count = block_count;
+    }
+    return 0;
+}
+
+static int block_of(const Table *table, long pos)
+{
+    return pos / table->row_size_in_bytes / ZONE_BLOCK_ROWS;
+}
+
+static void widen_bounds(const Table *table, int block, const char *row, const int columns[], int first_row)
+{
+    int *bounds = block_bounds(table, block);
+    int offset = 0;
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        if (table->columns[i].type != INT)
+        {
+            offset += table->columns[i].lenght + 1;
+            continue;
+        }
+        if (!columns || columns[i])
+        {
+            int value;
+            memcpy(&value, row + offset, sizeof(int));
+            if (first_row || value < bounds[2 * i])
+            {
+                bounds[2 * i] = value;
+            }
+            if (first_row || value > bounds[2 * i + 1])
+            {
+                bounds[2 * i + 1] = value;
+            }
+        }
+        offset += sizeof(int);
+    }
+}
+
+void init_zone_map(ZoneMap *zones)
+{
+    memset(zones, 0, sizeof(ZoneMap));
+    zones->dirty_from = -1;
+    zones->fd = -1;
+}
+
+void free_zone_map(ZoneMap *zones)
+{
+    if (zones->fd >= 0)
+    {
+        close(zones->fd);
+    }
+    free(zones->live_rows);
+    free(zones->bounds);
+    init_zone_map(zones);
+}
+
+int zone_map_add_row(Table *table, long pos, const char *row)
+{
+    int block = block_of(table, pos);
+    if (reserve_blocks(table, block + 1) != 0)
+    {
+        return -1;
+    }
+    widen_bounds(table, block, row, NULL, table->zones.live_rows[block] == 0);
+    table->zones.live_rows[block]++;
+    mark_dirty(&table->zones, block);
+    return 0;
+}
+
+void zone_map_update_row(Table *table, long pos, const char *row, const int columns[])
+{
+    int block = block_of(table, pos);
+    if (block >= table->zones.block_count || table->zones.live_rows[block] == 0)
+    {
+        return;
+    }
+    widen_bounds(table, block, row, columns, 0);
+    mark_dirty(&table->zones, block);
+}
+
+void zone_map_remove_row(Table *table, long pos)
+{
+    int block = block_of(table, pos);
+    if (block >= table->zones.block_count || table->zones.live_rows[block] == 0)
+    {
+        return;
+    }
+    table->zones.live_rows[block]--;
+    mark_dirty(&table->zones, block);
+}
+
+void zone_map_truncate(Table *table, long end)
+{
+    long rows = end / table->row_size_in_bytes;
+    int block_count = (rows + ZONE_BLOCK_ROWS - 1) / ZONE_BLOCK_ROWS;
+    if (block_count < table->zones.block_count)
+    {
+        table->zones.block_count = block_count;
+    }
+}
+
+int zone_bounds(const Table *table, int block, int column_index, int *min, int *max)
+{
+    if (block >= table->zones.block_count)
+    {
+        return -1;
+    }
+    if (table->zones.live_rows[block] == 0)
+    {
+        return 0;
+    }
+    const int *bounds = block_bounds(table, block);
+    *min = bounds[2 * column_index];
+    *max = bounds[2 * column_index + 1];
+    return 1;
+}
+
+int flush_zone_map(Table *table)
+{
+    ZoneMap *zones = &table->zones;
+    if (zones->fd < 0)
+    {
+        char filename[MAX_NAME_LEN * 2 + 24];
+        zone_map_path(table, filename, sizeof(filename));
+        zones->fd = open(filename, O_RDWR | O_CREAT, 0644);
+        if (zones->fd < 0)
+        {
+            perror("Failed to open zone map file");
+            return -1;
+        }
+    }
+
+    // A block on disk is its live row count followed by its bounds, built in one buffer to write it at once
+    size_t record_size = block_record_size(table);
+    int record[1 + 2 * table->columns_count];
+    int from = zones->dirty_from < 0 ? zones->block_count : zones->dirty_from;
+    int to = zones->dirty_to < zones->block_count ? zones->dirty_to : zones->block_count;
+    int result = 0;
+    for (int block = from; result == 0 && block < to; block++)
+    {
+        record[0] = zones->live_rows[block];
+        memcpy(record + 1, block_bounds(table, block), sizeof(int) * table->columns_count * 2);
+        if (pwrite(zones->fd, record, record_size, (off_t)block * record_size) != (ssize_t)record_size)
+        {
+            result = -1;
+        }
+    }
+    if (result == 0 && zones->stored_block_count > zones->block_count &&
+        ftruncate(zones->fd, (off_t)zones->block_count * record_size) != 0)
+    {
+        result = -1;
+    }
+    if (result != 0)
+    {
+        perror("Failed to write zone map file");
+        return -1;
+    }
+    zones->stored_block_count = zones->block_count;
+    zones->dirty_from = -1;
+    zones->dirty_to = 0;
+    return 0;
+}
+
+// Tables written before zone maps existed get theirs from a scan of the INT columns
+static int rebuild_zone_map(Table *table)
+{
+    int used_columns[MAX_COLUMN_COUNT] = {0};
+    for (int i = 0; i < table->columns_count; i++)
+    {
+        used_columns[i] = table->columns[i].type == INT ? COLUMN_VALUES : 0;
+    }
+    TableStorage storage;
+    if (open_table_storage(&storage, table, "rb", used_columns) != 0)
+    {
+        return -1;
+    }
+    char *row = calloc(1, table->row_size_in_bytes);
+    int result = row ? 0 : -1;
+    while (result == 0 && read_next_row(&storage, row))
+    {
+        if (!isfree(table, storage.current_pos))
+        {
+            result = zone_map_add_row(table, storage.current_pos, row);
+        }
+    }
+    free(row);
+    close_table_storage(&storage);
+    return result == 0 ? flush_zone_map(table) : -1;
+}
+
+int load_zone_map(Table *table)
+{
+    char filename[MAX_NAME_LEN * 2 + 24];
+    zone_map_path(table, filename, sizeof(filename));
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        return rebuild_zone_map(table);
+    }
+
+    fseek(file, 0, SEEK_END);
+    int block_count = ftell(file) / block_record_size(table);
+    fseek(file, 0, SEEK_SET);
+    if (reserve_blocks(table, block_count) != 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    for (int block = 0; block < block_count; block++)
+    {
+        if (fread(&table->zones.live_rows[block], sizeof(int), 1, file) != 1 ||
+            fread(block_bounds(table, block), sizeof(int), table->columns_count * 2, file) != (size_t)table->columns_count * 2)
+        {
+            printf("Failed to read zone map of table %s\n", table->table_name);
+            fclose(file);
+            return -1;
+        }
+    }
+    fclose(file);
+    table->zones.stored_block_count = block_count;
+    return 0;
+}
+
+int remove_zone_map(const Table *table)
+{
+    char filename[MAX_NAME_LEN * 2 + 24];
+    zone_map_path(table, filename, sizeof(filename));
+    if (remove(filename) != 0)
+    {
+        perror("Failed to delete zone map file");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Steps libalildb cursors through SELECTs with and without a WHERE and checks the rows they return. The
+// database lives in a scratch directory.
+#include "alildb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ROW_COUNT 6
+#define DELETED_ID 3
+
+static int failed = 0;
+
+static void expect_int(const char *what, long long expected, long long got)
+{
+    if (expected != got)
+    {
+        printf("FAIL %s: expected %lld, got %lld\n", what, expected, got);
+        failed = 1;
+    }
+}
+
+// Run a statement to the end and return how many rows it gave, -1 on failure. ids collects the ID column.
+static int count_rows(AlilDB *db, const char *sql, int ids[])
+{
+    AlilStmt *stmt;
+    if (db_prepare(db, sql, &stmt) != 0)
+    {
+        return -1;
+    }
+    int rows = 0;
+    int step;
+    while ((step = db_step(stmt)) == DB_ROW)
+    {
+        if (ids && rows < ROW_COUNT)
+        {
+            ids[rows] = db_column_int(stmt, 0);
+        }
+        rows++;
+    }
+    db_finalize(stmt);
+    return step == DB_DONE ? rows : -1;
+}
+
+int main(void)
+{
+    char work[] = "/tmp/alildb_cursor_XXXXXX";
+    if (!mkdtemp(work) || chdir(work) != 0 || mkdir("databases", 0755) != 0)
+    {
+        perror("Failed to create scratch directory");
+        return 1;
+    }
+
+    AlilDB *db;
+    if (db_exec(NULL, "CREATE DATABASE t;") != 0 || db_open("t", &db) != 0 ||
+        db_exec(db, "CREATE TABLE users (ID int, name char(10), PRIMARY KEY(ID));") != 0)
+    {
+        printf("FAIL could not create the test database\n");
+        return 1;
+    }
+    char sql[96];
+    for (int id = 1; id <= ROW_COUNT; id++)
+    {
+        snprintf(sql, sizeof(sql), "INSERT INTO users VALUES (%d, 'user%d');", id, id);
+        db_exec(db, sql);
+    }
+    snprintf(sql, sizeof(sql), "DELETE FROM users WHERE ID = %d;", DELETED_ID);
+    db_exec(db, sql);
+
+    int ids[ROW_COUNT] = {0};
+    expect_int("rows of an unfiltered SELECT", ROW_COUNT - 1, count_rows(db, "SELECT * FROM users;", ids));
+    for (int i = 0, id = 1; i < ROW_COUNT - 1; i++, id++)
+    {
+        id += id == DELETED_ID;
+        expect_int("ID of an unfiltered SELECT row", id, ids[i]);
+    }
+    expect_int("rows of a SELECT with WHERE", 3, count_rows(db, "SELECT * FROM users WHERE ID > 2;", NULL));
+    expect_int("rows of an unfiltered SELECT with LIMIT", 2, count_rows(db, "SELECT * FROM users LIMIT 2;", NULL));
+    expect_int("rows of an unfiltered column SELECT", ROW_COUNT - 1, count_rows(db, "SELECT name FROM users;", NULL));
+
+    AlilStmt *stmt = NULL;
+    if (db_prepare(db, "SELECT ID, name FROM users;", &stmt) == 0 && db_step(stmt) == DB_ROW)
+    {
+        expect_int("column count", 2, db_column_count(stmt));
+        const char *name = db_column_text(stmt, 1);
+        if (!name || strcmp(name, "user1") != 0)
+        {
+            printf("FAIL name of the first row: expected user1, got %s\n", name ? name : "NULL");
+            failed = 1;
+        }
+    }
+    else
+    {
+        printf("FAIL SELECT ID, name returned no row\n");
+        failed = 1;
+    }
+    db_finalize(stmt);
+
+    db_close(db);
+    db_exec(NULL, "DROP DATABASE t;");
+    rmdir("databases");
+    if (chdir("/") == 0)
+    {
+        rmdir(work);
+    }
+    if (!failed)
+    {
+        printf("cursor_test passed\n");
+    }
+    return failed;
+}
@@ -0,0 +1,43 @@
+#!/bin/sh
+# A SELECT without WHERE returns every live row of the table, LIMIT and OFFSET only shorten that output.
+# Run from the repository root after make, the database lives in a scratch directory.
+dbms="$(pwd)/dbms"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" && mkdir databases || exit 1
+
+{
+    echo "CREATE DATABASE t;"
+    echo "LOAD DATABASE t;"
+    echo "CREATE TABLE users (ID int, name char(10), PRIMARY KEY(ID));"
+    for i in 1 2 3 4 5 6; do
+        echo "INSERT INTO users VALUES ($i, 'user$i');"
+    done
+    echo "DELETE FROM users WHERE ID = 3;"
+} | "$dbms" >/dev/null
+
+# The result rows of a statement, without the end of response marker
+select_rows() {
+    printf 'LOAD DATABASE t;\n%s\n' "$1" | "$dbms" | grep -v '^!END!$'
+}
+
+failed=0
+expect() {
+    if [ "$2" != "$3" ]; then
+        printf 'FAIL %s\n  expected:\n%s\n  got:\n%s\n' "$1" "$2" "$3"
+        failed=1
+    fi
+}
+
+all=$(select_rows "SELECT * FROM users;")
+expect "SELECT without WHERE returns the 5 live rows" 5 "$(printf '%s\n' "$all" | grep -c ',')"
+expect "LIMIT 2 returns the first 2 rows" "$(printf '%s\n' "$all" | head -n 2)" \
+    "$(select_rows "SELECT * FROM users LIMIT 2;")"
+expect "LIMIT 2 OFFSET 1 returns rows 2 and 3" "$(printf '%s\n' "$all" | sed -n 2,3p)" \
+    "$(select_rows "SELECT * FROM users LIMIT 2 OFFSET 1;")"
+expect "LIMIT above the row count returns every row" "$all" "$(select_rows "SELECT * FROM users LIMIT 100;")"
+expect "OFFSET alone skips the first row" "$(printf '%s\n' "$all" | tail -n +2)" \
+    "$(select_rows "SELECT * FROM users OFFSET 1;")"
+
+[ $failed -eq 0 ] && echo "select_limit_test passed"
+exit $failed